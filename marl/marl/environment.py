@@ -1,23 +1,32 @@
 import rclpy
 from rclpy.node import Node
 from nav_msgs.msg import OccupancyGrid
+from map_msgs.msg import OccupancyGridUpdate
 from std_msgs.msg import Int32MultiArray
 from multisim.srv import Reset
+from multislam.msg import MapMetrics
 import numpy as np
+from marl.map_assembler import OccupancyGridAssembler
 
 class MultiAgentEnv(Node):
     def __init__(self):
         super().__init__('multi_agent_env')
         self.reset_service = self.create_client(Reset, '/multisim/reset')
+        self.proposed_map_assembler = OccupancyGridAssembler()
         self.proposed_map_sub = self.create_subscription(
-            OccupancyGrid, '/proposed_simplified_map', self.proposed_map_callback, 10)
+            OccupancyGrid, '/proposed_simplified_map', self.proposed_map_assembler.full_callback, 10)
+        self.proposed_map_updates_sub = self.create_subscription(
+            OccupancyGridUpdate, '/proposed_simplified_map_updates',
+            self.proposed_map_assembler.update_callback, 10)
         self.true_map_sub = self.create_subscription(
             OccupancyGrid, '/true_simplified_map', self.true_map_callback, 10)
         self.collision_sub = self.create_subscription(
             Int32MultiArray, '/collision_info', self.collision_callback, 10)
+        self.map_metrics_sub = self.create_subscription(
+            MapMetrics, '/map_metrics', self.map_metrics_callback, 10)
 
-        self.proposed_map = None
         self.true_map = None
+        self.map_metrics = None
         self.collisions = []
 
     def reset(self, seed):
@@ -29,25 +38,27 @@ class MultiAgentEnv(Node):
         rclpy.spin_until_future_complete(self, future)
         return future.result()
 
-    def proposed_map_callback(self, msg):
-        self.proposed_map = np.array(msg.data).reshape((msg.info.height, msg.info.width))
-
     def true_map_callback(self, msg):
         self.true_map = np.array(msg.data).reshape((msg.info.height, msg.info.width))
 
     def collision_callback(self, msg):
         self.collisions = msg.data
 
+    def map_metrics_callback(self, msg):
+        self.map_metrics = msg
+
     def get_state(self):
         return {
-            'proposed_map': self.proposed_map,
+            'proposed_map': self.proposed_map_assembler.grid,
             'true_map': self.true_map,
-            'collisions': self.collisions
+            'collisions': self.collisions,
+            'map_metrics': self.map_metrics
         }
     
     def calculate_reward(self):
-        if self.proposed_map is None or self.true_map is None:
+        if self.map_metrics is None:
             return 0
-        coverage = np.sum(self.proposed_map == self.true_map) / self.proposed_map.size
+        # Coverage is maintained incrementally by the map combiner
+        coverage = self.map_metrics.coverage
         penalty = np.sum(self.collisions)
         return coverage - penalty
@@ -0,0 +1,20 @@
+import numpy as np
+
+
+class OccupancyGridAssembler:
+    """Rebuild an occupancy grid from a full keyframe plus OccupancyGridUpdate patches."""
+
+    def __init__(self):
+        self.grid = None
+
+    def full_callback(self, msg):
+        self.grid = np.array(msg.data, dtype=np.int8).reshape((msg.info.height, msg.info.width))
+
+    def update_callback(self, msg):
+        # Patches are meaningless until a keyframe has given us the geometry
+        if self.grid is None:
+            return
+        if msg.y + msg.height > self.grid.shape[0] or msg.x + msg.width > self.grid.shape[1]:
+            return
+        self.grid[msg.y:msg.y + msg.height, msg.x:msg.x + msg.width] = \
+            np.array(msg.data, dtype=np.int8).reshape((msg.height, msg.width))
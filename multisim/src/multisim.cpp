@@ -153,6 +153,7 @@ public:
     auto lidar_angle_increment_des = rcl_interfaces::msg::ParameterDescriptor{};
     auto lidar_num_samples_des = rcl_interfaces::msg::ParameterDescriptor{};
     auto lidar_resolution_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto use_slam_toolbox_des = rcl_interfaces::msg::ParameterDescriptor{};
 
     seed_des.description = "random seed value to configure the environment. Integer from [1, max_seed]";
     num_robots_des.description = "number of agents";
@@ -180,6 +181,7 @@ public:
     lidar_angle_increment_des.description = "Angular increment LIDAR scanning [deg]";
     lidar_num_samples_des.description = "";
     lidar_resolution_des.description = "Distance resolution in LIDAR scanning [m]";
+    use_slam_toolbox_des.description = "Reset the per-robot slam_toolbox nodes on world reset";
 
     // Declare default parameters values
     declare_parameter("seed", 0, seed_des);     // 1,2,3 ... max_seed_
@@ -208,6 +210,7 @@ public:
     declare_parameter("lidar_angle_increment", -1.0, lidar_angle_increment_des); // Degrees
     declare_parameter("lidar_num_samples", -1.0, lidar_num_samples_des);
     declare_parameter("lidar_resolution", -1.0, lidar_resolution_des); // Meters
+    declare_parameter("use_slam_toolbox", true, use_slam_toolbox_des);
     
     // Get params - Read params from yaml file that is passed in the launch file
     seed_ = get_parameter("seed").get_parameter_value().get<int>();
@@ -240,6 +243,8 @@ public:
     lidar_num_samples_ = get_parameter("lidar_num_samples").get_parameter_value().get<double>();
     lidar_resolution_ = get_parameter("lidar_resolution").get_parameter_value().get<double>();
     lidar_frequency_ = 5.0;
+    use_slam_toolbox_ = get_parameter("use_slam_toolbox").get_parameter_value().get<bool>();
+    true_map_keyframe_frequency_ = 1.0;
     
     // Check all params
     check_yaml_params();
@@ -273,6 +278,7 @@ public:
     // Initialize Pseudo Random Turtles
 
     double x0, y0, theta0;
+    turtles_ = turtlelib::DiffDriveFleet{wheel_radius_, track_width_};
     for (int i = 0; i < num_robots_; i++)
     {
       // Select random empty spawn point
@@ -290,7 +296,7 @@ public:
                                                 });
     
       // Initialize the differential drive kinematic state
-      turtles_.push_back(turtlelib::DiffDrive{wheel_radius_, track_width_, turtlelib::wheelAngles{}, turtlelib::Pose2D{theta0, x0, y0}});
+      turtles_.add(turtlelib::wheelAngles{}, turtlelib::Pose2D{theta0, x0, y0});
 
       // Initialize odometry frames
       odom_tfs_.push_back(geometry_msgs::msg::TransformStamped{});
@@ -422,7 +428,7 @@ private:
   std::vector<nuturtlebot_msgs::msg::SensorData> prev_sensor_data_; // Encoder ticks
   double encoder_ticks_per_rad_;
   double motor_cmd_per_rad_sec_;
-  std::vector<turtlelib::DiffDrive> turtles_;
+  turtlelib::DiffDriveFleet turtles_;
   std::vector<std::string> colors_ = {"cyan", "magenta", "yellow", "red", "green", "blue", "orange", "brown", "white"};
   bool resetting_ = false;
   int reset_countdown_init_ = 99;
@@ -451,6 +457,9 @@ private:
   double lidar_num_samples_;
   double lidar_resolution_;
   double lidar_frequency_;
+  double true_map_keyframe_frequency_;
+  size_t steps_since_true_map_ = 0;
+  bool use_slam_toolbox_;
   std::normal_distribution<> lidar_noise_{0.0, 0.0};
   std::vector<geometry_msgs::msg::TransformStamped> odom_tfs_;
 
@@ -482,7 +491,7 @@ private:
     multisim::srv::Reset::Response::SharedPtr)
   {
     timestep_ = 0;
-    resetting_ = true;
+    resetting_ = use_slam_toolbox_; // Repeated resets only matter for slam_toolbox
 
     // Initialize Pseudo Random environment
     std::srand((unsigned) request->seed);
@@ -518,7 +527,7 @@ private:
                                                 y0
                                                 });
 
-      turtles_.at(i).q = spawn_poses_.at(i);
+      turtles_.setPose(i, spawn_poses_.at(i));
 
       paths_.at(i).poses.clear();
 
@@ -534,6 +543,13 @@ private:
 
   void reset_slam_toolbox()
   {
+    // Without slam_toolbox only the map consumers need to hear about the reset
+    if (!use_slam_toolbox_)
+    {
+      true_simplified_map_.header.stamp.sec = 0;
+      return;
+    }
+
     for (int i = 0; i < num_robots_; i++)
     {
       for (int j = 0; j < 3; j++)
@@ -563,9 +579,7 @@ private:
     multisim::srv::Teleport::Request::SharedPtr request,
     multisim::srv::Teleport::Response::SharedPtr)
   {
-    turtles_.at(0).q.x = request->x;
-    turtles_.at(0).q.y = request->y;
-    turtles_.at(0).q.theta = request->theta;
+    turtles_.setPose(0, turtlelib::Pose2D{request->theta, request->x, request->y});
   }
 
   /// \brief Broadcast the TF frames of the robot
@@ -590,11 +604,11 @@ private:
 
       // Set rotation (as a quaternion)
       tf2::Quaternion rotation;
-      rotation.setRPY(0, 0, turtles_.at(i).pose().theta);  // Roll, Pitch, Yaw in radians
+      rotation.setRPY(0, 0, turtles_.pose(i).theta);  // Roll, Pitch, Yaw in radians
       T_world_footprint.setRotation(rotation);
 
       // Set translation
-      tf2::Vector3 translation(turtles_.at(i).pose().x, turtles_.at(i).pose().y, 0.0);  // x, y, z
+      tf2::Vector3 translation(turtles_.pose(i).x, turtles_.pose(i).y, 0.0);  // x, y, z
       T_world_footprint.setOrigin(translation);
 
       // Calculate odom to footprint trasnformation
@@ -1029,7 +1043,7 @@ private:
     if(!detect_and_simulate_collision(delta_wheels_, turtle_idx))
     {
       // Update Transform if no collision
-      turtles_.at(turtle_idx).driveWheels(delta_wheels_);
+      turtles_.driveWheels(turtle_idx, delta_wheels_);
       // RCLCPP_ERROR(this->get_logger(), "DRIVING!");
       // RCLCPP_ERROR(this->get_logger(), "Param wheel_radius: %f", wheel_radius_);
     }
@@ -1064,11 +1078,11 @@ private:
       // Create new pose stamped
       path_pose_stamped_.header.stamp = get_clock()->now();
       path_pose_stamped_.header.frame_id = "multisim/world";
-      path_pose_stamped_.pose.position.x = turtles_.at(i).pose().x;
-      path_pose_stamped_.pose.position.y = turtles_.at(i).pose().y;
+      path_pose_stamped_.pose.position.x = turtles_.pose(i).x;
+      path_pose_stamped_.pose.position.y = turtles_.pose(i).y;
       path_pose_stamped_.pose.position.z = 0.0;
       tf2::Quaternion q_;
-      q_.setRPY(0, 0, turtles_.at(i).pose().theta);     // Rotation around z-axis
+      q_.setRPY(0, 0, turtles_.pose(i).theta);     // Rotation around z-axis
       path_pose_stamped_.pose.orientation.x = q_.x();
       path_pose_stamped_.pose.orientation.y = q_.y();
       path_pose_stamped_.pose.orientation.z = q_.z();
@@ -1083,10 +1097,9 @@ private:
   {    
     // return false;
     // Predicted robot motion
-    turtlelib::DiffDrive predicted_turtle_ = turtles_.at(turtle_idx);
-    predicted_turtle_.driveWheels(predicted_delta_wheels_);   
+    const turtlelib::Pose2D predicted_pose_ = turtles_.predictPose(turtle_idx, predicted_delta_wheels_);
 
-    // turtlelib::Transform2D T_world_robot_{{predicted_turtle_.pose().x, predicted_turtle_.pose().y}, predicted_turtle_.pose().theta};
+    // turtlelib::Transform2D T_world_robot_{{predicted_pose_.x, predicted_pose_.y}, predicted_pose_.theta};
     // turtlelib::Transform2D T_robot_world_ = T_world_robot_.inv(); 
     turtlelib::Vector2D robotshift_world{};
     bool colliding = false;
@@ -1097,7 +1110,7 @@ private:
       // Find local coordinates of obstacle
       turtlelib::Point2D obstacle_pos_world_{walls_.markers.at(i).pose.position.x, walls_.markers.at(i).pose.position.y};
       // turtlelib::Point2D obstacle_pos_robot_ = T_robot_world_(obstacle_pos_world_);
-      turtlelib::Vector2D turtle2obs_world = obstacle_pos_world_ - turtlelib::Point2D{predicted_turtle_.pose().x, predicted_turtle_.pose().y};
+      turtlelib::Vector2D turtle2obs_world = obstacle_pos_world_ - turtlelib::Point2D{predicted_pose_.x, predicted_pose_.y};
 
       // Determine which kind of wall
       double x_len = 0;
@@ -1165,12 +1178,12 @@ private:
       // Find local coordinates of obstacle
       turtlelib::Point2D obstacle_pos_world_{arena_walls_.markers.at(i).pose.position.x, arena_walls_.markers.at(i).pose.position.y};
       // turtlelib::Point2D obstacle_pos_robot_ = T_robot_world_(obstacle_pos_world_);
-      turtlelib::Vector2D turtle2obs_world = obstacle_pos_world_ - turtlelib::Point2D{predicted_turtle_.pose().x, predicted_turtle_.pose().y};
+      turtlelib::Vector2D turtle2obs_world = obstacle_pos_world_ - turtlelib::Point2D{predicted_pose_.x, predicted_pose_.y};
 
       // East Wall
       if(i == 0)
       {
-        if (predicted_turtle_.pose().x + collision_radius_ > arena_x_ / 2.0)
+        if (predicted_pose_.x + collision_radius_ > arena_x_ / 2.0)
         {
           robotshift_world.x = -(wall_breadth_/2.0 + collision_radius_) + turtle2obs_world.x;
           robotshift_world.y = 0;
@@ -1180,7 +1193,7 @@ private:
       // North Wall
       else if(i == 1)
       {
-        if (predicted_turtle_.pose().y + collision_radius_ > arena_y_ / 2.0)
+        if (predicted_pose_.y + collision_radius_ > arena_y_ / 2.0)
         {
           robotshift_world.x = 0;
           robotshift_world.y = -(wall_breadth_/2.0 + collision_radius_) + turtle2obs_world.y;
@@ -1190,7 +1203,7 @@ private:
       // West Wall
       else if(i == 2)
       {
-        if (predicted_turtle_.pose().x - collision_radius_ < -arena_x_ / 2.0)
+        if (predicted_pose_.x - collision_radius_ < -arena_x_ / 2.0)
         {
           robotshift_world.x = wall_breadth_/2.0 + collision_radius_ + turtle2obs_world.x;
           robotshift_world.y = 0;
@@ -1200,7 +1213,7 @@ private:
       // South Wall
       else if(i == 3)
       {
-        if (predicted_turtle_.pose().y - collision_radius_ < -arena_y_ / 2.0)
+        if (predicted_pose_.y - collision_radius_ < -arena_y_ / 2.0)
         {
           robotshift_world.x = 0;
           robotshift_world.y = wall_breadth_/2.0 + collision_radius_ + turtle2obs_world.y;
@@ -1211,17 +1224,17 @@ private:
 
     if (colliding)
     {
-      // turtlelib::Transform2D T_world_newrobot_ = {{predicted_turtle_.pose().x + robotshift_robot_.x, predicted_turtle_.pose().y + robotshift_robot_.y}, predicted_turtle_.pose().theta};
+      // turtlelib::Transform2D T_world_newrobot_ = {{predicted_pose_.x + robotshift_robot_.x, predicted_pose_.y + robotshift_robot_.y}, predicted_pose_.theta};
 
       if(lie_group_collision_)
       {
-        turtles_.at(turtle_idx).q.x += robotshift_world.x;
-        turtles_.at(turtle_idx).q.y += robotshift_world.y;
+        const turtlelib::Pose2D pose = turtles_.pose(turtle_idx);
+        turtles_.setPose(turtle_idx, turtlelib::Pose2D{pose.theta, pose.x + robotshift_world.x, pose.y + robotshift_world.y});
         // turtle_.q.theta = T_world_newrobot_.rotation();
       }
         
-      turtles_.at(turtle_idx).phi.left = turtlelib::normalize_angle(turtles_.at(turtle_idx).phi.left + predicted_delta_wheels_.left); // TODO: wheel rotation not working properly
-      turtles_.at(turtle_idx).phi.right = turtlelib::normalize_angle(turtles_.at(turtle_idx).phi.right + predicted_delta_wheels_.right);
+      const turtlelib::wheelAngles wheels = turtles_.wheels(turtle_idx);
+      turtles_.setWheels(turtle_idx, turtlelib::wheelAngles{wheels.left + predicted_delta_wheels_.left, wheels.right + predicted_delta_wheels_.right}); // TODO: wheel rotation not working properly
 
       // RCLCPP_DEBUG(this->get_logger(), "turtle: %f B: %f", obstacle_pos_robot_.x, obstacle_pos_robot_.y);
       return true; // Colliding with one obstacle, therefore, ignore other obstacles
@@ -1249,7 +1262,7 @@ private:
       lidars_data_.at(i).ranges.resize(lidar_num_samples_);
 
       // Offset between LIDAR and Footprint (fixed, unless things go very ugly)
-      turtlelib::Pose2D lidar_pose_{turtles_.at(i).pose().theta, turtles_.at(i).pose().x - 0.032*cos(turtles_.at(i).pose().theta), turtles_.at(i).pose().y - 0.032*sin(turtles_.at(i).pose().theta)};
+      turtlelib::Pose2D lidar_pose_{turtles_.pose(i).theta, turtles_.pose(i).x - 0.032*cos(turtles_.pose(i).theta), turtles_.pose(i).y - 0.032*sin(turtles_.pose(i).theta)};
 
       // Iterate over samples
       for (int sample_index = 0; sample_index < lidar_num_samples_; sample_index++) 
@@ -1287,15 +1300,15 @@ private:
           }
 
           // West face
-          if ((turtles_.at(i).pose().x < walls_.markers.at(j).pose.position.x - x_len/2.0) && 
+          if ((turtles_.pose(i).x < walls_.markers.at(j).pose.position.x - x_len/2.0) && 
               (walls_.markers.at(j).pose.position.x - x_len/2.0 < limit.x))
           {
             // Check if y_intercept lies on the wall
-            double y_intercept = turtles_.at(i).pose().y + slope * (walls_.markers.at(j).pose.position.x - x_len/2.0 - turtles_.at(i).pose().x);
+            double y_intercept = turtles_.pose(i).y + slope * (walls_.markers.at(j).pose.position.x - x_len/2.0 - turtles_.pose(i).x);
 
             if (std::fabs(y_intercept - walls_.markers.at(j).pose.position.y) < y_len / 2.0)
             {
-              turtlelib::Vector2D laser_vector{(walls_.markers.at(j).pose.position.x - x_len/2.0 - turtles_.at(i).pose().x), 0};
+              turtlelib::Vector2D laser_vector{(walls_.markers.at(j).pose.position.x - x_len/2.0 - turtles_.pose(i).x), 0};
               laser_vector.y = laser_vector.x * slope;
 
               lidar_reading = std::min(lidar_reading, turtlelib::magnitude(laser_vector));
@@ -1304,14 +1317,14 @@ private:
 
           // East face
           if ((limit.x < walls_.markers.at(j).pose.position.x + x_len/2.0) &&
-              (walls_.markers.at(j).pose.position.x + x_len/2.0 < turtles_.at(i).pose().x))
+              (walls_.markers.at(j).pose.position.x + x_len/2.0 < turtles_.pose(i).x))
           {
             // Check if y_intercept lies on the wall
-            double y_intercept = turtles_.at(i).pose().y + slope * (walls_.markers.at(j).pose.position.x + x_len/2.0 - turtles_.at(i).pose().x);
+            double y_intercept = turtles_.pose(i).y + slope * (walls_.markers.at(j).pose.position.x + x_len/2.0 - turtles_.pose(i).x);
 
             if (std::fabs(y_intercept - walls_.markers.at(j).pose.position.y) < y_len / 2.0)
             {
-              turtlelib::Vector2D laser_vector{(walls_.markers.at(j).pose.position.x + x_len/2.0 - turtles_.at(i).pose().x), 0};
+              turtlelib::Vector2D laser_vector{(walls_.markers.at(j).pose.position.x + x_len/2.0 - turtles_.pose(i).x), 0};
               laser_vector.y = laser_vector.x * slope;
 
               lidar_reading = std::min(lidar_reading, turtlelib::magnitude(laser_vector));
@@ -1319,15 +1332,15 @@ private:
           }
 
           // South face
-          if ((turtles_.at(i).pose().y < walls_.markers.at(j).pose.position.y - y_len/2.0) && 
+          if ((turtles_.pose(i).y < walls_.markers.at(j).pose.position.y - y_len/2.0) && 
               (walls_.markers.at(j).pose.position.y - y_len/2.0 < limit.y))
           {
             // Check if x_intercept lies on the wall
-            double x_intercept = turtles_.at(i).pose().x + (1.0 / (slope + 1e-7)) * (walls_.markers.at(j).pose.position.y - y_len/2.0 - turtles_.at(i).pose().y);
+            double x_intercept = turtles_.pose(i).x + (1.0 / (slope + 1e-7)) * (walls_.markers.at(j).pose.position.y - y_len/2.0 - turtles_.pose(i).y);
 
             if (std::fabs(x_intercept - walls_.markers.at(j).pose.position.x) < x_len / 2.0)
             {
-              turtlelib::Vector2D laser_vector{0, walls_.markers.at(j).pose.position.y - y_len/2.0 - turtles_.at(i).pose().y};
+              turtlelib::Vector2D laser_vector{0, walls_.markers.at(j).pose.position.y - y_len/2.0 - turtles_.pose(i).y};
               laser_vector.x = laser_vector.y / (slope + 1e-7);
 
               lidar_reading = std::min(lidar_reading, turtlelib::magnitude(laser_vector));
@@ -1336,14 +1349,14 @@ private:
 
           // North face
           if ((limit.y < walls_.markers.at(j).pose.position.y + y_len/2.0) &&
-              (walls_.markers.at(j).pose.position.y + y_len/2.0 < turtles_.at(i).pose().y))
+              (walls_.markers.at(j).pose.position.y + y_len/2.0 < turtles_.pose(i).y))
           {
             // Check if y_intercept lies on the wall
-            double x_intercept = turtles_.at(i).pose().x + (1.0 / (slope + 1e-7)) * (walls_.markers.at(j).pose.position.y + y_len/2.0 - turtles_.at(i).pose().y);
+            double x_intercept = turtles_.pose(i).x + (1.0 / (slope + 1e-7)) * (walls_.markers.at(j).pose.position.y + y_len/2.0 - turtles_.pose(i).y);
 
             if (std::fabs(x_intercept - walls_.markers.at(j).pose.position.x) < x_len / 2.0)
             {
-              turtlelib::Vector2D laser_vector{0, walls_.markers.at(j).pose.position.y + y_len/2.0 - turtles_.at(i).pose().y};
+              turtlelib::Vector2D laser_vector{0, walls_.markers.at(j).pose.position.y + y_len/2.0 - turtles_.pose(i).y};
               laser_vector.x = laser_vector.y / (slope + 1e-7);
 
               lidar_reading = std::min(lidar_reading, turtlelib::magnitude(laser_vector));
@@ -1409,7 +1422,16 @@ private:
     timestep_publisher_->publish(message);
     walls_publisher_->publish(walls_);
     arena_walls_publisher_->publish(arena_walls_);
-    true_simplified_map_publisher_->publish(true_simplified_map_);
+
+    // The true map only changes on reset. Publish it then, and at a low keyframe rate for late subscribers.
+    // Counting steps since the last keyframe stays correct when the keyframe rate is close to or above the timer rate.
+    steps_since_true_map_++;
+    if (true_simplified_map_.header.stamp.sec == 0 ||
+        static_cast<double>(steps_since_true_map_) * true_map_keyframe_frequency_ >= static_cast<double>(rate))
+    {
+      true_simplified_map_publisher_->publish(true_simplified_map_);
+      steps_since_true_map_ = 0;
+    }
 
     // SENSE
     geometry_msgs::msg::TransformStamped transform_stamped;
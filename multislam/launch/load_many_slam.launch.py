@@ -34,39 +34,42 @@ def launch_setup(context):
 
     iterations = int(LaunchConfiguration('iterations').perform(context))
     sim_speed_multiplier = float(LaunchConfiguration('sim_speed_multiplier').perform(context))
+    use_slam_toolbox = LaunchConfiguration('use_slam_toolbox').perform(context).lower() == 'true'
 
     units = []
 
     for i in range(iterations):
 
-        # Load and adjust slam parameters
-        slam_params_file_path = os.path.join(get_package_share_directory('multislam'), 'config', colors[i] + "_map_online_async_fake.yaml")
-        slam_params = load_slam_params(slam_params_file_path)
-        adjusted_slam_params = adjust_slam_params(slam_params['/**/slam_toolbox']['ros__parameters'], sim_speed_multiplier)
-
-        # Save adjusted parameters to a temporary file
-        with tempfile.NamedTemporaryFile(delete=False, mode='w', suffix='.yaml') as temp_file:
-            temp_slam_params_file = temp_file.name
-            adjusted_slam_params_yaml = {'/**/slam_toolbox': {'ros__parameters': adjusted_slam_params}}
-            yaml.dump(adjusted_slam_params_yaml, temp_file)
-
-        units.append(
-            GroupAction(
-                actions=[
-                    PushRosNamespace(colors[i]),
-
-                    SetRemap(src='/map', dst='/' + colors[i] + '/map'),
-
-                    IncludeLaunchDescription(
-                        PythonLaunchDescriptionSource(PathJoinSubstitution([FindPackageShare('slam_toolbox'), 'launch', 'online_async_launch.py'])),
-                        launch_arguments={
-                            "slam_params_file": temp_slam_params_file,
-                            "use_sim_time": "true",
-                        }.items(),
-                    ),
-                ]
+        # The oracle mapper replaces slam_toolbox, but the world/map/odom frames are still needed
+        if use_slam_toolbox:
+            # Load and adjust slam parameters
+            slam_params_file_path = os.path.join(get_package_share_directory('multislam'), 'config', colors[i] + "_map_online_async_fake.yaml")
+            slam_params = load_slam_params(slam_params_file_path)
+            adjusted_slam_params = adjust_slam_params(slam_params['/**/slam_toolbox']['ros__parameters'], sim_speed_multiplier)
+
+            # Save adjusted parameters to a temporary file
+            with tempfile.NamedTemporaryFile(delete=False, mode='w', suffix='.yaml') as temp_file:
+                temp_slam_params_file = temp_file.name
+                adjusted_slam_params_yaml = {'/**/slam_toolbox': {'ros__parameters': adjusted_slam_params}}
+                yaml.dump(adjusted_slam_params_yaml, temp_file)
+
+            units.append(
+                GroupAction(
+                    actions=[
+                        PushRosNamespace(colors[i]),
+
+                        SetRemap(src='/map', dst='/' + colors[i] + '/map'),
+
+                        IncludeLaunchDescription(
+                            PythonLaunchDescriptionSource(PathJoinSubstitution([FindPackageShare('slam_toolbox'), 'launch', 'online_async_launch.py'])),
+                            launch_arguments={
+                                "slam_params_file": temp_slam_params_file,
+                                "use_sim_time": "true",
+                            }.items(),
+                        ),
+                    ]
+                )
             )
-        )
 
         units.append(
             Node(package="tf2_ros",
@@ -96,6 +99,11 @@ def generate_launch_description():
             default_value="1",
             description="Simulation speed multiplier",
         ),
+        DeclareLaunchArgument(
+            name="use_slam_toolbox",
+            default_value="true",
+            description="Launch one slam_toolbox node per robot - true, false",
+        ),
     ]
 
     opfunc = OpaqueFunction(function=launch_setup)
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <functional>
 #include <memory>
 #include <string>
@@ -5,6 +8,32 @@
 
 #include "rclcpp/rclcpp.hpp"
 #include "nav_msgs/msg/occupancy_grid.hpp"
+#include "map_msgs/msg/occupancy_grid_update.hpp"
+#include "multislam/msg/map_metrics.hpp"
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2/exceptions.h"
+#include "tf2_ros/transform_listener.h"
+#include "tf2_ros/buffer.h"
+
+/// \brief Fine cells of a robot's local map that fall inside each coarse cell of the proposed map.
+///        Rebuilt only when the geometry of either map, or the frame between them, changes.
+struct CellIndexCache
+{
+    // Geometry the table was built for
+    double resolution = 0.0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    double origin_x = 0.0;
+    double origin_y = 0.0;
+    double frame_x = 0.0;
+    double frame_y = 0.0;
+    double frame_yaw = 0.0;
+    bool valid = false;
+
+    // Compressed rows: fine indices of coarse cell c are fine_idx[offsets[c] .. offsets[c+1])
+    std::vector<size_t> offsets;
+    std::vector<size_t> fine_idx;
+};
 
 class Map_Combiner : public rclcpp::Node
 {
@@ -15,14 +44,72 @@ public:
         // Parameter description
         auto num_robots_des = rcl_interfaces::msg::ParameterDescriptor{};
 
+        auto sim_speed_multiplier_des = rcl_interfaces::msg::ParameterDescriptor{};
+        auto publish_rate_des = rcl_interfaces::msg::ParameterDescriptor{};
+        auto max_latency_des = rcl_interfaces::msg::ParameterDescriptor{};
+        auto keyframe_period_des = rcl_interfaces::msg::ParameterDescriptor{};
+        auto use_oracle_map_des = rcl_interfaces::msg::ParameterDescriptor{};
+        auto robot_namespaces_des = rcl_interfaces::msg::ParameterDescriptor{};
+
         num_robots_des.description = "number of agents";
+        sim_speed_multiplier_des.description = "Margin by which to speed up simulation, compared to real-time";
+        publish_rate_des.description = "Rate at which dirty local maps are combined and published [Hz]";
+        max_latency_des.description = "Maximum time a local map may wait before it is combined [s]";
+        keyframe_period_des.description = "Time between full proposed map publications, deltas are sent in between [s]";
+        use_oracle_map_des.description = "Combine the shared oracle/map instead of one color/map per robot";
+        robot_namespaces_des.description = "Namespace of every robot's local map. Defaults to the first num_robots colors";
 
         declare_parameter("num_robots", 0, num_robots_des);     // 1,2,3,..
+        declare_parameter("sim_speed_multiplier", 1.0, sim_speed_multiplier_des);
+        declare_parameter("publish_rate", 10.0, publish_rate_des);     // Hz
+        declare_parameter("max_latency", 0.5, max_latency_des);     // Seconds
+        declare_parameter("keyframe_period", 5.0, keyframe_period_des);     // Seconds
+        declare_parameter("use_oracle_map", false, use_oracle_map_des);
+        declare_parameter("robot_namespaces", std::vector<std::string>{}, robot_namespaces_des);
 
         num_robots_ = get_parameter("num_robots").get_parameter_value().get<int>();
+        sim_speed_multiplier_ = get_parameter("sim_speed_multiplier").get_parameter_value().get<double>();
+        publish_rate_ = get_parameter("publish_rate").get_parameter_value().get<double>();
+        max_latency_ = get_parameter("max_latency").get_parameter_value().get<double>();
+        keyframe_period_ = get_parameter("keyframe_period").get_parameter_value().get<double>();
+        use_oracle_map_ = get_parameter("use_oracle_map").get_parameter_value().get<bool>();
+        robot_namespaces_ = get_parameter("robot_namespaces").get_parameter_value().get<std::vector<std::string>>();
+
+        if (robot_namespaces_.empty())
+        {
+            if (num_robots_ < 0 || num_robots_ > static_cast<int>(colors_.size()))
+            {
+                throw std::runtime_error("Incorrect map_combiner params! Pass robot_namespaces for more than " + std::to_string(colors_.size()) + " robots.");
+            }
+            robot_namespaces_.assign(colors_.begin(), colors_.begin() + num_robots_);
+        }
+        if (robot_namespaces_.size() > 127)
+        {
+            throw std::runtime_error("Incorrect map_combiner params! At most 127 robots are supported.");
+        }
+
+        if (publish_rate_ <= 0.0 || max_latency_ <= 0.0 || sim_speed_multiplier_ <= 0.0 || keyframe_period_ <= 0.0)
+        {
+            throw std::runtime_error("Incorrect map_combiner params! publish_rate, max_latency, keyframe_period and sim_speed_multiplier must be positive.");
+        }
+
+        // Latest unprocessed map, dirty flag and index cache for every robot, or for the single oracle map
+        local_maps_.resize(use_oracle_map_ ? 1 : robot_namespaces_.size());
+        dirty_.resize(local_maps_.size(), false);
+        index_caches_.resize(local_maps_.size());
+
+        // Local maps may live in their own frame, offset from the proposed map
+        tf_buffer_ = std::make_unique<tf2_ros::Buffer>(get_clock());
+        tf_listener_ = std::make_shared<tf2_ros::TransformListener>(*tf_buffer_);
 
         // Create /proposed_simplified_map publisher
         proposed_simplified_map_publisher_ = create_publisher<nav_msgs::msg::OccupancyGrid>("/proposed_simplified_map", 10);
+
+        // Create /proposed_simplified_map_updates publisher. Rviz subscribes to <topic>_updates on its own.
+        proposed_simplified_map_updates_publisher_ = create_publisher<map_msgs::msg::OccupancyGridUpdate>("/proposed_simplified_map_updates", 10);
+
+        // Create /map_metrics publisher
+        map_metrics_publisher_ = create_publisher<multislam::msg::MapMetrics>("/map_metrics", 10);
         
         // Create /true_simplified_map subscriber
         true_simplified_map_subscriber_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
@@ -30,39 +117,41 @@ public:
             &Map_Combiner::true_simplified_map_callback, this,
             std::placeholders::_1));
 
-        // Create color/map subscriber
-        // Literally the least problematic way to do this
-        cyan_map_subscriber_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
-        "cyan/map", 10, std::bind(
-            &Map_Combiner::cyan_map_callback, this,
-            std::placeholders::_1));
-        magenta_map_subscriber_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
-        "magenta/map", 10, std::bind(
-            &Map_Combiner::magenta_map_callback, this,
-            std::placeholders::_1));
-        yellow_map_subscriber_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
-        "yellow/map", 10, std::bind(
-            &Map_Combiner::yellow_map_callback, this,
-            std::placeholders::_1));
-        red_map_subscriber_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
-        "red/map", 10, std::bind(
-            &Map_Combiner::red_map_callback, this,
-            std::placeholders::_1));
-        green_map_subscriber_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
-        "green/map", 10, std::bind(
-            &Map_Combiner::green_map_callback, this,
-            std::placeholders::_1));
-        blue_map_subscriber_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
-        "blue/map", 10, std::bind(
-            &Map_Combiner::blue_map_callback, this,
-            std::placeholders::_1));
+        if (use_oracle_map_)
+        {
+            // Create oracle/map subscriber. One shared map for the whole fleet.
+            oracle_map_subscriber_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
+            "oracle/map", 10, [this](const nav_msgs::msg::OccupancyGrid & msg) { mark_dirty(msg, 0); });
+        }
+        else
+        {
+            // Create one namespace/map subscriber per robot
+            for (size_t i = 0; i < robot_namespaces_.size(); i++)
+            {
+                local_map_subscribers_.push_back(create_subscription<nav_msgs::msg::OccupancyGrid>(
+                robot_namespaces_.at(i) + "/map", 10,
+                [this, i](const nav_msgs::msg::OccupancyGrid & msg) { mark_dirty(msg, i); }));
+            }
+        }
+
+        // Create combine timer. Combines all dirty maps at once, at most publish_rate times a (sim) second.
+        std::chrono::duration<double> period(1.0 / (publish_rate_ * sim_speed_multiplier_));
+        combine_timer_ = create_wall_timer(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(period),
+            std::bind(&Map_Combiner::combine_timer_callback, this));
     } 
 
 private:
 
     // Flag to check metadata initialization from true_simplified_map
     int num_robots_;
-    std::vector<std::string> colors_ = {"cyan", "magenta", "yellow", "red", "green", "blue"};
+    double sim_speed_multiplier_;
+    double publish_rate_;
+    double max_latency_;
+    double keyframe_period_;
+    bool use_oracle_map_;
+    std::vector<std::string> robot_namespaces_;
+    std::vector<std::string> colors_ = {"cyan", "magenta", "yellow", "red", "green", "blue", "orange", "brown", "white"};
     bool initialization_flag = false;
 
     // Initialize simplified maps
@@ -71,16 +160,34 @@ private:
 
     // Initialize local maps
     std::vector<nav_msgs::msg::OccupancyGrid> local_maps_;
+    std::vector<CellIndexCache> index_caches_;
+
+    // Robots whose latest local map has not been combined yet
+    std::vector<bool> dirty_;
+    size_t num_dirty_ = 0;
+    rclcpp::Time oldest_dirty_time_;
+
+    // Coverage counters, maintained incrementally as proposed cells change
+    std::vector<int8_t> cell_owner_; // Robot that last wrote each proposed cell, -1 if none
+    multislam::msg::MapMetrics map_metrics_;
+
+    // Keyframe / delta publishing
+    bool keyframe_pending_ = true;
+    rclcpp::Time last_keyframe_time_;
+    size_t dirty_min_x_, dirty_min_y_, dirty_max_x_, dirty_max_y_; // Bounding box of cells changed since last publish
+    bool has_dirty_cells_ = false;
 
     // Create Objects
+    rclcpp::TimerBase::SharedPtr combine_timer_;
     rclcpp::Publisher<nav_msgs::msg::OccupancyGrid>::SharedPtr proposed_simplified_map_publisher_;
+    rclcpp::Publisher<map_msgs::msg::OccupancyGridUpdate>::SharedPtr proposed_simplified_map_updates_publisher_;
+    rclcpp::Publisher<multislam::msg::MapMetrics>::SharedPtr map_metrics_publisher_;
     rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr true_simplified_map_subscriber_;
-    rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr cyan_map_subscriber_;
-    rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr magenta_map_subscriber_;
-    rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr yellow_map_subscriber_;
-    rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr red_map_subscriber_;
-    rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr green_map_subscriber_;
-    rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr blue_map_subscriber_;
+    rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr oracle_map_subscriber_;
+    std::vector<rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr> local_map_subscribers_;
+
+    std::unique_ptr<tf2_ros::Buffer> tf_buffer_;
+    std::shared_ptr<tf2_ros::TransformListener> tf_listener_;
 
     void true_simplified_map_callback(const nav_msgs::msg::OccupancyGrid & msg)
     {   
@@ -118,111 +225,323 @@ private:
 
             std::fill(proposed_simplified_map_.data.begin(), proposed_simplified_map_.data.end(), -1);
 
+            // Keep the true map to score proposed cells against
+            true_simplified_map_ = msg;
+            reset_metrics();
+
+            // Every cached index table refers to the old proposed map
+            for (auto & cache : index_caches_)
+            {
+                cache.valid = false;
+            }
+
+            // Subscribers need the new geometry before any delta makes sense
+            keyframe_pending_ = true;
+            has_dirty_cells_ = false;
+
             // Map is now initialized
             initialization_flag = true;
         }
     } 
 
-    // Define all local map callbacks
-    void cyan_map_callback(const nav_msgs::msg::OccupancyGrid & msg) 
+    /// \brief Store the latest local map of a robot, to be combined by the next combine cycle
+    void mark_dirty(const nav_msgs::msg::OccupancyGrid & msg, const size_t robot_idx)
     {
-        combine_map(msg);
+        local_maps_.at(robot_idx) = msg;
+
+        if (!dirty_.at(robot_idx))
+        {
+            if (num_dirty_ == 0)
+            {
+                oldest_dirty_time_ = get_clock()->now();
+            }
+            dirty_.at(robot_idx) = true;
+            ++num_dirty_;
+        }
+
+        // Bound latency even if the timer is starved by a burst of map callbacks
+        if ((get_clock()->now() - oldest_dirty_time_).seconds() * sim_speed_multiplier_ >= max_latency_)
+        {
+            combine_dirty_maps();
+        }
     }
-    void magenta_map_callback(const nav_msgs::msg::OccupancyGrid & msg) 
+
+    /// \brief Rate limited combine cycle
+    void combine_timer_callback()
     {
-        combine_map(msg);
+        if (num_dirty_ > 0)
+        {
+            combine_dirty_maps();
+        }
     }
-    void yellow_map_callback(const nav_msgs::msg::OccupancyGrid & msg) 
+
+    /// \brief Combine every dirty local map and publish one coherent proposed map
+    void combine_dirty_maps()
     {
-        combine_map(msg);
+        for (size_t robot_idx = 0; robot_idx < dirty_.size(); robot_idx++)
+        {
+            if (dirty_.at(robot_idx))
+            {
+                // The oracle map is shared, so its cells are not credited to any robot
+                combine_map(local_maps_.at(robot_idx), index_caches_.at(robot_idx), use_oracle_map_ ? -1 : static_cast<int>(robot_idx));
+                dirty_.at(robot_idx) = false;
+            }
+        }
+        num_dirty_ = 0;
+
+        proposed_simplified_map_.header.stamp = get_clock()->now();
+        publish_proposed_map();
+
+        map_metrics_.header = proposed_simplified_map_.header;
+        map_metrics_.coverage = map_metrics_.total_cells == 0 ? 0.0 :
+            static_cast<double>(map_metrics_.correct_cells) / static_cast<double>(map_metrics_.total_cells);
+        map_metrics_publisher_->publish(map_metrics_);
     }
-    void red_map_callback(const nav_msgs::msg::OccupancyGrid & msg) 
+
+    /// \brief Publish the full map as a keyframe, or only the patch that changed since the last publish
+    void publish_proposed_map()
     {
-        combine_map(msg);
+        const auto now = get_clock()->now();
+
+        if (keyframe_pending_ || (now - last_keyframe_time_).seconds() * sim_speed_multiplier_ >= keyframe_period_)
+        {
+            proposed_simplified_map_publisher_->publish(proposed_simplified_map_);
+            last_keyframe_time_ = now;
+            keyframe_pending_ = false;
+            has_dirty_cells_ = false;
+            return;
+        }
+
+        if (!has_dirty_cells_)
+        {
+            return;
+        }
+
+        map_msgs::msg::OccupancyGridUpdate update;
+        update.header = proposed_simplified_map_.header;
+        update.x = dirty_min_x_;
+        update.y = dirty_min_y_;
+        update.width = dirty_max_x_ - dirty_min_x_ + 1;
+        update.height = dirty_max_y_ - dirty_min_y_ + 1;
+        update.data.reserve(update.width * update.height);
+
+        for (size_t j = dirty_min_y_; j <= dirty_max_y_; j++)
+        {
+            const auto row = proposed_simplified_map_.data.begin() + j * proposed_simplified_map_.info.width;
+            update.data.insert(update.data.end(), row + dirty_min_x_, row + dirty_max_x_ + 1);
+        }
+
+        proposed_simplified_map_updates_publisher_->publish(update);
+        has_dirty_cells_ = false;
     }
-    void green_map_callback(const nav_msgs::msg::OccupancyGrid & msg) 
+
+    /// \brief Recount coverage from scratch. Only needed when the true map changes.
+    void reset_metrics()
     {
-        combine_map(msg);
+        cell_owner_.assign(proposed_simplified_map_.data.size(), -1);
+
+        map_metrics_.total_cells = proposed_simplified_map_.data.size();
+        map_metrics_.correct_cells = 0;
+        map_metrics_.free_correct_cells = 0;
+        map_metrics_.occupied_correct_cells = 0;
+        map_metrics_.robot_correct_cells.assign(robot_namespaces_.size(), 0);
+
+        for (size_t idx = 0; idx < proposed_simplified_map_.data.size() && idx < true_simplified_map_.data.size(); idx++)
+        {
+            if (proposed_simplified_map_.data[idx] == true_simplified_map_.data[idx])
+            {
+                count_cell(idx, 1);
+            }
+        }
     }
-    void blue_map_callback(const nav_msgs::msg::OccupancyGrid & msg) 
+
+    /// \brief Add (+1) or remove (-1) a correct cell from the coverage counters
+    void count_cell(const size_t idx, const int sign)
     {
-        combine_map(msg);
+        map_metrics_.correct_cells += sign;
+        if (true_simplified_map_.data[idx] == 0)
+        {
+            map_metrics_.free_correct_cells += sign;
+        }
+        else if (true_simplified_map_.data[idx] == 100)
+        {
+            map_metrics_.occupied_correct_cells += sign;
+        }
+        if (cell_owner_[idx] >= 0)
+        {
+            map_metrics_.robot_correct_cells[cell_owner_[idx]] += sign;
+        }
     }
 
-    void combine_map(const nav_msgs::msg::OccupancyGrid new_map)
+    /// \brief Write a proposed cell, keeping the coverage counters up to date
+    void set_cell(const size_t idx, const int8_t value, const int owner)
     {
-        std::vector<std::vector<int>> proposed_simplified_grid(proposed_simplified_map_.info.width, std::vector<int>(proposed_simplified_map_.info.height, -1));
+        if (proposed_simplified_map_.data[idx] == value)
+        {
+            return;
+        }
 
-        // Look at each minimap
-        const int minimap_dim = static_cast<int>(proposed_simplified_map_.info.resolution / new_map.info.resolution); // cells
+        const bool scored = idx < true_simplified_map_.data.size();
 
-        const int obstacle_threshold = 3; // 5
-        const int free_threshold = 3; // 6
+        if (scored && proposed_simplified_map_.data[idx] == true_simplified_map_.data[idx])
+        {
+            count_cell(idx, -1);
+        }
+
+        proposed_simplified_map_.data[idx] = value;
+        cell_owner_[idx] = static_cast<int8_t>(owner);
+
+        // Grow the delta bounding box
+        const size_t x = idx % proposed_simplified_map_.info.width;
+        const size_t y = idx / proposed_simplified_map_.info.width;
+        if (!has_dirty_cells_)
+        {
+            dirty_min_x_ = dirty_max_x_ = x;
+            dirty_min_y_ = dirty_max_y_ = y;
+            has_dirty_cells_ = true;
+        }
+        else
+        {
+            dirty_min_x_ = std::min(dirty_min_x_, x);
+            dirty_max_x_ = std::max(dirty_max_x_, x);
+            dirty_min_y_ = std::min(dirty_min_y_, y);
+            dirty_max_y_ = std::max(dirty_max_y_, y);
+        }
+
+        if (scored && proposed_simplified_map_.data[idx] == true_simplified_map_.data[idx])
+        {
+            count_cell(idx, 1);
+        }
+    }
 
-        for (size_t i = 0; i < proposed_simplified_map_.info.width; i++)
+    /// \brief Make sure the cache maps new_map onto the proposed map. Returns false if the frame is not yet known.
+    bool update_index_cache(const nav_msgs::msg::OccupancyGrid & new_map, CellIndexCache & cache)
+    {
+        // Pose of the proposed map frame in the local map frame
+        double frame_x = 0.0, frame_y = 0.0, frame_yaw = 0.0;
+        if (!new_map.header.frame_id.empty() && new_map.header.frame_id != proposed_simplified_map_.header.frame_id)
         {
-            for (size_t j = 0; j < proposed_simplified_map_.info.height; j++)
+            geometry_msgs::msg::TransformStamped T_local_proposed;
+            try
+            {
+                T_local_proposed = tf_buffer_->lookupTransform(new_map.header.frame_id, proposed_simplified_map_.header.frame_id, tf2::TimePointZero);
+            }
+            catch (tf2::TransformException & ex)
             {
-                std::vector<std::vector<int>> minimap(minimap_dim, std::vector<int>(minimap_dim, -1));
+                RCLCPP_DEBUG(get_logger(), "Could not get transform: %s", ex.what());
+                return false;
+            }
+            const auto & q = T_local_proposed.transform.rotation;
+            frame_x = T_local_proposed.transform.translation.x;
+            frame_y = T_local_proposed.transform.translation.y;
+            frame_yaw = std::atan2(2.0 * (q.w * q.z + q.x * q.y), 1.0 - 2.0 * (q.y * q.y + q.z * q.z));
+        }
 
-                int obstacle_count = 0; // Counter for obstacles in the minimap
-                int free_count = 0; // Counter for free spaces in the minimap
+        if (cache.valid &&
+            cache.resolution == new_map.info.resolution &&
+            cache.width == new_map.info.width &&
+            cache.height == new_map.info.height &&
+            cache.origin_x == new_map.info.origin.position.x &&
+            cache.origin_y == new_map.info.origin.position.y &&
+            cache.frame_x == frame_x &&
+            cache.frame_y == frame_y &&
+            cache.frame_yaw == frame_yaw)
+        {
+            return true;
+        }
 
-                for (size_t p = 0; p < static_cast<size_t>(minimap_dim); p++)
+        cache.resolution = new_map.info.resolution;
+        cache.width = new_map.info.width;
+        cache.height = new_map.info.height;
+        cache.origin_x = new_map.info.origin.position.x;
+        cache.origin_y = new_map.info.origin.position.y;
+        cache.frame_x = frame_x;
+        cache.frame_y = frame_y;
+        cache.frame_yaw = frame_yaw;
+
+        // Look at each minimap
+        const int minimap_dim = static_cast<int>(proposed_simplified_map_.info.resolution / new_map.info.resolution); // cells
+        const double c = std::cos(frame_yaw);
+        const double s = std::sin(frame_yaw);
+
+        cache.offsets.assign(1, 0);
+        cache.fine_idx.clear();
+
+        // Coarse cells are row major, like the proposed map data
+        for (size_t j = 0; j < proposed_simplified_map_.info.height; j++)
+        {
+            for (size_t i = 0; i < proposed_simplified_map_.info.width; i++)
+            {
+                for (int p = 0; p < minimap_dim; p++)
                 {
-                    for (size_t q = 0; q < static_cast<size_t>(minimap_dim); q++)
+                    for (int q = 0; q < minimap_dim; q++)
                     {
-                        // Calculate position of the current cell in the high-resolution map
-                        double x = proposed_simplified_map_.info.origin.position.x + 
-                                    (static_cast<double>(i) * proposed_simplified_map_.info.resolution) + 
+                        // Calculate position of the current cell in the proposed map frame
+                        const double x = proposed_simplified_map_.info.origin.position.x +
+                                    (static_cast<double>(i) * proposed_simplified_map_.info.resolution) +
                                     (static_cast<double>(p) * new_map.info.resolution);
-                                    // static_cast<double>(proposed_simplified_map_.info.resolution)/2.0; // meters
-                        double y = proposed_simplified_map_.info.origin.position.y + 
-                                    (static_cast<double>(j) * proposed_simplified_map_.info.resolution) + 
+                        const double y = proposed_simplified_map_.info.origin.position.y +
+                                    (static_cast<double>(j) * proposed_simplified_map_.info.resolution) +
                                     (static_cast<double>(q) * new_map.info.resolution);
-                                    // static_cast<double>(proposed_simplified_map_.info.resolution)/2.0; // meters
+
+                        // Express it in the local map frame
+                        const double x_local = frame_x + c * x - s * y;
+                        const double y_local = frame_y + s * x + c * y;
 
                         // Convert position to grid indices in the high-resolution map
-                        int new_map_idx_x = (x - new_map.info.origin.position.x) / new_map.info.resolution;
-                        int new_map_idx_y = (y - new_map.info.origin.position.y) / new_map.info.resolution;
+                        const int new_map_idx_x = static_cast<int>(std::floor((x_local - new_map.info.origin.position.x) / new_map.info.resolution));
+                        const int new_map_idx_y = static_cast<int>(std::floor((y_local - new_map.info.origin.position.y) / new_map.info.resolution));
 
                         if (0 <= new_map_idx_x && new_map_idx_x < static_cast<int>(new_map.info.width) &&
                             0 <= new_map_idx_y && new_map_idx_y < static_cast<int>(new_map.info.height))
                         {
-                            // Calculate index in the high-resolution map
-                            int new_map_idx = new_map_idx_y * new_map.info.width + new_map_idx_x;
-                            
-                            minimap[p][q] = new_map.data[new_map_idx];
-                            
-                            // Count obstacles
-                            if (minimap[p][q] == 100) {
-                                obstacle_count++;
-                            }
-                            else if (minimap[p][q] == 0) {
-                                free_count++;
-                            }
+                            cache.fine_idx.push_back(static_cast<size_t>(new_map_idx_y) * new_map.info.width + static_cast<size_t>(new_map_idx_x));
                         }
                     }
                 }
-                
-                // Mark cell as unexplored by default
-                int current_cell_idx = j * proposed_simplified_map_.info.width + i;
-                // proposed_simplified_map_.data[current_cell_idx] = -1;
-                
-                // Mark cells as free or obstacle. Obstacles given priority.
-                if (free_count >= free_threshold) {
-                    // Mark the current cell in the low-resolution map as an obstacle
-                    proposed_simplified_map_.data[current_cell_idx] = 0;
+                cache.offsets.push_back(cache.fine_idx.size());
+            }
+        }
+
+        cache.valid = true;
+        return true;
+    }
+
+    void combine_map(const nav_msgs::msg::OccupancyGrid & new_map, CellIndexCache & cache, const int owner)
+    {
+        if (!update_index_cache(new_map, cache))
+        {
+            return;
+        }
+
+        const int obstacle_threshold = 3; // 5
+        const int free_threshold = 3; // 6
+
+        for (size_t current_cell_idx = 0; current_cell_idx + 1 < cache.offsets.size(); current_cell_idx++)
+        {
+            int obstacle_count = 0; // Counter for obstacles in the minimap
+            int free_count = 0; // Counter for free spaces in the minimap
+
+            for (size_t k = cache.offsets[current_cell_idx]; k < cache.offsets[current_cell_idx + 1]; k++)
+            {
+                // Count obstacles
+                const int8_t value = new_map.data[cache.fine_idx[k]];
+                if (value == 100) {
+                    obstacle_count++;
                 }
-                if (obstacle_count >= obstacle_threshold) {
-                // if (obstacle_count > 0) {
-                    // Mark the current cell in the low-resolution map as an obstacle
-                    proposed_simplified_map_.data[current_cell_idx] = 100;
-                    // proposed_simplified_map_.data[current_cell_idx] = obstacle_count * 10;
+                else if (value == 0) {
+                    free_count++;
                 }
             }
+
+            // Mark cells as free or obstacle. Obstacles given priority.
+            if (free_count >= free_threshold) {
+                set_cell(current_cell_idx, 0, owner);
+            }
+            if (obstacle_count >= obstacle_threshold) {
+                set_cell(current_cell_idx, 100, owner);
+            }
         }
-        proposed_simplified_map_publisher_->publish(proposed_simplified_map_);
     }
 };
 
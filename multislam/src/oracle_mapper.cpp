@@ -0,0 +1,351 @@
+/// \file
+/// \brief Known-pose occupancy mapper. Ray-traces every robot's fake lidar scan into one shared
+///        grid using the ground truth poses from TF. Stands in for the per-robot slam_toolbox
+///        nodes during training.
+///
+/// PARAMETERS:
+///     \param num_robots (int): Number of agents
+///     \param sim_speed_multiplier (double): Margin by which to speed up simulation
+///     \param update_rate (double): Rate at which pending scans are integrated and published [Hz]
+///     \param resolution (double): Resolution of the shared grid [m/cell]
+///     \param clear_on_no_return (bool): Treat a zero range as free space up to range_max. Off by default,
+///            multisim also reports ranges below its minimum range as zero
+///
+/// PUBLISHES:
+///     \param oracle/map (nav_msgs::msg::OccupancyGrid): Shared grid built from all robots
+///
+/// SUBSCRIBES:
+///     \param /true_simplified_map (nav_msgs::msg::OccupancyGrid): Arena extents and world resets
+///     \param color/fake_lidar_scan (sensor_msgs::msg::LaserScan): Lidar scan of every robot
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "nav_msgs/msg/occupancy_grid.hpp"
+#include "sensor_msgs/msg/laser_scan.hpp"
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2/exceptions.h"
+#include "tf2_ros/transform_listener.h"
+#include "tf2_ros/buffer.h"
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/se2d.hpp"
+
+/// \brief Log odds increments and bounds for the shared grid
+constexpr float log_odds_hit = 0.85f;
+constexpr float log_odds_miss = -0.4f;
+constexpr float log_odds_min = -2.0f;
+constexpr float log_odds_max = 3.5f;
+
+class Oracle_Mapper : public rclcpp::Node
+{
+public:
+  Oracle_Mapper()
+    : Node("oracle_mapper")
+    {
+        // Parameter description
+        auto num_robots_des = rcl_interfaces::msg::ParameterDescriptor{};
+        auto sim_speed_multiplier_des = rcl_interfaces::msg::ParameterDescriptor{};
+        auto update_rate_des = rcl_interfaces::msg::ParameterDescriptor{};
+        auto resolution_des = rcl_interfaces::msg::ParameterDescriptor{};
+        auto clear_on_no_return_des = rcl_interfaces::msg::ParameterDescriptor{};
+
+        num_robots_des.description = "number of agents";
+        sim_speed_multiplier_des.description = "Margin by which to speed up simulation, compared to real-time";
+        update_rate_des.description = "Rate at which pending scans are integrated and published [Hz]";
+        resolution_des.description = "Resolution of the shared grid [m/cell]";
+        clear_on_no_return_des.description = "Treat a zero range as free space up to range_max. Multisim also reports zero below its minimum range";
+
+        declare_parameter("num_robots", 0, num_robots_des);     // 1,2,3,..
+        declare_parameter("sim_speed_multiplier", 1.0, sim_speed_multiplier_des);
+        declare_parameter("update_rate", 5.0, update_rate_des);     // Hz, matches the fake lidar
+        declare_parameter("resolution", 0.02, resolution_des);     // Meters, matches slam_toolbox configs
+        declare_parameter("clear_on_no_return", false, clear_on_no_return_des);     // A robot against a wall would clear through it
+
+        num_robots_ = get_parameter("num_robots").get_parameter_value().get<int>();
+        sim_speed_multiplier_ = get_parameter("sim_speed_multiplier").get_parameter_value().get<double>();
+        update_rate_ = get_parameter("update_rate").get_parameter_value().get<double>();
+        resolution_ = get_parameter("resolution").get_parameter_value().get<double>();
+        clear_on_no_return_ = get_parameter("clear_on_no_return").get_parameter_value().get<bool>();
+
+        if (num_robots_ < 0 || num_robots_ > static_cast<int>(colors_.size()))
+        {
+            throw std::runtime_error("Incorrect oracle_mapper params! num_robots must be in [0, " + std::to_string(colors_.size()) + "].");
+        }
+        if (update_rate_ <= 0.0 || resolution_ <= 0.0 || sim_speed_multiplier_ <= 0.0)
+        {
+            throw std::runtime_error("Incorrect oracle_mapper params! update_rate, resolution and sim_speed_multiplier must be positive.");
+        }
+
+        pending_scans_.resize(num_robots_);
+
+        // Ground truth poses come from TF, which multisim broadcasts from the true robot state
+        tf_buffer_ = std::make_unique<tf2_ros::Buffer>(get_clock());
+        tf_listener_ = std::make_shared<tf2_ros::TransformListener>(*tf_buffer_);
+
+        // Create oracle/map publisher
+        map_publisher_ = create_publisher<nav_msgs::msg::OccupancyGrid>("oracle/map", 10);
+
+        // Create /true_simplified_map subscriber
+        true_simplified_map_subscriber_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
+        "/true_simplified_map", 10, std::bind(
+            &Oracle_Mapper::true_simplified_map_callback, this,
+            std::placeholders::_1));
+
+        // Create color/fake_lidar_scan subscribers
+        for (int i = 0; i < num_robots_; i++)
+        {
+            scan_subscribers_.push_back(create_subscription<sensor_msgs::msg::LaserScan>(
+            colors_.at(i) + "/fake_lidar_scan", 10,
+            [this, i](const sensor_msgs::msg::LaserScan & msg) { pending_scans_.at(i) = msg; }));
+        }
+
+        // Create update timer. Integrates every robot's latest scan in one batch.
+        std::chrono::duration<double> period(1.0 / (update_rate_ * sim_speed_multiplier_));
+        update_timer_ = create_wall_timer(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(period),
+            std::bind(&Oracle_Mapper::update_timer_callback, this));
+    }
+
+private:
+
+    int num_robots_;
+    double sim_speed_multiplier_;
+    double update_rate_;
+    double resolution_;
+    bool clear_on_no_return_;
+    std::vector<std::string> colors_ = {"cyan", "magenta", "yellow", "red", "green", "blue", "orange", "brown", "white"};
+    bool initialization_flag = false;
+
+    // Shared grid. Log odds are the state, map_.data mirrors their sign for publishing.
+    nav_msgs::msg::OccupancyGrid map_;
+    std::vector<float> log_odds_;
+    int true_map_width_ = 0;
+    int true_map_height_ = 0;
+
+    // Latest unprocessed scan of every robot
+    std::vector<std::optional<sensor_msgs::msg::LaserScan>> pending_scans_;
+
+    // Beam direction tables, recomputed only when the scan geometry changes.
+    // Single precision, like the ranges, so the rotation runs on twice as many lanes.
+    float table_angle_min_ = std::numeric_limits<float>::quiet_NaN();
+    float table_angle_increment_ = std::numeric_limits<float>::quiet_NaN();
+    std::vector<float> cos_table_;
+    std::vector<float> sin_table_;
+
+    // Beam directions of the scan being integrated, in the world frame
+    std::vector<float> beam_dx_;
+    std::vector<float> beam_dy_;
+
+    // Declare subscribers, publishers and timer
+    rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::SharedPtr true_simplified_map_subscriber_;
+    std::vector<rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr> scan_subscribers_;
+    rclcpp::Publisher<nav_msgs::msg::OccupancyGrid>::SharedPtr map_publisher_;
+    rclcpp::TimerBase::SharedPtr update_timer_;
+
+    std::unique_ptr<tf2_ros::Buffer> tf_buffer_;
+    std::shared_ptr<tf2_ros::TransformListener> tf_listener_;
+
+    /// \brief Size the shared grid to the arena, and clear it whenever the world is reset
+    void true_simplified_map_callback(const nav_msgs::msg::OccupancyGrid & msg)
+    {
+        if (initialization_flag &&
+            true_map_width_ == static_cast<int>(msg.info.width) &&
+            true_map_height_ == static_cast<int>(msg.info.height) &&
+            msg.header.stamp.sec != 0)
+        {
+            return;
+        }
+
+        true_map_width_ = msg.info.width;
+        true_map_height_ = msg.info.height;
+
+        map_.header.frame_id = msg.header.frame_id;
+        map_.info.map_load_time = get_clock()->now();
+        map_.info.resolution = resolution_;
+        map_.info.width = static_cast<unsigned int>(std::ceil(msg.info.width * msg.info.resolution / resolution_));
+        map_.info.height = static_cast<unsigned int>(std::ceil(msg.info.height * msg.info.resolution / resolution_));
+        map_.info.origin = msg.info.origin;
+
+        map_.data.assign(map_.info.width * map_.info.height, -1);
+        log_odds_.assign(map_.data.size(), 0.0f);
+
+        // Scans taken in the previous world are meaningless now
+        for (auto & scan : pending_scans_)
+        {
+            scan.reset();
+        }
+
+        initialization_flag = true;
+    }
+
+    /// \brief Integrate all pending scans and publish the shared grid once
+    void update_timer_callback()
+    {
+        if (!initialization_flag)
+        {
+            return;
+        }
+
+        bool updated = false;
+        for (int i = 0; i < num_robots_; i++)
+        {
+            if (!pending_scans_.at(i))
+            {
+                continue;
+            }
+
+            geometry_msgs::msg::TransformStamped T_world_scan;
+            try
+            {
+                T_world_scan = tf_buffer_->lookupTransform(map_.header.frame_id, pending_scans_.at(i)->header.frame_id, tf2::TimePointZero);
+            }
+            catch (tf2::TransformException & ex)
+            {
+                RCLCPP_DEBUG(get_logger(), "Could not get transform: %s", ex.what());
+                continue;
+            }
+
+            integrate_scan(*pending_scans_.at(i), T_world_scan);
+            pending_scans_.at(i).reset();
+            updated = true;
+        }
+
+        if (updated)
+        {
+            map_.header.stamp = get_clock()->now();
+            map_publisher_->publish(map_);
+        }
+    }
+
+    /// \brief Recompute the beam direction tables if the scan geometry changed
+    void update_tables(const sensor_msgs::msg::LaserScan & scan)
+    {
+        if (scan.angle_min == table_angle_min_ &&
+            scan.angle_increment == table_angle_increment_ &&
+            scan.ranges.size() == cos_table_.size())
+        {
+            return;
+        }
+
+        table_angle_min_ = scan.angle_min;
+        table_angle_increment_ = scan.angle_increment;
+        cos_table_.resize(scan.ranges.size());
+        sin_table_.resize(scan.ranges.size());
+        for (size_t k = 0; k < scan.ranges.size(); k++)
+        {
+            const double angle = scan.angle_min + static_cast<double>(k) * scan.angle_increment;
+            cos_table_[k] = static_cast<float>(std::cos(angle));
+            sin_table_[k] = static_cast<float>(std::sin(angle));
+        }
+    }
+
+    /// \brief Ray-trace one scan taken at a known pose
+    void integrate_scan(const sensor_msgs::msg::LaserScan & scan, const geometry_msgs::msg::TransformStamped & T_world_scan)
+    {
+        update_tables(scan);
+
+        const auto & q = T_world_scan.transform.rotation;
+        const double yaw = std::atan2(2.0 * (q.w * q.z + q.x * q.y), 1.0 - 2.0 * (q.y * q.y + q.z * q.z));
+
+        // Rotate all the tabulated beam directions into the world frame at once
+        turtlelib::Transform2F{turtlelib::Vector2F{}, static_cast<float>(yaw)}.apply(cos_table_, sin_table_, beam_dx_, beam_dy_);
+
+        // Scan origin in continuous grid coordinates [cells]
+        const double gx0 = (T_world_scan.transform.translation.x - map_.info.origin.position.x) / resolution_;
+        const double gy0 = (T_world_scan.transform.translation.y - map_.info.origin.position.y) / resolution_;
+
+        for (size_t k = 0; k < scan.ranges.size(); k++)
+        {
+            double range = scan.ranges[k];
+            bool hit = true;
+
+            if (!std::isfinite(range) || range == 0.0)
+            {
+                if (!clear_on_no_return_)
+                {
+                    continue;
+                }
+                range = scan.range_max;
+                hit = false;
+            }
+            else if (range < scan.range_min || range > scan.range_max)
+            {
+                continue;
+            }
+
+            const double cells = range / resolution_;
+
+            trace_ray(gx0, gy0, gx0 + beam_dx_[k] * cells, gy0 + beam_dy_[k] * cells, hit);
+        }
+    }
+
+    /// \brief Amanatides-Woo traversal from (gx0, gy0) to (gx1, gy1), in cells.
+    ///        Every crossed cell is marked free, the last one occupied if the beam hit something.
+    void trace_ray(const double gx0, const double gy0, const double gx1, const double gy1, const bool hit)
+    {
+        int ix = static_cast<int>(std::floor(gx0));
+        int iy = static_cast<int>(std::floor(gy0));
+        const int ex = static_cast<int>(std::floor(gx1));
+        const int ey = static_cast<int>(std::floor(gy1));
+
+        const double dx = gx1 - gx0;
+        const double dy = gy1 - gy0;
+        const int step_x = dx > 0.0 ? 1 : -1;
+        const int step_y = dy > 0.0 ? 1 : -1;
+
+        constexpr double inf = std::numeric_limits<double>::infinity();
+        const double t_delta_x = dx != 0.0 ? std::abs(1.0 / dx) : inf;
+        const double t_delta_y = dy != 0.0 ? std::abs(1.0 / dy) : inf;
+        double t_max_x = dx > 0.0 ? (ix + 1 - gx0) * t_delta_x : (dx < 0.0 ? (gx0 - ix) * t_delta_x : inf);
+        double t_max_y = dy > 0.0 ? (iy + 1 - gy0) * t_delta_y : (dy < 0.0 ? (gy0 - iy) * t_delta_y : inf);
+
+        int steps = std::abs(ex - ix) + std::abs(ey - iy);
+        for (; steps > 0; steps--)
+        {
+            update_cell(ix, iy, log_odds_miss);
+
+            if (t_max_x < t_max_y)
+            {
+                t_max_x += t_delta_x;
+                ix += step_x;
+            }
+            else
+            {
+                t_max_y += t_delta_y;
+                iy += step_y;
+            }
+        }
+
+        update_cell(ex, ey, hit ? log_odds_hit : log_odds_miss);
+    }
+
+    /// \brief Add a log odds increment to a cell, ignoring cells outside the grid
+    void update_cell(const int ix, const int iy, const float increment)
+    {
+        if (ix < 0 || iy < 0 || ix >= static_cast<int>(map_.info.width) || iy >= static_cast<int>(map_.info.height))
+        {
+            return;
+        }
+
+        const size_t idx = static_cast<size_t>(iy) * map_.info.width + static_cast<size_t>(ix);
+        float & l = log_odds_[idx];
+        l = std::min(log_odds_max, std::max(log_odds_min, l + increment));
+        map_.data[idx] = l > 0.0f ? 100 : (l < 0.0f ? 0 : -1);
+    }
+};
+
+/// \brief Main function for node create, error handel and shutdown
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<Oracle_Mapper>());
+  rclcpp::shutdown();
+  return 0;
+}
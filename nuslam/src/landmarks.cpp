@@ -29,6 +29,8 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <algorithm>
+#include <array>
 #include <armadillo>
 
 #include "rclcpp/rclcpp.hpp"
@@ -101,12 +103,23 @@ public:
 
 private:
   // Variables
-  bool clustering_flag = true; // True while building a cluster
   double threshold_dist_ = 0.1; // Threshold for clustering lidar data
-  double threshold_points_ = 2; // Threshold for clustering lidar data
+  size_t min_cluster_points_ = 4; // Clusters with fewer points are noise
   double obstacles_r_ = -1.0;    // Size of obstacles
   double obstacles_h_ = 0.25;
   double lidar_height_ = 0.182;
+  std::vector<turtlelib::Point2D> cluster_points_{}; // Points of every cluster of a scan, back to back
+  std::vector<size_t> cluster_offsets_{}; // Start of each cluster in cluster_points_, and the end of the last
+  std::vector<turtlelib::Circle> fitted_circles_{}; // Circle fit of each cluster
+  std::vector<turtlelib::Circle> circle_list_{}; // Fitted circles that pass as obstacles
+  std::vector<double> scan_cos_{}; // Cosine of the bearing of each lidar ray
+  std::vector<double> scan_sin_{}; // Sine of the bearing of each lidar ray
+  float table_angle_min_ = 0.0; // Scan geometry the bearing tables were computed for
+  float table_angle_increment_ = 0.0;
+  std::vector<turtlelib::Point2D> scan_points_{}; // Lidar returns of one scan in the lidar frame
+  std::vector<bool> scan_hits_{}; // Whether each lidar ray hit an object
+  turtlelib::ClusterLimits cluster_limits_{}; // Thresholds of the pre-fit cluster classifier
+  std::array<size_t, 6> reject_counts_{}; // Clusters of the last scan by ClusterReject reason
 
   // Create objects
   rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr lidar_subscriber_;
@@ -116,72 +129,125 @@ private:
   /// \brief Lidar sensor topic callback
   void lidar_callback(const sensor_msgs::msg::LaserScan & msg)
   {
-    std::vector<std::vector<turtlelib::Point2D>> clusters; // Vector of clusters
-    bool Flag_cluster_wrap_around = false; // Flag that notifies if wrap around of a cluster has occured
-
-    for (size_t i = 0; i < msg.ranges.size(); i++) { //  Loop through one cycle of lidar points
-      if (msg.ranges.at(i) > 0.01) { // Check if the lidar point hit an object
-        std::vector<turtlelib::Point2D> temp_cluster{};     // Create a possible cluster
-        clustering_flag = true;
-        size_t count = 0;
-
-        while (clustering_flag) {
-          turtlelib::Point2D point_i = PolarToCartesian(
-            msg.ranges.at(
-              (i + count) % 360),
-            turtlelib::normalize_angle(((i + count) % 360) * turtlelib::PI / 180.0));
-          if (count == 0) {
-            temp_cluster.push_back(point_i);
-          }
-          turtlelib::Point2D point_next_i = PolarToCartesian(
-            msg.ranges.at(
-              (i + 1 + count) % 360),
-            turtlelib::normalize_angle(((i + 1 + count) % 360) * turtlelib::PI / 180.0));
-          double distance_to_next = turtlelib::magnitude(point_i - point_next_i);
-
-          if (distance_to_next < threshold_dist_) {
-            // Save to vector
-            temp_cluster.push_back(point_next_i);
-            // Check next point in lidar scan
-            count++;
-          } else if (count > threshold_points_) { // We have atleast 4 points in the cluster
-            // End of cluster
-            clustering_flag = false;
-            i = i + count - 1;
-
-            // Save cluster to list of clusters
-            clusters.push_back(temp_cluster);
-          } else {
-            clustering_flag = false;
-          }
-
-          // Check if wrap around of clusters has occured > 360 Degree
-          if (i + 1 + count >= 360) {
-            Flag_cluster_wrap_around = true;
-          }
-        }
+    segment_scan(msg); // Cluster the scan into cluster_points_ and cluster_offsets_
+    create_clusters_array(); // Create and publish clusters
+    reject_non_circular_clusters(); // Drop walls and clutter before fitting
+    circle_fit(); // Fit circle to clusters
+  }
+
+  /// \brief Remove the clusters that cannot be circles from the flat cluster buffer, in place,
+  ///        and count the reason of each rejection
+  void reject_non_circular_clusters()
+  {
+    reject_counts_.fill(0);
+    size_t kept_points = 0;
+    size_t kept_clusters = 0;
+    for (size_t i = 0; i + 1 < cluster_offsets_.size(); i++) {
+      const size_t first = cluster_offsets_.at(i);
+      const size_t count = cluster_offsets_.at(i + 1) - first;
+      const turtlelib::ClusterReject reason =
+        turtlelib::classify_cluster(cluster_points_.data() + first, count, cluster_limits_);
+      reject_counts_.at(static_cast<size_t>(reason))++;
+      if (reason != turtlelib::ClusterReject::none) {
+        continue;
       }
+
+      // Shift the kept cluster down over the rejected ones
+      std::copy(cluster_points_.begin() + first, cluster_points_.begin() + first + count, cluster_points_.begin() + kept_points);
+      kept_points += count;
+      kept_clusters++;
+      cluster_offsets_.at(kept_clusters) = kept_points;
     }
+    cluster_points_.resize(kept_points);
+    cluster_offsets_.resize(kept_clusters + 1);
+
+    RCLCPP_DEBUG(get_logger(), "Clusters kept: %zu, rejected as %s: %zu, %s: %zu, %s: %zu, %s: %zu, %s: %zu",
+      reject_counts_.at(0),
+      turtlelib::to_string(turtlelib::ClusterReject::too_few_points), reject_counts_.at(1),
+      turtlelib::to_string(turtlelib::ClusterReject::too_wide), reject_counts_.at(2),
+      turtlelib::to_string(turtlelib::ClusterReject::angle_out_of_range), reject_counts_.at(3),
+      turtlelib::to_string(turtlelib::ClusterReject::angle_spread), reject_counts_.at(4),
+      turtlelib::to_string(turtlelib::ClusterReject::arc_mismatch), reject_counts_.at(5));
+  }
 
-    // If wrap around has occured check if the last cluster contains the first cluster
-    if (Flag_cluster_wrap_around == true) {
-      if (clusters.at(0).back().x == clusters.back().back().x &&
-        clusters.at(0).back().y == clusters.back().back().y)                                                            //  Only delete if if there is an encapsuled cluster
-      {
-        clusters.at(0) = clusters.back();     // Save last cluster as first
-        clusters.pop_back();     // Delete last cluster
-      }
+  /// \brief Recompute the bearing tables when the scan geometry changes
+  /// \param msg laser scan (sensor_msgs::msg::LaserScan)
+  void update_trig_tables(const sensor_msgs::msg::LaserScan & msg)
+  {
+    if (scan_cos_.size() == msg.ranges.size() &&
+      table_angle_min_ == msg.angle_min &&
+      table_angle_increment_ == msg.angle_increment)
+    {
+      return;
+    }
+
+    scan_cos_.resize(msg.ranges.size());
+    scan_sin_.resize(msg.ranges.size());
+    for (size_t k = 0; k < msg.ranges.size(); k++) {
+      const double bearing = turtlelib::normalize_angle(msg.angle_min + k * msg.angle_increment);
+      scan_cos_.at(k) = cos(bearing);
+      scan_sin_.at(k) = sin(bearing);
+    }
+    table_angle_min_ = msg.angle_min;
+    table_angle_increment_ = msg.angle_increment;
+    scan_points_.resize(msg.ranges.size());
+    scan_hits_.resize(msg.ranges.size());
+  }
+
+  /// \brief Split one full revolution of the lidar into clusters of neighbouring hits, in a single pass.
+  ///        Clusters are written back to back into cluster_points_, with their bounds in cluster_offsets_.
+  ///        A cluster across the end of the scan is kept whole by starting the pass where no cluster continues.
+  /// \param msg laser scan (sensor_msgs::msg::LaserScan)
+  void segment_scan(const sensor_msgs::msg::LaserScan & msg)
+  {
+    update_trig_tables(msg);
+    cluster_points_.clear();
+    cluster_offsets_.assign(1, 0);
+
+    const size_t N = msg.ranges.size();
+    if (N == 0) {
+      return;
+    }
+
+    for (size_t k = 0; k < N; k++) {
+      scan_hits_.at(k) = msg.ranges.at(k) > 0.01; // Check if the lidar point hit an object
+      scan_points_.at(k) = {msg.ranges.at(k) * scan_cos_.at(k), msg.ranges.at(k) * scan_sin_.at(k)};
+    }
 
-      // TODO - Better than checking exact values above???????
-      // if (euclidean_distance(clusters.at(0).back().x, clusters.at(0).back().y, clusters.back().back().x, clusters.back().back().y) < threshold_dist_)
-      // {
-      //     clusters.at(0) = clusters.back(); // Save last cluster as first
-      //     clusters.pop_back(); // Delete last cluster
-      // }
+    // Whether point k and the point after it belong to the same cluster
+    const auto linked = [&](size_t k) {
+        const size_t next = (k + 1) % N;
+        return scan_hits_.at(k) && scan_hits_.at(next) &&
+               turtlelib::magnitude(scan_points_.at(next) - scan_points_.at(k)) < threshold_dist_;
+      };
+
+    // Step back from the first point to the start of its cluster. If every point is linked, the scan is one ring.
+    size_t start = 0;
+    for (size_t steps = 0; steps < N && linked((start + N - 1) % N); steps++) {
+      start = (start + N - 1) % N;
     }
 
-    circle_fit(clusters); // Fit circle to clusters
-    create_clusters_array(clusters); // Create and publish clusters
+    size_t cluster_size = 0;
+    const auto close_cluster = [&]() {
+        if (cluster_size >= min_cluster_points_) {
+          cluster_offsets_.push_back(cluster_points_.size());
+        } else {
+          cluster_points_.resize(cluster_points_.size() - cluster_size); // Too few points, drop as noise
+        }
+        cluster_size = 0;
+      };
+
+    for (size_t m = 0; m < N; m++) {
+      const size_t k = (start + m) % N;
+      if (!scan_hits_.at(k)) {
+        continue;
+      }
+      cluster_points_.push_back(scan_points_.at(k));
+      cluster_size++;
+      if (!linked(k) || m + 1 == N) {
+        close_cluster();
+      }
+    }
   }
 
   // /// \brief Lidar sensor topic callback
@@ -264,30 +330,34 @@ private:
 
   // CITATION BEGINS ------------------------ https://github.com/Marnonel6/EKF_SLAM_from_scratch/blob/main/nuslam/src/landmarks.cpp 
   /// \brief Run the circle fitting algorithm to get the circle radius and location (x,y)
-  void circle_fit(std::vector<std::vector<turtlelib::Point2D>> clusters)
+  void circle_fit()
   {
-    std::vector<turtlelib::Circle> circle_list{};
+    circle_list_.clear();
 
     double radius_tolerance = 0.01;
 
-    // Iterate through clusters and pass to circle fitting function
-    for (size_t i = 0; i < clusters.size(); i++) {
-      turtlelib::Circle circle_params = turtlelib::circle_fitting(clusters.at(i));
+    // Fit every cluster of the flat buffer at once
+    const size_t num_clusters = cluster_offsets_.size() - 1;
+    fitted_circles_.resize(num_clusters);
+    turtlelib::circle_fitting_batch(cluster_points_.data(), cluster_offsets_.data(), num_clusters, fitted_circles_.data());
+
+    for (size_t i = 0; i < num_clusters; i++) {
+      const turtlelib::Circle & circle_params = fitted_circles_.at(i);
       if (circle_params.R < 0.1 && circle_params.R > 0.01) { // Filter circle for radii smaller than 0.1 and greater than 0.01
         if(fabs(circle_params.R - obstacles_r_) <= radius_tolerance)
         {
-          circle_list.push_back(circle_params);
+          circle_list_.push_back(circle_params);
         }
       }
     }
 
-    create_circles_array(circle_list); // Publish fitted circles as a MarkerArray
+    create_circles_array(circle_list_); // Publish fitted circles as a MarkerArray
 
   }
   // CITATION ENDS
 
   /// \brief Create circle fitted MarkerArray as seen by Circle fitting algorithm and publish them to a topic to display them in Rviz
-  void create_circles_array(std::vector<turtlelib::Circle> circle_list)
+  void create_circles_array(const std::vector<turtlelib::Circle> & circle_list)
   {
     visualization_msgs::msg::MarkerArray circles_;
 
@@ -322,22 +392,22 @@ private:
   }
 
   /// \brief Create clusters MarkerArray as seen by Clustering algorithm and publish them to a topic to display them in Rviz
-  void create_clusters_array(std::vector<std::vector<turtlelib::Point2D>> clusters)
+  void create_clusters_array()
   {
     // // Offset between LIDAR and Footprint (fixed, unless things go very ugly)
     // turtlelib::Pose2D lidar_pose_{turtle_.pose().theta, turtle_.pose().x - 0.032*cos(turtle_.pose().theta), turtle_.pose().y - 0.032*sin(turtle_.pose().theta)};
     
     visualization_msgs::msg::MarkerArray clusters_;
 
-    for (size_t i = 0; i < clusters.size(); i++) 
+    for (size_t i = 0; i + 1 < cluster_offsets_.size(); i++) 
     {
       double x_avg = 0.0;
       double y_avg = 0.0;
       double num_elements = 0.0;
-      for (size_t j = 0; j < clusters.at(i).size(); j++) 
+      for (size_t j = cluster_offsets_.at(i); j < cluster_offsets_.at(i + 1); j++) 
       {
-        x_avg += clusters.at(i).at(j).x;
-        y_avg += clusters.at(i).at(j).y;
+        x_avg += cluster_points_.at(j).x;
+        y_avg += cluster_points_.at(j).y;
         num_elements += 1.0;
       }
       x_avg /= num_elements;
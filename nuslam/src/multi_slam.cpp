@@ -0,0 +1,327 @@
+/// \file
+/// \brief The multi_slam node runs one EKF SLAM filter per robot of the fleet inside a single
+///        process. Every robot's predict/correct runs in its own mutually exclusive callback group,
+///        so a multi-threaded executor spreads the filters over a pool of workers without locks.
+///        The whole fleet's estimates are published together in one message.
+///
+/// PARAMETERS:
+///     \param num_robots (int): Number of robots
+///     \param robot_namespaces (std::vector<std::string>): Namespace of every robot. Defaults to the
+///                                                         first num_robots colors
+///     \param wheel_radius (double): The radius of the wheels [m]
+///     \param track_width (double): The distance between the wheels [m]
+///     \param encoder_ticks_per_rad (double): Encoder ticks to radians conversion factor
+///     \param lidar_offset_x (double): Position of the lidar along the x-axis of the robot [m]
+///     \param num_workers (int): Number of executor threads. 0 picks one per core, up to one per robot
+///     \param publish_rate (double): Rate at which the fleet estimate is published [Hz]
+///     \param submap_radius (double): Landmarks farther than this are frozen out of each filter, 0 keeps
+///                                    all of them [m]
+///
+/// PUBLISHES:
+///     \param /fleet_estimate (nuslam::msg::FleetEstimate): Pose and landmark estimates of every robot
+///
+/// SUBSCRIBES:
+///     \param <ns>/sensor_data (nuturtlebot_msgs::msg::SensorData): Wheel encoders of each robot
+///     \param <ns>/landmarks/circle_fit (visualization_msgs::msg::MarkerArray): Landmarks fit to
+///                                                                             each robot's lidar
+///
+/// SERVERS:
+///     None
+///
+/// CLIENTS:
+///     None
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "nuturtlebot_msgs/msg/sensor_data.hpp"
+#include "visualization_msgs/msg/marker_array.hpp"
+#include "nuslam/msg/fleet_estimate.hpp"
+#include "nuslam/msg/robot_estimate.hpp"
+#include "turtlelib/diff_drive.hpp"
+#include "turtlelib/ekf.hpp"
+
+using namespace std::chrono_literals;
+
+/// \brief Everything one robot's filter owns. Only its own callback group touches it,
+///        except for the latest estimate, which is swapped atomically.
+struct RobotFilter
+{
+  std::string ns;
+  turtlelib::DiffDrive odometry;
+  turtlelib::EKFSlam estimator{};
+  turtlelib::Transform2D tf_prev{};
+
+  bool encoders_initialized = false;
+  int ticks_at_0_left = 0;
+  int ticks_at_0_right = 0;
+  turtlelib::wheelAngles prev_wheel_angles{};
+
+  rclcpp::CallbackGroup::SharedPtr callback_group;
+  rclcpp::Subscription<nuturtlebot_msgs::msg::SensorData>::SharedPtr sensor_data_subscriber;
+  rclcpp::Subscription<visualization_msgs::msg::MarkerArray>::SharedPtr circle_fit_subscriber;
+
+  /// \brief Latest estimate, read by the fleet publisher
+  std::shared_ptr<const nuslam::msg::RobotEstimate> estimate;
+};
+
+class multi_slam : public rclcpp::Node
+{
+public:
+  multi_slam()
+  : Node("multi_slam")
+  {
+    // Parameter descirption
+    auto num_robots_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto robot_namespaces_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto wheel_radius_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto track_width_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto encoder_ticks_per_rad_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto lidar_offset_x_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto num_workers_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto publish_rate_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto submap_radius_des = rcl_interfaces::msg::ParameterDescriptor{};
+
+    num_robots_des.description = "Number of robots";
+    robot_namespaces_des.description = "Namespace of every robot. Defaults to the first num_robots colors";
+    wheel_radius_des.description = "The radius of the wheels [m]";
+    track_width_des.description = "The distance between the wheels [m]";
+    encoder_ticks_per_rad_des.description = "Encoder ticks to radians conversion factor";
+    lidar_offset_x_des.description = "Position of the lidar along the x-axis of the robot [m]";
+    num_workers_des.description = "Number of executor threads. 0 picks one per core, up to one per robot";
+    publish_rate_des.description = "Rate at which the fleet estimate is published [Hz]";
+    submap_radius_des.description = "Landmarks farther than this are frozen out of each filter, 0 keeps all of them [m]";
+
+    // Declare default parameters values
+    declare_parameter("num_robots", 0, num_robots_des);
+    declare_parameter("robot_namespaces", std::vector<std::string>{}, robot_namespaces_des);
+    declare_parameter("wheel_radius", -1.0, wheel_radius_des);
+    declare_parameter("track_width", -1.0, track_width_des);
+    declare_parameter("encoder_ticks_per_rad", -1.0, encoder_ticks_per_rad_des);
+    declare_parameter("lidar_offset_x", -0.032, lidar_offset_x_des);
+    declare_parameter("num_workers", 0, num_workers_des);
+    declare_parameter("publish_rate", 10.0, publish_rate_des);
+    declare_parameter("submap_radius", 0.0, submap_radius_des);
+
+    // Get params - Read params from yaml file that is passed in the launch file
+    num_robots_ = get_parameter("num_robots").get_parameter_value().get<int>();
+    robot_namespaces_ = get_parameter("robot_namespaces").get_parameter_value().get<std::vector<std::string>>();
+    wheel_radius_ = get_parameter("wheel_radius").get_parameter_value().get<double>();
+    track_width_ = get_parameter("track_width").get_parameter_value().get<double>();
+    encoder_ticks_per_rad_ = get_parameter("encoder_ticks_per_rad").get_parameter_value().get<double>();
+    lidar_offset_x_ = get_parameter("lidar_offset_x").get_parameter_value().get<double>();
+    num_workers_ = get_parameter("num_workers").get_parameter_value().get<int>();
+    publish_rate_ = get_parameter("publish_rate").get_parameter_value().get<double>();
+    submap_radius_ = get_parameter("submap_radius").get_parameter_value().get<double>();
+
+    if (robot_namespaces_.empty())
+    {
+      if (num_robots_ < 0 || num_robots_ > static_cast<int>(colors_.size()))
+      {
+        throw std::runtime_error("Incorrect multi_slam params! Pass robot_namespaces for more than " + std::to_string(colors_.size()) + " robots.");
+      }
+      robot_namespaces_.assign(colors_.begin(), colors_.begin() + num_robots_);
+    }
+
+    // Ensures all values are passed via .yaml file
+    check_yaml_params();
+
+    // One filter and one mutually exclusive callback group per robot. Callbacks of one robot never
+    // overlap, callbacks of different robots run in parallel on the executor's threads.
+    for (const auto & ns : robot_namespaces_)
+    {
+      auto robot = std::make_unique<RobotFilter>();
+      robot->ns = ns;
+      robot->odometry = turtlelib::DiffDrive{wheel_radius_, track_width_};
+      robot->estimator.set_submap_radius(submap_radius_);
+      robot->callback_group = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+
+      rclcpp::SubscriptionOptions options;
+      options.callback_group = robot->callback_group;
+
+      RobotFilter * robot_ptr = robot.get();
+      robot->sensor_data_subscriber = create_subscription<nuturtlebot_msgs::msg::SensorData>(
+        ns + "/sensor_data", 10,
+        [this, robot_ptr](const nuturtlebot_msgs::msg::SensorData & msg) {sensor_data_callback(*robot_ptr, msg);},
+        options);
+      robot->circle_fit_subscriber = create_subscription<visualization_msgs::msg::MarkerArray>(
+        ns + "/landmarks/circle_fit", 10,
+        [this, robot_ptr](const visualization_msgs::msg::MarkerArray & msg) {circle_fit_callback(*robot_ptr, msg);},
+        options);
+
+      robots_.push_back(std::move(robot));
+    }
+
+    // Publishers
+    fleet_estimate_publisher_ = create_publisher<nuslam::msg::FleetEstimate>("/fleet_estimate", 10);
+
+    // Timer
+    std::chrono::duration<double> period(1.0 / publish_rate_);
+    timer_ = create_wall_timer(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(period),
+      std::bind(&multi_slam::timer_callback, this));
+  }
+
+  /// \brief Number of executor threads to spin this node with
+  size_t num_workers() const
+  {
+    if (num_workers_ > 0)
+    {
+      return static_cast<size_t>(num_workers_);
+    }
+    // One per core, but no more than the robots and the fleet publisher can keep busy
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    return std::min(cores, robots_.size() + 1);
+  }
+
+private:
+  // Variables
+  int num_robots_ = 0;
+  std::vector<std::string> robot_namespaces_;
+  std::vector<std::string> colors_ = {"cyan", "magenta", "yellow", "red", "green", "blue", "orange", "brown", "white"};
+  double wheel_radius_ = -1.0;
+  double track_width_ = -1.0;
+  double encoder_ticks_per_rad_ = -1.0;
+  double lidar_offset_x_ = -0.032;
+  int num_workers_ = 0;
+  double publish_rate_ = 10.0;
+  double submap_radius_ = 0.0;
+  std::vector<std::unique_ptr<RobotFilter>> robots_;
+  nuslam::msg::FleetEstimate fleet_estimate_;
+
+  // Create objects
+  rclcpp::Publisher<nuslam::msg::FleetEstimate>::SharedPtr fleet_estimate_publisher_;
+  rclcpp::TimerBase::SharedPtr timer_;
+
+  /// \brief Publish the latest estimate of every robot
+  void timer_callback()
+  {
+    fleet_estimate_.header.stamp = get_clock()->now();
+    fleet_estimate_.robots.clear();
+    for (const auto & robot : robots_)
+    {
+      const auto estimate = std::atomic_load(&robot->estimate);
+      if (estimate)
+      {
+        fleet_estimate_.robots.push_back(*estimate);
+      }
+    }
+    fleet_estimate_publisher_->publish(fleet_estimate_);
+  }
+
+  /// \brief Wheel odometry of one robot from its encoders
+  void sensor_data_callback(RobotFilter & robot, const nuturtlebot_msgs::msg::SensorData & msg)
+  {
+    if (!robot.encoders_initialized)
+    {
+      robot.ticks_at_0_left = msg.left_encoder;
+      robot.ticks_at_0_right = msg.right_encoder;
+      robot.encoders_initialized = true;
+      return;
+    }
+
+    // Change in wheel angle from encoder ticks
+    const turtlelib::wheelAngles wheel_angles{
+      static_cast<double>(msg.left_encoder - robot.ticks_at_0_left) / encoder_ticks_per_rad_,
+      static_cast<double>(msg.right_encoder - robot.ticks_at_0_right) / encoder_ticks_per_rad_};
+
+    robot.odometry.driveWheels(turtlelib::wheelAngles{
+      wheel_angles.left - robot.prev_wheel_angles.left,
+      wheel_angles.right - robot.prev_wheel_angles.right});
+    robot.prev_wheel_angles = wheel_angles;
+  }
+
+  /// \brief Predict with the odometry since the last scan, then correct with the scan's landmarks
+  void circle_fit_callback(RobotFilter & robot, const visualization_msgs::msg::MarkerArray & msg)
+  {
+    // Relative transform between successive sensing
+    const turtlelib::Transform2D tf_now{turtlelib::Vector2D{robot.odometry.pose().x, robot.odometry.pose().y}, robot.odometry.pose().theta};
+    robot.estimator.predict(turtlelib::differentiate_transform(robot.tf_prev.inv() * tf_now));
+    robot.tf_prev = tf_now;
+
+    // Convert measurements in base_scan frame to footprint frame
+    std::vector<turtlelib::Point2D> landmark_positions{};
+    landmark_positions.reserve(msg.markers.size());
+    for (const auto & marker : msg.markers)
+    {
+      landmark_positions.push_back(turtlelib::Point2D{marker.pose.position.x + lidar_offset_x_, marker.pose.position.y});
+    }
+
+    // Associate and correct once for the whole scan
+    const std::vector<size_t> indices = robot.estimator.associate_indices(landmark_positions);
+    robot.estimator.correct_batch(landmark_positions, indices);
+
+    publish_estimate(robot);
+  }
+
+  /// \brief Swap in the robot's latest estimate for the fleet publisher
+  void publish_estimate(RobotFilter & robot)
+  {
+    auto estimate = std::make_shared<nuslam::msg::RobotEstimate>();
+    estimate->robot_namespace = robot.ns;
+
+    const turtlelib::Pose2D pose = robot.estimator.pose();
+    estimate->x = pose.x;
+    estimate->y = pose.y;
+    estimate->theta = pose.theta;
+
+    const arma::mat covariance = robot.estimator.covariance_matrix();
+    for (int row = 0; row < turtlelib::num_dof; row++)
+    {
+      for (int col = 0; col < turtlelib::num_dof; col++)
+      {
+        estimate->pose_covariance[row * turtlelib::num_dof + col] = covariance(row, col);
+      }
+    }
+
+    // New landmarks take the next free index, so the first num_seen_landmarks are the mapped ones.
+    // Frozen submap landmarks are included.
+    const arma::colvec map = robot.estimator.map();
+    const size_t num_landmarks = std::min<size_t>(robot.estimator.num_seen_landmarks(), map.n_elem / 2);
+    estimate->landmarks_x.resize(num_landmarks);
+    estimate->landmarks_y.resize(num_landmarks);
+    for (size_t j = 0; j < num_landmarks; j++)
+    {
+      estimate->landmarks_x[j] = map(2*j);
+      estimate->landmarks_y[j] = map(2*j + 1);
+    }
+
+    std::atomic_store(&robot.estimate, std::shared_ptr<const nuslam::msg::RobotEstimate>(std::move(estimate)));
+  }
+
+  /// \brief Ensures all values are passed via .yaml file
+  void check_yaml_params()
+  {
+    if (wheel_radius_ == -1.0 || track_width_ == -1.0 || encoder_ticks_per_rad_ == -1.0)
+    {
+      RCLCPP_DEBUG(this->get_logger(), "wheel_radius: %f", wheel_radius_);
+      RCLCPP_DEBUG(this->get_logger(), "track_width: %f", track_width_);
+      RCLCPP_DEBUG(this->get_logger(), "encoder_ticks_per_rad: %f", encoder_ticks_per_rad_);
+
+      throw std::runtime_error("Missing necessary parameters in diff_params.yaml!");
+    }
+
+    if (publish_rate_ <= 0.0)
+    {
+      throw std::runtime_error("Incorrect multi_slam params! publish_rate must be positive.");
+    }
+  }
+};
+
+/// \brief Main function for node create, error handle and shutdown
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  auto node = std::make_shared<multi_slam>();
+  rclcpp::executors::MultiThreadedExecutor executor(rclcpp::ExecutorOptions(), node->num_workers());
+  executor.add_node(node);
+  executor.spin();
+  rclcpp::shutdown();
+  return 0;
+}
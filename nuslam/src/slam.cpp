@@ -11,6 +11,10 @@
 ///     \param track_width (double): The distance between the wheels [m]
 ///     \param obstacles.r (double): Radius of cylindrical obstacles [m]
 ///     \param obstacles.h (double): Height of cylindrical obstacles [m]
+///     \param submap_radius (double): Landmarks farther than this are frozen out of the filter, 0 keeps
+///                                    all of them [m]
+///     \param backend (std::string): SLAM estimator, "ekf" or "fastslam"
+///     \param num_particles (int): Number of particles of the fastslam backend
 ///
 /// PUBLISHES:
 ///     \param /odom (nav_msgs::msg::Odometry): Odometry publisher
@@ -42,6 +46,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 #include <armadillo>
 
 #include "rclcpp/rclcpp.hpp"
@@ -50,6 +55,7 @@
 #include "tf2_ros/transform_broadcaster.h"
 #include "turtlelib/diff_drive.hpp"
 #include "turtlelib/ekf.hpp"
+#include "turtlelib/fastslam.hpp"
 #include "tf2/LinearMath/Quaternion.h"
 #include "tf2_ros/transform_broadcaster.h"
 #include "geometry_msgs/msg/transform_stamped.hpp"
@@ -92,6 +98,9 @@ public:
     auto basic_sensor_variance_des = rcl_interfaces::msg::ParameterDescriptor{};
     auto max_range_des = rcl_interfaces::msg::ParameterDescriptor{};
     auto use_laser_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto submap_radius_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto backend_des = rcl_interfaces::msg::ParameterDescriptor{};
+    auto num_particles_des = rcl_interfaces::msg::ParameterDescriptor{};
 
     body_id_des.description = "The name of the body frame of the robot";
     odom_id_des.description = "The name of the odometry frame";
@@ -103,6 +112,9 @@ public:
     basic_sensor_variance_des.description = "Variance in landmark sensing [m^2]";
     max_range_des.description = "Range of landmark sensing [m]";
     use_laser_des.description = "Use circle fit on laser scan (true) or use fake sensor (false)";
+    submap_radius_des.description = "Landmarks farther than this are frozen out of the filter, 0 keeps all of them [m]";
+    backend_des.description = "SLAM estimator, ekf or fastslam";
+    num_particles_des.description = "Number of particles of the fastslam backend";
 
     // Declare default parameters values
     declare_parameter("body_id", "green/base_footprint", body_id_des);
@@ -115,6 +127,9 @@ public:
     declare_parameter("basic_sensor_variance", -1.0, basic_sensor_variance_des); // Meters^2
     declare_parameter("max_range", -1.0, max_range_des); // Meters
     declare_parameter("use_laser", false, use_laser_des);
+    declare_parameter("submap_radius", 0.0, submap_radius_des); // Meters
+    declare_parameter("backend", "ekf", backend_des);
+    declare_parameter("num_particles", 100, num_particles_des);
 
     // Get params - Read params from yaml file that is passed in the launch file
     body_id_ = get_parameter("body_id").get_parameter_value().get<std::string>();
@@ -127,6 +142,9 @@ public:
     basic_sensor_variance_ = get_parameter("basic_sensor_variance").get_parameter_value().get<double>();
     max_range_ = get_parameter("max_range").get_parameter_value().get<double>();
     use_laser_ = get_parameter("use_laser").get_parameter_value().get<bool>();
+    submap_radius_ = get_parameter("submap_radius").get_parameter_value().get<double>();
+    backend_ = get_parameter("backend").get_parameter_value().get<std::string>();
+    num_particles_ = get_parameter("num_particles").get_parameter_value().get<int>();
 
     // Ensures all values are passed via the launch file
     check_frame_params();
@@ -136,8 +154,13 @@ public:
 
     // Update object with params
     odom_turtle_ = turtlelib::DiffDrive{wheel_radius_, track_width_};
-    // Extended Kalman Filter SLAM state estimator
-    estimator_ptr_ = std::make_unique<turtlelib::EKFSlam>(odom_turtle_.pose());
+    // SLAM state estimator. Either an Extended Kalman Filter or a particle filter.
+    if (backend_ == "fastslam") {
+      fastslam_ptr_ = std::make_unique<turtlelib::FastSlam>(odom_turtle_.pose(), static_cast<size_t>(num_particles_));
+    } else {
+      estimator_ptr_ = std::make_unique<turtlelib::EKFSlam>(odom_turtle_.pose());
+      estimator_ptr_->set_submap_radius(submap_radius_);
+    }
 
     // Publishers
     odom_publisher_ = create_publisher<nav_msgs::msg::Odometry>(
@@ -198,6 +221,7 @@ private:
   tf2::Quaternion body_q2_;
   turtlelib::DiffDrive odom_turtle_;
   std::unique_ptr<turtlelib::EKFSlam> estimator_ptr_;
+  std::unique_ptr<turtlelib::FastSlam> fastslam_ptr_;
   nav_msgs::msg::Odometry odom_;
   geometry_msgs::msg::TransformStamped tf_;
   geometry_msgs::msg::TransformStamped tf2_;
@@ -214,6 +238,9 @@ private:
   double basic_sensor_variance_ = -1.0;
   double max_range_ = -1.0;
   bool use_laser_ = false;
+  double submap_radius_ = 0.0;
+  std::string backend_ = "ekf";
+  int num_particles_ = 100;
 
   // Create objects
   rclcpp::Publisher<nav_msgs::msg::Odometry>::SharedPtr odom_publisher_;
@@ -265,22 +292,36 @@ private:
     turtlelib::Transform2D slam_tf_change_ = slam_tf_prev_.inv() * slam_tf_now_;
 
     // Twist that gets us from the previous sensor callback tf to this one.
-    estimator_ptr_->predict(turtlelib::differentiate_transform(slam_tf_change_));
+    if (fastslam_ptr_) {
+      fastslam_ptr_->predict(turtlelib::differentiate_transform(slam_tf_change_));
+    } else {
+      estimator_ptr_->predict(turtlelib::differentiate_transform(slam_tf_change_));
+    }
 
     slam_tf_prev_ = slam_tf_now_;
 
     visualization_msgs::msg::MarkerArray sensed_landmarks = msg;
 
-    // Correct for each sensor measurement
+    // Gather every sensor measurement of the scan
     // j = 1, 2, 3...
+    std::vector<turtlelib::Point2D> landmark_positions{};
+    std::vector<size_t> indices{};
     for (size_t j = 1; j <= sensed_landmarks.markers.size() - 0; j++) 
     {
       // Only use landmarks that the sensor currently sees
       if (sensed_landmarks.markers[j-1].action == visualization_msgs::msg::Marker::ADD) 
       { 
-        estimator_ptr_->correct(sensed_landmarks.markers[j-1].pose.position.x, sensed_landmarks.markers[j-1].pose.position.y, j);
+        landmark_positions.push_back(turtlelib::Point2D{sensed_landmarks.markers[j-1].pose.position.x, sensed_landmarks.markers[j-1].pose.position.y});
+        indices.push_back(j);
       }
     }
+
+    // Correct once for the whole scan
+    if (fastslam_ptr_) {
+      fastslam_ptr_->correct_batch(landmark_positions, indices);
+    } else {
+      estimator_ptr_->correct_batch(landmark_positions, indices);
+    }
   }
 
   /// \brief Circle fit landmark sensor topic callback
@@ -291,31 +332,37 @@ private:
     turtlelib::Transform2D slam_tf_change_ = slam_tf_prev_.inv() * slam_tf_now_;
 
     // Twist that gets us from the previous sensor callback tf to this one.
-    estimator_ptr_->predict(turtlelib::differentiate_transform(slam_tf_change_));
+    if (fastslam_ptr_) {
+      fastslam_ptr_->predict(turtlelib::differentiate_transform(slam_tf_change_));
+    } else {
+      estimator_ptr_->predict(turtlelib::differentiate_transform(slam_tf_change_));
+    }
 
     slam_tf_prev_ = slam_tf_now_;
 
     visualization_msgs::msg::MarkerArray sensed_landmarks = msg;
 
-    // Correct for each sensor measurement
+    // Convert measurements in base_scan frame to footprint frame
+    std::vector<turtlelib::Point2D> landmark_positions{};
+    landmark_positions.reserve(sensed_landmarks.markers.size());
     for (size_t index = 0; index < sensed_landmarks.markers.size(); index++) 
     {
-      // Convert measurements in base_scan frame to footprint frame
-      turtlelib::Point2D landmark_position{sensed_landmarks.markers[index].pose.position.x - 0.032*cos(green_turtle_.theta), sensed_landmarks.markers[index].pose.position.y - 0.032*sin(green_turtle_.theta)};
-
-      // turtlelib::Pose2D lidar_pose_{turtle_.pose().theta, turtle_.pose().x - 0.032*cos(turtle_.pose().theta), turtle_.pose().y - 0.032*sin(turtle_.pose().theta)};
-
-      // Associate recevied landmark with the correct index
-      // j = 1, 2, 3...
-      size_t j = estimator_ptr_->associate_index(turtlelib::Point2D{
-        landmark_position.x,
-        landmark_position.y});
-            
-      if (j != 0)
-      {
-        // Correct using the landmark's measurement and id
-        estimator_ptr_->correct(landmark_position.x, landmark_position.y, j);
-      }
+      landmark_positions.push_back(turtlelib::Point2D{
+        sensed_landmarks.markers[index].pose.position.x - 0.032*cos(green_turtle_.theta),
+        sensed_landmarks.markers[index].pose.position.y - 0.032*sin(green_turtle_.theta)});
+    }
+
+    // Associate all received landmarks of the scan with their indices at once
+    // j = 1, 2, 3...
+    const std::vector<size_t> indices = fastslam_ptr_ ?
+      fastslam_ptr_->associate_indices(landmark_positions) :
+      estimator_ptr_->associate_indices(landmark_positions);
+
+    // Correct once for the whole scan. Outliers are skipped.
+    if (fastslam_ptr_) {
+      fastslam_ptr_->correct_batch(landmark_positions, indices);
+    } else {
+      estimator_ptr_->correct_batch(landmark_positions, indices);
     }
   }
 
@@ -346,6 +393,10 @@ private:
       throw std::runtime_error("Missing necessary parameters in diff_params.yaml!");
     }
 
+    if ((backend_ != "ekf" && backend_ != "fastslam") || num_particles_ < 1) {
+      throw std::runtime_error("backend must be ekf or fastslam, with at least one particle!");
+    }
+
     if (  wheel_radius_ <= 0.0 ||
           track_width_ <= 0.0 ||
           basic_sensor_variance_ < 0.0 ||
@@ -392,7 +443,7 @@ private:
   /// \brief Broadcasts transform between map and odom
   void broadcast_map_odom_transform()
   {
-    green_turtle_ = estimator_ptr_->pose();
+    green_turtle_ = fastslam_ptr_ ? fastslam_ptr_->pose() : estimator_ptr_->pose();
     T_map_green = {turtlelib::Vector2D{green_turtle_.x, green_turtle_.y}, green_turtle_.theta};
     T_odom_green = {turtlelib::Vector2D{odom_turtle_.pose().x, odom_turtle_.pose().y}, odom_turtle_.pose().theta};
     T_map_odom = T_map_green * T_odom_green.inv();
@@ -415,10 +466,12 @@ private:
   /// \brief Create obstacles MarkerArray as seen by SLAM and publish them to a topic to display them in Rviz
   void create_obstacles_array()
   {
-    arma::colvec map_vector = estimator_ptr_->map();
+    arma::colvec map_vector = fastslam_ptr_ ? fastslam_ptr_->map() : estimator_ptr_->map();
+    const size_t num_seen_landmarks = fastslam_ptr_ ?
+      fastslam_ptr_->num_seen_landmarks() : estimator_ptr_->num_seen_landmarks();
     visualization_msgs::msg::MarkerArray obstacles_;
 
-    for (int landmark = 0; landmark < static_cast<int>(estimator_ptr_->num_seen_landmarks()); landmark++) {
+    for (int landmark = 0; landmark < static_cast<int>(num_seen_landmarks); landmark++) {
       // if (map_vector(landmark) != 0) {
         visualization_msgs::msg::Marker obstacle_;
         obstacle_.header.frame_id = "map";
@@ -7,11 +7,15 @@
 
 #include <iosfwd>
 #include <cmath>
-#include <armadillo>
+#include <cstddef>
+#include <vector>
 #include "turtlelib/geometry2d.hpp"
 
 namespace turtlelib
 {
+    /// \brief clusters fitted by one circle_fitting_batch call from which the fits run in parallel, when built with OpenMP
+    constexpr size_t parallel_fit_clusters = 16;
+
     /// \brief Circle size and location
     struct Circle
     {
@@ -25,11 +29,76 @@ namespace turtlelib
         double R = 0.0;
     };
 
+    /// \brief Why classify_cluster rejected a cluster
+    enum class ClusterReject
+    {
+        /// \brief not rejected, the cluster may be a circle
+        none,
+        /// \brief fewer than 3 points
+        too_few_points,
+        /// \brief the chord between the end points is longer than the largest circle
+        too_wide,
+        /// \brief the mean inscribed angle is out of range, as for walls
+        angle_out_of_range,
+        /// \brief the inscribed angles vary too much, as for corners and clutter
+        angle_spread,
+        /// \brief the points do not trace the arc implied by the chord and the inscribed angle
+        arc_mismatch
+    };
+
+    /// \brief Limits of classify_cluster
+    struct ClusterLimits
+    {
+        /// \brief largest radius of a circle [m]
+        double max_radius = 0.1;
+        /// \brief smallest mean inscribed angle [rad]. 90 degrees is a half circle, less needs a concave view.
+        double min_mean_angle = deg2rad(80.0);
+        /// \brief largest mean inscribed angle [rad]. 180 degrees is a straight line.
+        double max_mean_angle = deg2rad(145.0);
+        /// \brief largest standard deviation of the inscribed angles [rad]
+        double max_angle_deviation = 0.25;
+        /// \brief largest ratio of the length of the polyline through the points to the implied arc length
+        double max_arc_ratio = 1.5;
+    };
+
+    /// \brief cheap test of whether a cluster can be a circle, before fitting it.
+    /// On a circular arc every point sees the two end points under the same inscribed angle.
+    /// \param points (const turtlelib::Point2D *) first point of one cluster, in scan order
+    /// \param count (size_t) number of points in the cluster
+    /// \param limits (turtlelib::ClusterLimits) thresholds of the tests
+    /// \return ClusterReject::none if the cluster may be a circle, otherwise the failed test
+    ClusterReject classify_cluster(const Point2D * points, size_t count, const ClusterLimits & limits = ClusterLimits{});
+
+    /// \brief name of a reject reason, for diagnostics
+    /// \param reason (turtlelib::ClusterReject) reject reason
+    /// \return the name of the reason (const char *)
+    const char * to_string(ClusterReject reason);
+
+    /// \brief circle fitting algorithm. Accumulates the 4 x 4 moment matrix directly and solves
+    /// a 4 x 4 symmetric eigenproblem, without allocating.
+    /// \param points (const turtlelib::Point2D *) first point of one cluster to fit a circle to
+    /// \param count (size_t) number of points in the cluster, at least 3
+    /// \return radius and x,y coordinates of circle (turtlelib::Circle)
+    Circle circle_fitting(const Point2D * points, size_t count);
+
     /// \brief circle fitting algorithm
-    /// \param cluster (std::vector<turtlelib::Vector2D>) pass one cluster in to fit a circle to
+    /// \param cluster (std::vector<turtlelib::Point2D>) pass one cluster in to fit a circle to
     /// \return radius and x,y coordinates of circle (turtlelib::Circle)
-    Circle circle_fitting(std::vector<turtlelib::Point2D> cluster);
+    Circle circle_fitting(const std::vector<Point2D> & cluster);
+
+    /// \brief circle fitting of many clusters stored back to back in one buffer
+    /// \param points (const turtlelib::Point2D *) points of every cluster
+    /// \param offsets (const size_t *) num_clusters + 1 offsets. Cluster k is points[offsets[k]] up to points[offsets[k+1]]
+    /// \param num_clusters (size_t) number of clusters, each of at least 3 points
+    /// \param circles (turtlelib::Circle *) output, the fit of each cluster
+    void circle_fitting_batch(const Point2D * points, const size_t * offsets, size_t num_clusters, Circle * circles);
+
+    /// \brief circle fitting of many clusters stored back to back in one buffer
+    /// \param points (std::vector<turtlelib::Point2D>) points of every cluster
+    /// \param offsets (std::vector<size_t>) one offset per cluster, and the end of the last cluster
+    /// \return the fit of each cluster (std::vector<turtlelib::Circle>)
+    std::vector<Circle> circle_fitting_batch(const std::vector<Point2D> & points, const std::vector<size_t> & offsets);
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -4,6 +4,8 @@
 /// \brief Two-dimensional rigid body transformations.
 
 #include<iosfwd> // contains forward definitions for iostream objects
+#include<cstddef>
+#include<vector>
 
 #include"turtlelib/geometry2d.hpp"
 #include"turtlelib/se2d.hpp"
@@ -13,18 +15,26 @@ namespace turtlelib
 {
 
     /// \brief represent a mobile robot's pose
-    struct Pose2D
+    /// \tparam T - scalar type of the pose
+    template<class T>
+    struct Pose2
     {
         /// \brief angle with the world frame
-        double theta = 0.0;
+        T theta = 0;
 
         /// \brief x position in the world frame
-        double x = 0.0;
+        T x = 0;
 
         /// \brief y position in world frame
-        double y = 0.0;
+        T y = 0;
     };
 
+    /// \brief a mobile robot's pose in double precision
+    using Pose2D = Pose2<double>;
+
+    /// \brief a mobile robot's pose in single precision
+    using Pose2F = Pose2<float>;
+
     /// \brief represent a mobile robot's pose
     struct wheelAngles
     {
@@ -97,6 +107,98 @@ namespace turtlelib
         // DiffDrive(Vector2D trans, double radians);
 
     };
+
+    /// \brief the kinematics of a fleet of identical differential drive robots. Wheel angles and poses
+    /// are stored as one contiguous array per component, so the whole fleet is driven in a few tight loops.
+    class DiffDriveFleet
+    {
+
+    private:
+
+        /// \brief radius of wheels, in meters
+        double wheel_radius = 1.0;
+
+        /// \brief separation between wheels, in meters
+        double wheel_sep = 1.0;
+
+        /// \brief left wheel angle of every robot, in radians
+        std::vector<double> phi_left{};
+
+        /// \brief right wheel angle of every robot, in radians
+        std::vector<double> phi_right{};
+
+        /// \brief heading of every robot in the world frame
+        std::vector<double> theta{};
+
+        /// \brief x position of every robot in the world frame
+        std::vector<double> x{};
+
+        /// \brief y position of every robot in the world frame
+        std::vector<double> y{};
+
+    public:
+
+        /// \brief Initialize an empty fleet of robots with unit wheel radius and separation
+        DiffDriveFleet() = default;
+
+        /// \brief Initialize an empty fleet of robots with the given wheel radius and separation
+        explicit DiffDriveFleet(double radius, double sep);
+
+        /// \brief Initialize a fleet of robots at the origin
+        explicit DiffDriveFleet(double radius, double sep, size_t num_robots);
+
+        /// \brief add a robot to the fleet
+        /// \param wheels - wheel angles of the robot
+        /// \param pose - pose of the robot in the world frame
+        /// \return index of the robot
+        size_t add(wheelAngles wheels, Pose2D pose);
+
+        /// \brief Drive every robot forward through its wheels (compute forward velocity kinematics)
+        /// \param delta_left - left wheel angle increment of every robot
+        /// \param delta_right - right wheel angle increment of every robot
+        /// \param omega [out] - angular velocity of the body twist of every robot, or nullptr
+        /// \param x_dot [out] - linear velocity of the body twist of every robot, or nullptr
+        void driveWheels(const double * delta_left, const double * delta_right, double * omega = nullptr, double * x_dot = nullptr);
+
+        /// \brief Drive one robot forward through its wheels, and return the resulting body twist
+        /// \param i - index of the robot
+        /// \param delta_phi - wheel angle increments
+        Twist2D driveWheels(size_t i, wheelAngles delta_phi);
+
+        /// \brief Pose one robot would reach by driving its wheels, without moving it
+        /// \param i - index of the robot
+        /// \param delta_phi - wheel angle increments
+        Pose2D predictPose(size_t i, wheelAngles delta_phi) const;
+
+        /// \brief Wheel angle increments that give every robot a body twist (compute inverse velocity kinematics).
+        /// Body twists of a differential drive have no y component.
+        /// \param omega - angular velocity of the body twist of every robot
+        /// \param x_dot - linear velocity of the body twist of every robot
+        /// \param delta_left [out] - left wheel angle increment of every robot
+        /// \param delta_right [out] - right wheel angle increment of every robot
+        void TwistToWheels(const double * omega, const double * x_dot, double * delta_left, double * delta_right) const;
+
+        // Set the pose of one robot
+        void setPose(size_t i, Pose2D pose);
+
+        // Set the wheel angles of one robot
+        void setWheels(size_t i, wheelAngles wheels);
+
+        // Get number of robots
+        size_t size() const;
+
+        // Get wheel radius
+        double radius() const;
+
+        // Get wheel separation
+        double separation() const;
+
+        // Get wheel angles of one robot
+        wheelAngles wheels(size_t i) const;
+
+        // Get pose of one robot
+        Pose2D pose(size_t i) const;
+    };
 }
 
 #endif
@@ -10,10 +10,14 @@
 #include "turtlelib/diff_drive.hpp"
 #include <armadillo>
 #include <unordered_set>
+#include <unordered_map>
+#include <array>
+#include <vector>
+#include <stdexcept>
 
 namespace turtlelib
 {
-    /// \brief maximum number of obstacles
+    /// \brief initial number of landmark slots. The filter grows beyond this on demand.
     constexpr int num_landmarks=4;
     /// \brief size of robot state vector
     constexpr int num_dof=3;
@@ -23,6 +27,67 @@ namespace turtlelib
     /// \brief sensing noise on landmarks, variance
     constexpr double R_noise = 0.01; // For small sensor noise
     // constexpr double R_noise = 0.9; // For large sensor noise
+    /// \brief most landmarks stacked in one batch correction. Larger scans are corrected one landmark at a time.
+    constexpr size_t max_batch_landmarks = 8;
+
+    /// \brief non-zero entries of the motion Jacobian A_t = I + G_t, which are d(x, y)/dθ
+    /// \param theta - heading before the motion
+    /// \param omega - rotational velocity of the twist
+    /// \param v - translational velocity of the twist
+    /// \param g_x - output, A(1, 0)
+    /// \param g_y - output, A(2, 0)
+    void ekf_motion_jacobian(double theta, double omega, double v, double & g_x, double & g_y);
+
+    /// \brief Σ = A Σ A^T + Q, in place, for the A of ekf_motion_jacobian. Q only enters the pose block.
+    /// \param sigma - covariance, of which the leading d x d block is updated
+    /// \param d - size of the active state
+    /// \param g_x - A(1, 0)
+    /// \param g_y - A(2, 0)
+    /// \param Q - num_dof x num_dof process noise
+    void ekf_propagate_covariance(arma::mat & sigma, arma::uword d, double g_x, double g_y, const arma::mat & Q);
+
+    /// \brief range-bearing prediction of one landmark and the two non-zero blocks of H
+    /// \param theta - robot heading
+    /// \param x - robot x-coordinate
+    /// \param y - robot y-coordinate
+    /// \param m_x - landmark x-coordinate
+    /// \param m_y - landmark y-coordinate
+    /// \param z_hat - output, 2 x 1 predicted measurement
+    /// \param H_pose - output, 2 x num_dof block of H for the pose
+    /// \param H_landmark - output, 2 x 2 block of H for the landmark
+    void ekf_measurement_model(double theta, double x, double y, double m_x, double m_y,
+                               arma::colvec & z_hat, arma::mat & H_pose, arma::mat & H_landmark);
+
+    /// \brief Kalman update of state and covariance for one landmark, in place and without allocating
+    /// \param sigma - covariance, of which the leading d x d block is updated
+    /// \param Xi - state vector, of which the first d entries are updated
+    /// \param d - size of the active state
+    /// \param c - first column of the landmark in the state
+    /// \param H_pose - 2 x num_dof block of H for the pose
+    /// \param H_landmark - 2 x 2 block of H for the landmark
+    /// \param z_diff - 2 x 1 innovation, with the bearing normalized
+    /// \param R - 2 x 2 sensor noise
+    /// \param sigma_Ht - scratch, at least d x 2. Holds Σ H^T on return
+    /// \param K - output, at least d x 2 Kalman gain
+    void ekf_update(arma::mat & sigma, arma::colvec & Xi, arma::uword d, arma::uword c,
+                    const arma::mat & H_pose, const arma::mat & H_landmark, const arma::colvec & z_diff,
+                    const arma::mat & R, arma::mat & sigma_Ht, arma::mat & K);
+
+    /// \brief Mean and marginal covariance of a landmark frozen out of the active state of EKFSlam.
+    /// Defaults to the prior of a landmark that was never seen.
+    struct FrozenLandmark
+    {
+        /// \brief x-coordinate of the landmark
+        double x = 0.0;
+        /// \brief y-coordinate of the landmark
+        double y = 0.0;
+        /// \brief variance in x
+        double sigma_xx = 1e6;
+        /// \brief covariance of x and y
+        double sigma_xy = 0.0;
+        /// \brief variance in y
+        double sigma_yy = 1e6;
+    };
 
     /// \brief Kinematics of a differential drive robot.
     class EKFSlam
@@ -31,19 +96,17 @@ namespace turtlelib
     // public:
         /// \brief State vector of the robot at time t. q ∈ num_dof x 1. Contains the robot's pose. [theta x y]^T
         arma::colvec q{};
-        /// \brief State vector of the map at time t. m ∈ 2*num_landmarks x 1. Contains the coordinates of every landmark. [m_x1 m_y1 m_x2 m_y2 ... m_xn m_yn]^T
+        /// \brief State vector of the map at time t. m ∈ 2*capacity x 1, of which the first 2*n entries are in use. Contains the coordinates of every landmark. [m_x1 m_y1 m_x2 m_y2 ... m_xn m_yn]^T
         arma::colvec m{};
-        /// \brief State vector of the system at time t. ξ ∈ (num_dof + 2*num_landmarks) x 1. Combined state of robot and map. [q ; m]
+        /// \brief State vector of the system at time t. ξ ∈ (num_dof + 2*capacity) x 1, of which the first num_dof + 2*n entries are in use. Combined state of robot and map. [q ; m]
         arma::colvec Xi{};
-        /// \brief Covariance matrix. Σ ∈ (num_dof + 2*num_landmarks) x (num_dof + 2*num_landmarks). Off diagonal terms are zero because sensing noise and movement uncertainity are independent.
+        /// \brief Covariance matrix. Σ ∈ (num_dof + 2*capacity) x (num_dof + 2*capacity). Only the leading (num_dof + 2*n) block is in use, the rest holds the prior of unused slots. Off diagonal terms are zero because sensing noise and movement uncertainity are independent.
         arma::mat sigma{};
         /// \brief Given twist. u ∈ num_dof x 1. Measured / commanded input to the state transition. Y-component zero for diff drive robot.
         arma::colvec u{num_dof,arma::fill::zeros};
         // /// \brief Previous twist. 
         // Twist2D prev_twist{0.0,0.0,0.0};
-        /// \brief Identity matrix. I ∈ (num_dof + 2*num_landmarks) x (num_dof + 2*num_landmarks). Used to calculate A.
-        const arma::mat I{num_dof+2*num_landmarks,num_dof+2*num_landmarks,arma::fill::eye};
-        /// \brief Linearized state transition matrix. A ∈ (num_dof + 2*num_landmarks) x (num_dof + 2*num_landmarks). A_t = g'(ξ_{t−1}, u_t)
+        /// \brief Linearized state transition matrix. A ∈ (num_dof + 2*capacity) x (num_dof + 2*capacity), leading block in use. A_t = g'(ξ_{t−1}, u_t)
         arma::mat A{num_dof+2*num_landmarks, num_dof+2*num_landmarks,arma::fill::eye};
         /// \brief Process noise for the robot motion, as variance. Q ∈ num_dof x num_dof.
         const arma::mat Q{arma::mat{num_dof,num_dof,arma::fill::eye}*w};
@@ -53,14 +116,73 @@ namespace turtlelib
         arma::colvec z_i{2,arma::fill::zeros};
         /// \brief Estimate measurement. ˆz_i ∈ 2 x 1. Relative ˆr_j and ˆphi_j bearing predictions of a landmarks, based on pose prediction.
         arma::colvec z_i_hat{2,arma::fill::zeros};
-        /// \brief H matrix
-        arma::mat H_i{2, num_dof+2*num_landmarks, arma::fill::zeros};
-        /// \brief Kalman gain
-        arma::mat K_i{3+2*num_landmarks, 2, arma::fill::zeros};
+        /// \brief Pose block of the last H. One 2 x num_dof block per landmark corrected. The dense H_i is only built by sensor_matrix()
+        arma::mat H_pose_i{2, num_dof, arma::fill::zeros};
+        /// \brief Landmark block of the last H. One 2 x 2 block per landmark corrected
+        arma::mat H_landmark_i{2, 2, arma::fill::zeros};
+        /// \brief First column of the landmark block of the last H, per landmark corrected
+        std::vector<arma::uword> H_columns{num_dof};
+        /// \brief Number of columns of the last H, the active state size at that correction
+        arma::uword H_cols = num_dof+2*num_landmarks;
+        /// \brief Scratch for Σ¯_t H_{i}^{T}. Sized (num_dof + 2*capacity) x 2, grows with the capacity, leading d rows in use
+        arma::mat sigma_Ht_i{num_dof+2*num_landmarks, 2, arma::fill::zeros};
+        /// \brief Kalman gain. K_i ∈ (num_dof + 2*n) x 2
+        arma::mat K_i{num_dof+2*num_landmarks, 2, arma::fill::zeros};
         /// \brief Sensor noise, as variance
         arma::mat R{2,2,arma::fill::eye};
         /// \brief Number of landmarks visible
         size_t N = 0;
+        /// \brief Number of landmark slots in the active state
+        size_t n = num_landmarks;
+        /// \brief Number of landmark slots allocated. Doubles when the active state outgrows it.
+        size_t capacity = num_landmarks;
+        /// \brief Landmarks farther than this from the robot are frozen out of the active state. 0 keeps every landmark active.
+        double submap_radius = 0.0;
+        /// \brief Slot of landmark j in the active state, at j-1. 0 if it has no slot. Without submaps landmark j is in slot j.
+        std::vector<size_t> landmark_slot{};
+        /// \brief Landmark in each slot of the active state, at slot-1. 0 if the slot is free.
+        std::vector<size_t> slot_landmark{};
+        /// \brief Landmarks frozen out of the active state, by j
+        std::unordered_map<size_t, FrozenLandmark> frozen_landmarks{};
+
+        /// \brief size of the active state vector
+        arma::uword dim() const;
+
+        /// \brief make room for at least count landmark slots, without activating them
+        /// \param count - number of landmark slots needed
+        void reserve_landmarks(size_t count);
+
+        /// \brief grow the active state to at least count landmark slots
+        /// \param count - number of landmark slots needed
+        void activate_landmarks(size_t count);
+
+        /// \brief predicted measurement of landmark slot k and its innovation covariance, from the 5 x 5 block of Σ for the pose and landmark k
+        /// \param k - landmark slot, 1, 2, 3...
+        /// \param z_hat - output, predicted measurement ˆz_k
+        /// \param psi - output, innovation covariance Ψ_k = H_k Σ H_k^T + R
+        void landmark_innovation(size_t k, arma::vec::fixed<2> & z_hat, arma::mat::fixed<2, 2> & psi) const;
+
+        /// \brief predicted measurement and innovation covariance of a landmark outside the active state, uncorrelated with the pose
+        /// \param landmark - mean and marginal covariance of the landmark
+        /// \param z_hat - output, predicted measurement ˆz_k
+        /// \param psi - output, innovation covariance Ψ_k = H_k Σ H_k^T + R
+        void frozen_landmark_innovation(const FrozenLandmark & landmark, arma::vec::fixed<2> & z_hat, arma::mat::fixed<2, 2> & psi) const;
+
+        /// \brief predicted measurement and innovation covariance from the 5 x 5 covariance of the pose and one landmark
+        /// \param m_x - landmark x-coordinate
+        /// \param m_y - landmark y-coordinate
+        /// \param block - covariance of [theta x y m_x m_y]
+        /// \param z_hat - output, predicted measurement ˆz_k
+        /// \param psi - output, innovation covariance Ψ_k = H_k Σ H_k^T + R
+        void block_innovation(double m_x, double m_y, const double block[5][5], arma::vec::fixed<2> & z_hat, arma::mat::fixed<2, 2> & psi) const;
+
+        /// \brief slot of landmark j in the active state. Gives it a slot if it has none, and rejoins it if it was frozen.
+        /// \param j - landmark index j
+        /// \returns slot of landmark j, 1, 2, 3...
+        size_t landmark_to_slot(size_t j);
+
+        /// \brief move landmarks farther than submap_radius from the robot out of the active state, keeping their marginals
+        void freeze_far_landmarks();
 
     public:
         /// \brief start at origin and default the uncertainty
@@ -73,6 +195,11 @@ namespace turtlelib
         /// \brief set the initial guess covariance matrix
         void initialize_covariance();
 
+        /// \brief enable submapping. Landmarks farther than radius from the robot are frozen with their marginal covariance,
+        /// so that updates only touch the landmarks around the robot. A frozen landmark rejoins the active state when it is observed again.
+        /// \param radius - freezing distance [m]. 0 disables submapping.
+        void set_submap_radius(double radius);
+
         /// \brief set the initial state of the robot
         /// \param turtle_pose_0 - robot start pose
         void initialize_pose(Pose2D turtle_pose_0);
@@ -91,23 +218,35 @@ namespace turtlelib
         /// \param j - sensed landmark index j
         void correct(double x, double y, size_t j);
 
+        /// \brief correct once for all landmarks sensed in a scan, with the stacked innovation of every measurement
+        /// \param measurements - sensed landmark relative coordinates
+        /// \param indices - landmark index j of each measurement. 0 marks an outlier, which is skipped.
+        void correct_batch(const std::vector<Point2D> & measurements, const std::vector<size_t> & indices);
+
         /// \brief data association
         /// \param measurement - current measurement of unknown landmark
         /// \returns j - index of that landmark
         size_t associate_index(Point2D measurement);
 
+        /// \brief joint data association of every measurement of one scan, against the same state.
+        /// Candidates are shortlisted with a polar grid over the predicted landmark measurements,
+        /// and a known landmark is given to at most one measurement.
+        /// \param measurements - relative positions of the unknown landmarks
+        /// \returns j for each measurement. 0 marks an outlier, indices past the known landmarks are new landmarks
+        std::vector<size_t> associate_indices(const std::vector<Point2D> & measurements);
+
         // GETTERS
         
         /// \brief get current pose prediction/correction of the robot
         Pose2D pose() const;
 
-        /// \brief get current map vector prediction/correction of the robot
+        /// \brief get current map vector prediction/correction of the robot. With submaps, frozen landmarks are included.
         arma::colvec map() const;
 
-        /// \brief get current state vector prediction/correction of the robot
+        /// \brief get current state vector prediction/correction of the robot. With submaps, only the active landmarks.
         arma::colvec state_vector() const;
 
-        /// \brief get current covariance matrix prediction/correction of the robot
+        /// \brief get current covariance matrix prediction/correction of the robot. With submaps, only the active landmarks.
         arma::mat covariance_matrix() const;
 
         /// \brief get current twist input to the robot
@@ -127,6 +266,157 @@ namespace turtlelib
 
         /// \brief get number of seen landmarks
         size_t num_seen_landmarks() const;
+
+        /// \brief get number of landmark slots in the active state
+        size_t num_active_landmarks() const;
+    };
+
+    /// \brief EKF SLAM with a landmark count fixed at compile time. Same filter as EKFSlam,
+    /// but every matrix is a fixed-size Armadillo matrix, so nothing is allocated after construction.
+    /// Landmarks are known in advance, so there is no data association.
+    /// \tparam N - number of landmarks
+    template<size_t N>
+    class FixedEKFSlam
+    {
+    public:
+        /// \brief size of the state vector
+        static constexpr arma::uword D = num_dof + 2 * N;
+
+    private:
+        /// \brief State vector of the system. ξ ∈ D x 1. [theta x y m_x1 m_y1 ... m_xN m_yN]^T
+        arma::vec::fixed<D> Xi;
+        /// \brief Covariance matrix. Σ ∈ D x D
+        arma::mat::fixed<D, D> sigma;
+        /// \brief Scratch for Σ H^T. D x 2
+        arma::mat::fixed<D, 2> sigma_Ht;
+        /// \brief Kalman gain. K ∈ D x 2
+        arma::mat::fixed<D, 2> K;
+        /// \brief Block of H for the pose
+        arma::mat::fixed<2, num_dof> H_pose;
+        /// \brief Block of H for the sensed landmark
+        arma::mat::fixed<2, 2> H_landmark;
+        /// \brief Predicted measurement
+        arma::vec::fixed<2> z_hat;
+        /// \brief Innovation
+        arma::vec::fixed<2> z_diff;
+        /// \brief Process noise for the robot motion, as variance
+        arma::mat::fixed<num_dof, num_dof> Q;
+        /// \brief Sensor noise, as variance
+        arma::mat::fixed<2, 2> R;
+        /// \brief Whether each landmark has been seen
+        std::array<bool, N> seen{};
+        /// \brief Number of landmarks seen
+        size_t num_seen = 0;
+
+    public:
+        /// \brief start at origin and default the uncertainty
+        FixedEKFSlam() : FixedEKFSlam(Pose2D{0.0, 0.0, 0.0}) {}
+
+        /// \brief set robot start config and default the uncertainty
+        /// \param turtle_pose_0 - robot start pose
+        explicit FixedEKFSlam(Pose2D turtle_pose_0)
+        {
+            Xi.zeros();
+            Xi(0) = turtle_pose_0.theta;
+            Xi(1) = turtle_pose_0.x;
+            Xi(2) = turtle_pose_0.y;
+
+            // Certain about the initial pose, no knowledge of the landmarks
+            sigma.zeros();
+            for (arma::uword i = num_dof; i < D; i++)
+            {
+                sigma(i, i) = 1e6;
+            }
+
+            Q.eye();
+            Q *= w;
+            R.eye();
+            R *= R_noise;
+        }
+
+        /// \brief predict/estimate the robot state and propogate the uncertainty
+        /// \param twist - twist control at time t
+        void predict(Twist2D twist)
+        {
+            if (!almost_equal(twist.y, 0.0))
+            {
+                throw std::runtime_error("Improper twist for estimation!");
+            }
+
+            double g_x = 0.0;
+            double g_y = 0.0;
+            ekf_motion_jacobian(Xi(0), twist.omega, twist.x, g_x, g_y);
+            ekf_propagate_covariance(sigma, D, g_x, g_y, Q);
+
+            // Predict mean pose nonlinearly. The map does not move.
+            const Transform2D T_wB = Transform2D{Vector2D{Xi(1), Xi(2)}, Xi(0)} * integrate_twist(twist);
+            Xi(0) = T_wB.rotation();
+            Xi(1) = T_wB.translation().x;
+            Xi(2) = T_wB.translation().y;
+        }
+
+        /// \brief correction calculations
+        /// \param x - sensed landmark relative x-coordinate
+        /// \param y - sensed landmark relative y-coordinate
+        /// \param j - sensed landmark index j, 1 to N
+        void correct(double x, double y, size_t j)
+        {
+            if (j == 0 || j > N)
+            {
+                throw std::runtime_error("Landmark index out of range!");
+            }
+
+            const double r_j = std::sqrt(x * x + y * y);
+            const double phi_j = std::atan2(y, x);
+            const arma::uword c = num_dof + 2 * (j - 1);
+
+            // Initialize a new landmark at its measured position
+            if (!seen[j - 1])
+            {
+                Xi(c) = Xi(1) + r_j * std::cos(phi_j + Xi(0));
+                Xi(c + 1) = Xi(2) + r_j * std::sin(phi_j + Xi(0));
+                seen[j - 1] = true;
+                num_seen++;
+            }
+
+            ekf_measurement_model(Xi(0), Xi(1), Xi(2), Xi(c), Xi(c + 1), z_hat, H_pose, H_landmark);
+            z_diff(0) = r_j - z_hat(0);
+            z_diff(1) = normalize_angle(phi_j - z_hat(1));
+
+            ekf_update(sigma, Xi, D, c, H_pose, H_landmark, z_diff, R, sigma_Ht, K);
+        }
+
+        // GETTERS
+
+        /// \brief get current pose prediction/correction of the robot
+        Pose2D pose() const
+        {
+            return Pose2D{Xi(0), Xi(1), Xi(2)};
+        }
+
+        /// \brief get current map vector prediction/correction of the robot
+        arma::colvec map() const
+        {
+            return Xi.tail(2 * N);
+        }
+
+        /// \brief get current state vector prediction/correction of the robot
+        const arma::vec::fixed<D> & state_vector() const
+        {
+            return Xi;
+        }
+
+        /// \brief get current covariance matrix prediction/correction of the robot
+        const arma::mat::fixed<D, D> & covariance_matrix() const
+        {
+            return sigma;
+        }
+
+        /// \brief get number of seen landmarks
+        size_t num_seen_landmarks() const
+        {
+            return num_seen;
+        }
     };
 }
 
@@ -0,0 +1,256 @@
+#ifndef FastSlam_INCLUDE_GUARD_HPP
+#define FastSlam_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Rao-Blackwellized particle filter (FastSLAM 1.0).
+
+#include <cstdint>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <stdexcept>
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/se2d.hpp"
+#include "turtlelib/diff_drive.hpp"
+#include "turtlelib/ekf.hpp"
+#include <armadillo>
+
+namespace turtlelib
+{
+    /// \brief default number of particles
+    constexpr size_t fastslam_particles = 100;
+    /// \brief default standard deviation of the rotational velocity noise, relative to the rotational velocity
+    constexpr double fastslam_rotation_noise = 0.1;
+    /// \brief default standard deviation of the translational velocity noise, relative to the translational velocity
+    constexpr double fastslam_translation_noise = 0.1;
+    /// \brief squared Mahalanobis distance under which a measurement matches a landmark. χ² at 99% for 2 degrees of freedom.
+    constexpr double fastslam_match_gate = 9.21;
+    /// \brief squared Mahalanobis distance over which a measurement is a new landmark. In between it is an outlier.
+    constexpr double fastslam_new_landmark_gate = 30.0;
+
+    /// \brief Mean and covariance of the EKF of one landmark within one particle
+    struct LandmarkGaussian
+    {
+        /// \brief x-coordinate of the landmark
+        double x = 0.0;
+        /// \brief y-coordinate of the landmark
+        double y = 0.0;
+        /// \brief variance in x
+        double sigma_xx = 0.0;
+        /// \brief covariance of x and y
+        double sigma_xy = 0.0;
+        /// \brief variance in y
+        double sigma_yy = 0.0;
+    };
+
+    /// \brief Arena of reference counted tree nodes, shared by the landmark maps of every particle.
+    /// A map is a binary tree over landmark slots, addressed by the index of its root node.
+    /// Copying a map is taking another reference to its root. Writing to a map copies only the nodes
+    /// on the path to the written slot that are shared with other maps, so a write costs O(log N).
+    /// Released nodes are recycled, so a filter in steady state does not allocate.
+    class LandmarkPool
+    {
+    public:
+        /// \brief index of the empty tree
+        static constexpr uint32_t nil = UINT32_MAX;
+
+        /// \brief make room for count nodes
+        /// \param count - number of nodes
+        void reserve(size_t count);
+
+        /// \brief take another reference to a tree
+        /// \param node - root of the tree
+        void retain(uint32_t node);
+
+        /// \brief drop a reference to a tree, recycling every node that is no longer referenced
+        /// \param node - root of the tree
+        void release(uint32_t node);
+
+        /// \brief grow a tree by one level. The old tree becomes the left half of the new one.
+        /// \param root - root of the tree, whose reference moves to the new root
+        /// \returns root of the grown tree
+        uint32_t grow(uint32_t root);
+
+        /// \brief find the landmark in a slot of a tree
+        /// \param root - root of the tree
+        /// \param depth - depth of the tree, which has 2^depth slots
+        /// \param slot - slot of the landmark, from 0
+        /// \returns the landmark, or nullptr if the slot is empty
+        const LandmarkGaussian * find(uint32_t root, size_t depth, size_t slot) const;
+
+        /// \brief make a slot of a tree writable, copying the shared nodes on its path
+        /// \param root - root of the tree, updated if the root was copied
+        /// \param depth - depth of the tree, which has 2^depth slots
+        /// \param slot - slot of the landmark, from 0
+        /// \returns the landmark, valid until the next call that adds nodes to the pool
+        LandmarkGaussian & write(uint32_t & root, size_t depth, size_t slot);
+
+        /// \brief visit every landmark of a tree in slot order
+        /// \param root - root of the tree
+        /// \param depth - depth of the tree, which has 2^depth slots
+        /// \param visit - called with the slot and the landmark
+        template<class Visitor>
+        void for_each(uint32_t root, size_t depth, Visitor && visit) const
+        {
+            for_each(root, depth, 0, visit);
+        }
+
+        /// \brief get number of nodes in use by all trees
+        size_t num_nodes() const;
+
+    private:
+        /// \brief A tree node. Leaves hold a landmark, inner nodes their two children.
+        struct Node
+        {
+            /// \brief left and right children
+            uint32_t child[2] = {nil, nil};
+            /// \brief number of references to this node
+            uint32_t refs = 0;
+            /// \brief landmark of a leaf
+            LandmarkGaussian landmark{};
+        };
+
+        /// \brief every node, in use or free
+        std::vector<Node> nodes{};
+        /// \brief indices of the free nodes
+        std::vector<uint32_t> free_nodes{};
+
+        /// \brief a node with one reference and no children
+        uint32_t acquire();
+
+        /// \brief a node with the contents of node that the caller holds the only reference to.
+        /// Copies node if it is shared, and gives a new node if it is nil.
+        uint32_t make_unique(uint32_t node);
+
+        /// \brief visit every landmark of a subtree
+        template<class Visitor>
+        void for_each(uint32_t node, size_t level, size_t first_slot, Visitor & visit) const
+        {
+            if (node == nil)
+            {
+                return;
+            }
+            if (level == 0)
+            {
+                visit(first_slot, nodes[node].landmark);
+                return;
+            }
+            const size_t half = size_t{1} << (level - 1);
+            for_each(nodes[node].child[0], level - 1, first_slot, visit);
+            for_each(nodes[node].child[1], level - 1, first_slot + half, visit);
+        }
+    };
+
+    /// \brief FastSLAM 1.0. Every particle holds a robot pose and a map of independent 2 x 2 landmark EKFs.
+    /// Maps are copy-on-write trees in a shared LandmarkPool, so resampling copies no landmarks
+    /// and an update costs O(M log N) for M particles and N landmarks.
+    class FastSlam
+    {
+    private:
+        /// \brief One hypothesis of the robot path and the map
+        struct Particle
+        {
+            /// \brief pose of the robot
+            Pose2D pose{};
+            /// \brief log of the unnormalized importance weight
+            double log_weight = 0.0;
+            /// \brief root of the landmark tree in the pool
+            uint32_t map = LandmarkPool::nil;
+        };
+
+        /// \brief Particles of the filter
+        std::vector<Particle> particles{};
+        /// \brief Scratch for resampling, with the capacity of particles
+        std::vector<Particle> resampled{};
+        /// \brief Scratch for the normalized weights
+        std::vector<double> weights{};
+        /// \brief Landmark trees of every particle
+        LandmarkPool pool{};
+        /// \brief Depth of every landmark tree, which has 2^depth slots. Landmark j is in slot j-1.
+        size_t depth = 0;
+        /// \brief Whether landmark j has been seen, at j-1
+        std::vector<bool> seen_landmarks{};
+        /// \brief Number of landmarks seen
+        size_t num_seen = 0;
+        /// \brief Random number generator for motion noise and resampling
+        std::mt19937 generator;
+        /// \brief Standard deviation of the rotational velocity noise, relative to the rotational velocity
+        double rotation_noise = fastslam_rotation_noise;
+        /// \brief Standard deviation of the translational velocity noise, relative to the translational velocity
+        double translation_noise = fastslam_translation_noise;
+
+        /// \brief EKF update of landmark j in one particle, or its initialization if the particle has not seen it
+        /// \param particle - particle to update
+        /// \param r_j - measured range
+        /// \param phi_j - measured bearing
+        /// \param j - landmark index j
+        /// \returns log likelihood of the measurement
+        double update_landmark(Particle & particle, double r_j, double phi_j, size_t j);
+
+        /// \brief normalize the particle weights into weights
+        void normalize_weights();
+
+        /// \brief low-variance resampling, when the effective number of particles falls below half
+        void resample_if_degenerate();
+
+        /// \brief get the index of the particle with the highest weight
+        size_t best_particle() const;
+
+    public:
+        /// \brief start at origin with the default number of particles
+        FastSlam();
+
+        /// \brief set robot start config
+        /// \param turtle_pose_0 - robot start pose
+        /// \param num_particles - number of particles
+        /// \param seed - seed of the random number generator
+        explicit FastSlam(Pose2D turtle_pose_0, size_t num_particles = fastslam_particles, unsigned int seed = 0);
+
+        /// \brief set the motion noise of the particles
+        /// \param rotation - standard deviation of the rotational velocity noise, relative to the rotational velocity
+        /// \param translation - standard deviation of the translational velocity noise, relative to the translational velocity
+        void set_motion_noise(double rotation, double translation);
+
+        /// \brief sample the motion of every particle
+        /// \param twist - twist control at time t
+        void predict(Twist2D twist);
+
+        /// \brief correction calculations
+        /// \param x - sensed landmark relative x-coordinate
+        /// \param y - sensed landmark relative y-coordinate
+        /// \param j - sensed landmark index j
+        void correct(double x, double y, size_t j);
+
+        /// \brief correct for all landmarks sensed in a scan, resampling at most once
+        /// \param measurements - sensed landmark relative coordinates
+        /// \param indices - landmark index j of each measurement. 0 marks an outlier, which is skipped.
+        void correct_batch(const std::vector<Point2D> & measurements, const std::vector<size_t> & indices);
+
+        /// \brief maximum likelihood data association of every measurement of one scan, against the map of the best particle.
+        /// A known landmark is given to at most one measurement.
+        /// \param measurements - relative positions of the unknown landmarks
+        /// \returns j for each measurement. 0 marks an outlier, indices past the known landmarks are new landmarks
+        std::vector<size_t> associate_indices(const std::vector<Point2D> & measurements) const;
+
+        // GETTERS
+
+        /// \brief get the weighted mean pose of the particles
+        Pose2D pose() const;
+
+        /// \brief get the map of the best particle. [m_x1 m_y1 m_x2 m_y2 ...]^T, with zeros for unseen landmarks.
+        arma::colvec map() const;
+
+        /// \brief get number of seen landmarks
+        size_t num_seen_landmarks() const;
+
+        /// \brief get number of particles
+        size_t num_particles() const;
+
+        /// \brief get the effective number of particles, 1 / Σ w_i²
+        double effective_particles() const;
+
+        /// \brief get number of landmark tree nodes in use by all particles
+        size_t num_map_nodes() const;
+    };
+}
+
+#endif
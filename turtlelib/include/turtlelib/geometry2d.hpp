@@ -5,6 +5,8 @@
 
 
 #include <iosfwd> // contains forward definitions for iostream objects
+#include <cmath>
+#include <type_traits>
 namespace turtlelib
 {
     /// \brief PI.  Not in C++ standard until C++20.
@@ -43,7 +45,15 @@ namespace turtlelib
     /// \brief wrap an angle to (-PI, PI]
     /// \param rad (angle in radians)
     /// \return an angle equivalent to rad but in the range (-PI, PI]
-    double normalize_angle(double rad);
+    /// NOTE: inline rather than constexpr, since std::atan2 is not constexpr in C++17
+    inline double normalize_angle(double rad)
+    {
+        if (almost_equal(rad, -PI))
+        {
+            return PI;
+        }
+        return std::atan2(std::sin(rad), std::cos(rad));
+    }
 
     /// static_assertions test compile time assumptions.
     /// You should write at least one more test for each function
@@ -63,19 +73,28 @@ namespace turtlelib
     
 
     /// \brief a 2-Dimensional Point
-    struct Point2D
+    /// \tparam T - scalar type of the coordinates
+    template<class T>
+    struct Point2
     {
         /// \brief the x coordinate
-        double x = 0.0;
+        T x = 0;
 
         /// \brief the y coordinate
-        double y = 0.0;
+        T y = 0;
     };
 
+    /// \brief a 2-Dimensional Point in double precision
+    using Point2D = Point2<double>;
+
+    /// \brief a 2-Dimensional Point in single precision
+    using Point2F = Point2<float>;
+
     /// \brief output a 2 dimensional point as [xcomponent ycomponent]
     /// \param os - stream to output to
     /// \param p - the point to print
-    std::ostream & operator<<(std::ostream & os, const Point2D & p);
+    template<class T>
+    std::ostream & operator<<(std::ostream & os, const Point2<T> & p);
 
     /// \brief input a 2 dimensional point
     ///   You should be able to read vectors entered as follows:
@@ -83,36 +102,59 @@ namespace turtlelib
     /// \param is - stream from which to read
     /// \param p [out] - output vector
     /// HINT: See operator>> for Vector2D
-    std::istream & operator>>(std::istream & is, Point2D & p);
+    template<class T>
+    std::istream & operator>>(std::istream & is, Point2<T> & p);
 
     /// \brief A 2-Dimensional Vector
-    struct Vector2D
+    /// \tparam T - scalar type of the components
+    template<class T>
+    struct Vector2
     {
         /// \brief the x coordinate
-        double x = 0.0;
+        T x = 0;
 
         /// \brief the y coordinate
-        double y = 0.0;
+        T y = 0;
     };
 
+    /// \brief A 2-Dimensional Vector in double precision
+    using Vector2D = Vector2<double>;
+
+    /// \brief A 2-Dimensional Vector in single precision
+    using Vector2F = Vector2<float>;
+
+    /// \brief scalar type of scale factors, which never takes part in deducing T,
+    /// so a vector of either precision can be scaled by a double or an int
+    template<class T>
+    using Scalar = typename std::common_type<T>::type;
+
     /// \brief Subtracting one point from another yields a vector
     /// \param head point corresponding to the head of the vector
     /// \param tail point corresponding to the tail of the vector
     /// \return a vector that points from p1 to p2
     /// NOTE: this is not implemented in terms of -= because subtracting two Point2D yields a Vector2D
-    Vector2D operator-(const Point2D & head, const Point2D & tail);
+    template<class T>
+    constexpr Vector2<T> operator-(const Point2<T> & head, const Point2<T> & tail)
+    {
+        return Vector2<T>{head.x - tail.x, head.y - tail.y};
+    }
 
     /// \brief Adding a vector to a point yields a new point displaced by the vector
     /// \param tail The origin of the vector's tail
     /// \param disp The displacement vector
     /// \return the point reached by displacing by disp from tail
     /// NOTE: this is not implemented in terms of += because of the different types
-    Point2D operator+(const Point2D & tail, const Vector2D & disp);
+    template<class T>
+    constexpr Point2<T> operator+(const Point2<T> & tail, const Vector2<T> & disp)
+    {
+        return Point2<T>{tail.x + disp.x, tail.y + disp.y};
+    }
 
     /// \brief output a 2 dimensional vector as [xcomponent ycomponent]
     /// \param os - stream to output to
     /// \param v - the vector to print
-    std::ostream & operator<<(std::ostream & os, const Vector2D & v);
+    template<class T>
+    std::ostream & operator<<(std::ostream & os, const Vector2<T> & v);
 
     /// \brief input a 2 dimensional vector
     ///   You should be able to read vectors entered as follows:
@@ -132,66 +174,145 @@ namespace turtlelib
     /// We have lower level control however. For example:
     /// peek looks at the next unprocessed character in the buffer without removing it
     /// get removes the next unprocessed character from the buffer.
-    std::istream & operator>>(std::istream & is, Vector2D & v);
+    template<class T>
+    std::istream & operator>>(std::istream & is, Vector2<T> & v);
 
     // Normalize Vector
-    Vector2D normalizeVector(const Vector2D & v);
+    template<class T>
+    Vector2<T> normalizeVector(const Vector2<T> & v);
 
     /// \brief Subtracting two vectors yields a new vector
     /// \param va Vector A
     /// \param vb Vector B
     /// \return Vector A relative to vector B
-    Vector2D operator-(const Vector2D & va, const Vector2D & vb);
+    template<class T>
+    constexpr Vector2<T> operator-(const Vector2<T> & va, const Vector2<T> & vb)
+    {
+        return Vector2<T>{va.x - vb.x, va.y - vb.y};
+    }
 
     /// \brief Adding two vectors yields a new vector
     /// \param va Vector A
     /// \param vb Vector B
     /// \return Resultant vector
-    Vector2D operator+(const Vector2D & va, const Vector2D & vb);
+    template<class T>
+    constexpr Vector2<T> operator+(const Vector2<T> & va, const Vector2<T> & vb)
+    {
+        return Vector2<T>{va.x + vb.x, va.y + vb.y};
+    }
 
     /// \brief Scaling a vector
     /// \param scale scalar
     /// \param v Vector to be scaled
     /// \return Scaled vector
-    Vector2D operator*(const double & scale, const Vector2D & v);
+    template<class T>
+    constexpr Vector2<T> operator*(const Scalar<T> & scale, const Vector2<T> & v)
+    {
+        return Vector2<T>{scale * v.x, scale * v.y};
+    }
 
     /// \brief Scaling a vector
     /// \param v Vector to be scaled
     /// \param scale scalar
     /// \return Scaled vector
-    Vector2D operator*(const Vector2D & v, const double & scale);
+    template<class T>
+    constexpr Vector2<T> operator*(const Vector2<T> & v, const Scalar<T> & scale)
+    {
+        return Vector2<T>{scale * v.x, scale * v.y};
+    }
 
     /// \brief Subtracting a vector from a vector, changes the vector
     /// \param rhv Right Hand Vector
     /// \return Diminished vector
-    Vector2D operator-=(Vector2D & lhv, const Vector2D & rhv);
+    template<class T>
+    constexpr Vector2<T> operator-=(Vector2<T> & lhv, const Vector2<T> & rhv)
+    {
+        lhv = lhv - rhv;
+        return lhv;
+    }
 
     /// \brief Adding a vector to a vector, changes the vector
     /// \param rhv Right Hand Vector
     /// \return Extended vector
-    Vector2D operator+=(Vector2D & lhv, const Vector2D & rhv);    
+    template<class T>
+    constexpr Vector2<T> operator+=(Vector2<T> & lhv, const Vector2<T> & rhv)
+    {
+        lhv = lhv + rhv;
+        return lhv;
+    }
 
     /// \brief Multiplying a vector with a scalar, scales the vector
     /// \param rhv Right Hand Vector
     /// \return Scaled vector
-    Vector2D operator*=(Vector2D & lhv, const double & scale);   
+    template<class T>
+    constexpr Vector2<T> operator*=(Vector2<T> & lhv, const Scalar<T> & scale)
+    {
+        lhv = lhv * scale;
+        return lhv;
+    }
 
     /// \brief Dot product of two vectors yields a scalar
     /// \param va Vector A
     /// \param vb Vector B
     /// \return Dot product
-    double dot(const Vector2D & va, const Vector2D & vb);
+    template<class T>
+    constexpr T dot(const Vector2<T> & va, const Vector2<T> & vb)
+    {
+        return va.x * vb.x + va.y * vb.y;
+    }
 
     /// \brief Magnitude of a vector is a non-negative scalar
     /// \param v Vector 
     /// \return Magnitude
-    double magnitude(const Vector2D & v);
+    /// NOTE: inline rather than constexpr, since std::sqrt is not constexpr in C++17
+    template<class T>
+    inline T magnitude(const Vector2<T> & v)
+    {
+        return std::sqrt(dot(v, v));
+    }
 
     /// \brief Compute the angle between two vectors
     /// \param va Vector A
     /// \param vb Vector B
     /// \return Angle(V_a) - Angle(V_b) (positive counterclockwise) 
-    double angle(const Vector2D & va, const Vector2D & vb);
+    template<class T>
+    T angle(const Vector2<T> & va, const Vector2<T> & vb);
+
+    static_assert(almost_equal((Point2D{3.0, 4.0} - Point2D{1.0, 1.0}).x, 2.0), "point subtraction failed");
+    static_assert(almost_equal((Point2D{3.0, 4.0} - Point2D{1.0, 1.0}).y, 3.0), "point subtraction failed");
+    static_assert(almost_equal((Point2D{1.0, 1.0} + Vector2D{-2.0, 0.5}).y, 1.5), "displacement failed");
+    static_assert(almost_equal((Vector2D{1.0, 2.0} + Vector2D{3.0, 4.0}).x, 4.0), "vector addition failed");
+    static_assert(almost_equal((Vector2D{1.0, 2.0} - Vector2D{3.0, 4.0}).y, -2.0), "vector subtraction failed");
+    static_assert(almost_equal((2.0 * Vector2D{1.0, -3.0}).y, -6.0), "vector scaling failed");
+    static_assert(almost_equal((Vector2D{1.0, -3.0} * 0.0).y, 0.0), "vector scaling by zero failed");
+    static_assert(almost_equal(dot(Vector2D{-69.0, 4.2}, Vector2D{-4.2, 6.9}), 318.78), "dot failed");
+    static_assert(almost_equal(dot(Vector2D{1.0, 0.0}, Vector2D{0.0, 1.0}), 0.0), "dot of perpendicular vectors failed");
+    static_assert(almost_equal(dot(Vector2F{1.5f, 2.0f}, 2 * Vector2F{2.0f, 0.25f}), 7.0), "single precision failed");
+
+    static_assert([]()
+    {
+        // (1, 2) displaced by twice (3, -1) lands on (7, 0)
+        Vector2D disp{3.0, -1.0};
+        disp *= 2.0;
+        disp += Vector2D{1.0, 1.0};
+        disp -= Vector2D{1.0, 1.0};
+        const Point2D p = Point2D{1.0, 2.0} + disp;
+        return almost_equal(p.x, 7.0) && almost_equal(p.y, 0.0);
+    }(), "composed vector operators failed");
+
+    // The stream operators, normalizeVector and angle are compiled once in geometry2d.cpp, for float and double
+    extern template std::ostream & operator<<(std::ostream & os, const Point2<double> & p);
+    extern template std::ostream & operator<<(std::ostream & os, const Point2<float> & p);
+    extern template std::istream & operator>>(std::istream & is, Point2<double> & p);
+    extern template std::istream & operator>>(std::istream & is, Point2<float> & p);
+    extern template std::ostream & operator<<(std::ostream & os, const Vector2<double> & v);
+    extern template std::ostream & operator<<(std::ostream & os, const Vector2<float> & v);
+    extern template std::istream & operator>>(std::istream & is, Vector2<double> & v);
+    extern template std::istream & operator>>(std::istream & is, Vector2<float> & v);
+    extern template Vector2<double> normalizeVector(const Vector2<double> & v);
+    extern template Vector2<float> normalizeVector(const Vector2<float> & v);
+    extern template double angle(const Vector2<double> & va, const Vector2<double> & vb);
+    extern template float angle(const Vector2<float> & va, const Vector2<float> & vb);
 }
 
 #endif
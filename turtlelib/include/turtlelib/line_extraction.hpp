@@ -0,0 +1,125 @@
+#ifndef LINE_EXTRACTION_INCLUDE_GUARD_HPP
+#define LINE_EXTRACTION_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Split-and-merge extraction of wall segments and corners from a lidar scan.
+// https://doi.org/10.1109/IROS.2005.1545234 (Nguyen et al., A comparison of line extraction algorithms using 2D laser rangefinder)
+
+#include <iosfwd>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "turtlelib/geometry2d.hpp"
+
+namespace turtlelib
+{
+    /// \brief A wall segment, on the line x cos(alpha) + y sin(alpha) = rho
+    struct LineSegment
+    {
+        /// \brief first end point, the first point of the segment projected on the line
+        Point2D start{};
+        /// \brief second end point, the last point of the segment projected on the line
+        Point2D end{};
+        /// \brief distance of the line from the origin [m]
+        double rho = 0.0;
+        /// \brief angle of the normal of the line from the origin [rad]
+        double alpha = 0.0;
+        /// \brief index of the first scan point of the segment
+        size_t first = 0;
+        /// \brief index of the last scan point of the segment
+        size_t last = 0;
+    };
+
+    /// \brief Where two consecutive segments meet at an angle
+    struct Corner
+    {
+        /// \brief intersection of the lines of the two segments
+        Point2D position{};
+        /// \brief angle between the directions of the two segments [rad], in (0, PI]
+        double angle = 0.0;
+        /// \brief index of the first of the two segments
+        size_t segment = 0;
+    };
+
+    /// \brief Thresholds of LineExtractor
+    struct LineExtractionLimits
+    {
+        /// \brief points farther than this from the chord of a run split it [m]
+        double split_distance = 0.03;
+        /// \brief consecutive points farther apart than this start a new run [m]
+        double max_gap = 0.2;
+        /// \brief fewest points in a segment
+        size_t min_points = 5;
+        /// \brief shortest segment [m]
+        double min_length = 0.1;
+        /// \brief consecutive segments whose normals differ by less than this are merged [rad]
+        double merge_angle = deg2rad(5.0);
+        /// \brief consecutive segments whose distances from the origin differ by less than this are merged [m]
+        double merge_distance = 0.05;
+        /// \brief consecutive segments whose facing end points are closer than this can form a corner [m]
+        double corner_distance = 0.1;
+        /// \brief smallest angle between the directions of two segments that forms a corner [rad]
+        double min_corner_angle = deg2rad(45.0);
+    };
+
+    /// \brief Split-and-merge line extraction. Buffers are kept between scans,
+    /// so extracting from scans of at most the reserved size does not allocate.
+    class LineExtractor
+    {
+    private:
+        /// \brief thresholds
+        LineExtractionLimits limits{};
+        /// \brief extracted segments, in scan order
+        std::vector<LineSegment> line_segments{};
+        /// \brief extracted corners, in scan order
+        std::vector<Corner> line_corners{};
+        /// \brief intervals of points still to be split
+        std::vector<std::pair<size_t, size_t>> pending{};
+
+        /// \brief least squares line through points first to last, with its end points
+        /// \param points - scan points
+        /// \param first - index of the first point
+        /// \param last - index of the last point
+        /// \returns the fitted segment
+        LineSegment fit(const Point2D * points, size_t first, size_t last) const;
+
+        /// \brief split one run of points into segments
+        /// \param points - scan points
+        /// \param first - index of the first point of the run
+        /// \param last - index of the last point of the run
+        void split(const Point2D * points, size_t first, size_t last);
+
+        /// \brief merge consecutive collinear segments
+        /// \param points - scan points
+        void merge(const Point2D * points);
+
+        /// \brief find the corners between consecutive segments
+        void find_corners();
+
+    public:
+        /// \brief an extractor with the default thresholds
+        LineExtractor();
+
+        /// \brief an extractor with room for scans of max_points points
+        /// \param max_points - number of points in the largest expected scan
+        /// \param limits - thresholds
+        explicit LineExtractor(size_t max_points, LineExtractionLimits limits = LineExtractionLimits{});
+
+        /// \brief extract the segments and corners of one scan
+        /// \param points - hits of the scan, in scan order
+        /// \param count - number of points
+        void extract(const Point2D * points, size_t count);
+
+        /// \brief extract the segments and corners of one scan
+        /// \param points - hits of the scan, in scan order
+        void extract(const std::vector<Point2D> & points);
+
+        /// \brief get the segments of the last scan, in scan order
+        const std::vector<LineSegment> & segments() const;
+
+        /// \brief get the corners of the last scan, in scan order
+        const std::vector<Corner> & corners() const;
+    };
+}
+
+#endif
@@ -5,6 +5,9 @@
 
 
 #include<iosfwd> // contains forward definitions for iostream objects
+#include<cmath>
+#include<cstddef>
+#include<vector>
 
 #include"turtlelib/geometry2d.hpp"
 
@@ -12,117 +15,218 @@ namespace turtlelib
 {
 
     /// \brief represent a 2-Dimensional twist
-    struct Twist2D
+    /// \tparam T - scalar type of the velocities
+    template<class T>
+    struct Twist2
     {
         /// \brief the angular velocity
-        double omega = 0.0;
+        T omega = 0;
 
         /// \brief the linear x velocity
-        double x = 0.0;
+        T x = 0;
 
         /// \brief the linear y velocity
-        double y = 0.0;
+        T y = 0;
     };
 
+    /// \brief a 2-Dimensional twist in double precision
+    using Twist2D = Twist2<double>;
+
+    /// \brief a 2-Dimensional twist in single precision
+    using Twist2F = Twist2<float>;
+
     /// \brief print the Twist2D in the format [w x y]
     /// \param os [in/out] the ostream to write to
     /// \param tw the twist to output
     /// \returns the ostream os  with the twist data inserted
-    std::ostream & operator<<(std::ostream & os, const Twist2D & tw);
+    template<class T>
+    std::ostream & operator<<(std::ostream & os, const Twist2<T> & tw);
 
     /// \brief read the Twist2D in the format [w x y] or as w x y
     /// \param is [in/out] the istream to read from
     /// \param tw [out] the twist read from the stream
     /// \returns the istream is with the twist characters removed
-    std::istream & operator>>(std::istream & is, Twist2D & tw);
+    template<class T>
+    std::istream & operator>>(std::istream & is, Twist2<T> & tw);
 
 
     /// \brief a rigid body transformation in 2 dimensions
-    class Transform2D
+    /// \tparam T - scalar type of the transform and of what it is applied to
+    template<class T>
+    class Transform2
     {
 
     private:
         /// \brief the vector by which to translate in 2D
-        Vector2D translationVector;
+        Vector2<T> translationVector{};
         /// \brief angle of the rotation, in radians
-        double rotationAngle;
+        T rotationAngle = 0;
+        /// \brief cosine of the rotation, so applying the transform needs no trigonometry
+        T cosRotation = 1;
+        /// \brief sine of the rotation
+        T sinRotation = 0;
 
     public:
         /// \brief Create an identity transformation
-        Transform2D();
+        constexpr Transform2() = default;
 
         /// \brief create a transformation that is a pure translation
         /// \param trans - the vector by which to translate
-        explicit Transform2D(Vector2D trans);
+        constexpr explicit Transform2(Vector2<T> trans) : translationVector{trans} {}
 
         /// \brief create a pure rotation
         /// \param radians - angle of the rotation, in radians
-        explicit Transform2D(double radians);
+        explicit Transform2(T radians) : Transform2{Vector2<T>{}, radians} {}
 
         /// \brief Create a transformation with a translational and rotational
         /// component
         /// \param trans - the translation
         /// \param radians - the rotation, in radians
-        Transform2D(Vector2D trans, double radians);
+        Transform2(Vector2<T> trans, T radians) :
+        translationVector{trans}, rotationAngle{static_cast<T>(normalize_angle(radians))},
+        cosRotation{std::cos(rotationAngle)}, sinRotation{std::sin(rotationAngle)}
+        {}
 
         /// \brief apply a transformation to a 2D Point
         /// \param p the point to transform
         /// \return a point in the new coordinate system
-        Point2D operator()(Point2D p) const;
+        constexpr Point2<T> operator()(Point2<T> p) const
+        {
+            // Rotate, then translate in the global frame.
+            return Point2<T>{p.x * cosRotation - p.y * sinRotation,
+                           p.x * sinRotation + p.y * cosRotation} + translationVector;
+        }
 
         /// \brief apply a transformation to a 2D Vector
         /// \param v - the vector to transform
         /// \return a vector in the new coordinate system
-        Vector2D operator()(Vector2D v) const;
+        constexpr Vector2<T> operator()(Vector2<T> v) const
+        {
+            return Vector2<T>{v.x * cosRotation - v.y * sinRotation,
+                            v.x * sinRotation + v.y * cosRotation};
+        }
 
         /// \brief apply a transformation to a Twist2D (e.g. using the adjoint)
         /// \param v - the twist to transform
         /// \return a twist in the new coordinate system
-        Twist2D operator()(Twist2D v) const;
+        constexpr Twist2<T> operator()(Twist2<T> v) const
+        {
+            return Twist2<T>{v.omega,
+                           v.x * cosRotation - v.y * sinRotation + translationVector.y * v.omega,
+                           v.x * sinRotation + v.y * cosRotation - translationVector.x * v.omega};
+        }
+
+        /// \brief apply a transformation to a batch of points, stored as separate arrays of
+        /// coordinates. The outputs may be the inputs, to transform in place.
+        /// \param xs - x coordinates of the points
+        /// \param ys - y coordinates of the points
+        /// \param out_x [out] - x coordinates of the points in the new coordinate system
+        /// \param out_y [out] - y coordinates of the points in the new coordinate system
+        /// \param count - number of points
+        void apply(const T * xs, const T * ys, T * out_x, T * out_y, size_t count) const;
+
+        /// \brief apply a transformation to a batch of points, stored as separate arrays of coordinates
+        /// \param xs - x coordinates of the points
+        /// \param ys - y coordinates of the points
+        /// \param out_x [out] - x coordinates of the points in the new coordinate system, resized to fit
+        /// \param out_y [out] - y coordinates of the points in the new coordinate system, resized to fit
+        void apply(const std::vector<T> & xs, const std::vector<T> & ys,
+                   std::vector<T> & out_x, std::vector<T> & out_y) const;
+
+        /// \brief apply the composition (*this) * rhs to a batch of points. Cheaper than composing
+        /// first, since the composed rotation is never normalized or passed through cos and sin.
+        /// \param rhs - the first transform to apply
+        /// \param xs - x coordinates of the points
+        /// \param ys - y coordinates of the points
+        /// \param out_x [out] - x coordinates of the points in the new coordinate system
+        /// \param out_y [out] - y coordinates of the points in the new coordinate system
+        /// \param count - number of points
+        void apply_composed(const Transform2 & rhs, const T * xs, const T * ys,
+                            T * out_x, T * out_y, size_t count) const;
 
         /// \brief invert the transformation
         /// \return the inverse transformation.
-        Transform2D inv() const;
+        Transform2 inv() const
+        {
+            // R^T and -R^T p
+            return Transform2{Vector2<T>{-(translationVector.x * cosRotation + translationVector.y * sinRotation),
+                                        -(-translationVector.x * sinRotation + translationVector.y * cosRotation)},
+                               -rotationAngle};
+        }
 
         /// \brief compose this transform with another and store the result
         /// in this object
         /// \param rhs - the first transform to apply
         /// \return a reference to the newly transformed operator
-        Transform2D & operator*=(const Transform2D & rhs);
+        Transform2 & operator*=(const Transform2 & rhs)
+        {
+            // R_a * p_rhs + p_a, which is equivalent to T_a * p_rhs, and R_a * R_rhs
+            const Point2<T> p = (*this)(Point2<T>{rhs.translationVector.x, rhs.translationVector.y});
+            *this = Transform2{Vector2<T>{p.x, p.y}, rotationAngle + rhs.rotationAngle};
+            return *this;
+        }
 
         /// \brief the translational component of the transform
         /// \return the x,y translation
-        Vector2D translation() const;
+        constexpr Vector2<T> translation() const
+        {
+            return translationVector;
+        }
 
         /// \brief get the angular displacement of the transform
         /// \return the angular displacement, in radians
-        double rotation() const;
-
-        /// \brief \see operator<<(...) (declared outside this class)
-        /// for a description
-        friend std::ostream & operator<<(std::ostream & os, const Transform2D & tf);
+        constexpr T rotation() const
+        {
+            return rotationAngle;
+        }
 
     };
 
+    /// \brief a rigid body transformation in 2 dimensions in double precision
+    using Transform2D = Transform2<double>;
+
+    /// \brief a rigid body transformation in 2 dimensions in single precision
+    using Transform2F = Transform2<float>;
+
+    // The batched members are compiled once in se2d.cpp, for float and double
+    extern template class Transform2<double>;
+    extern template class Transform2<float>;
+
+    static_assert(almost_equal(Transform2D{}(Point2D{1.0, 2.0}).y, 2.0), "identity transform failed");
+    static_assert(almost_equal(Transform2D{Vector2D{1.0, -1.0}}(Point2D{1.0, 2.0}).x, 2.0), "translation failed");
+    static_assert(almost_equal(Transform2D{Vector2D{1.0, -1.0}}(Vector2D{1.0, 2.0}).y, 2.0),
+                  "translating a vector failed");
+    static_assert(almost_equal(Transform2D{Vector2D{1.0, -1.0}}(Twist2D{1.0, 1.0, 2.0}).x, 0.0),
+                  "adjoint of a translation failed");
+    static_assert(almost_equal(Transform2F{Vector2F{0.5f, 0.25f}}(Point2F{1.0f, 2.0f}).y, 2.25),
+                  "single precision translation failed");
+
 
     /// \brief should print a human readable version of the transform:
     /// An example output:
     /// deg: 90 x: 3 y: 5
     /// \param os - an output stream
     /// \param tf - the transform to print
-    std::ostream & operator<<(std::ostream & os, const Transform2D & tf);
+    template<class T>
+    std::ostream & operator<<(std::ostream & os, const Transform2<T> & tf);
 
     /// \brief Read a transformation from stdin
     /// Should be able to read input either as output by operator<< or
     /// as 3 numbers (degrees, dx, dy) separated by spaces or newlines
-    std::istream & operator>>(std::istream & is, Transform2D & tf);
+    template<class T>
+    std::istream & operator>>(std::istream & is, Transform2<T> & tf);
 
     /// \brief multiply two transforms together, returning their composition
     /// \param lhs - the left hand operand
     /// \param rhs - the right hand operand
     /// \return the composition of the two transforms
     /// HINT: This function should be implemented in terms of *=
-    Transform2D operator*(Transform2D lhs, const Transform2D & rhs);
+    template<class T>
+    Transform2<T> operator*(Transform2<T> lhs, const Transform2<T> & rhs)
+    {
+        lhs *= rhs;
+        return lhs;
+    }
 
     /// \brief Compute the transformation corresponding to a rigid body following a constant twist (from its original frame) for one time-unit
     /// \param twist - twist to be applied
@@ -131,6 +235,15 @@ namespace turtlelib
 
     Twist2D differentiate_transform(const Transform2D & T_bB);
 
+    // The stream operators are compiled once in se2d.cpp, for float and double
+    extern template std::ostream & operator<<(std::ostream & os, const Twist2<double> & tw);
+    extern template std::ostream & operator<<(std::ostream & os, const Twist2<float> & tw);
+    extern template std::istream & operator>>(std::istream & is, Twist2<double> & tw);
+    extern template std::istream & operator>>(std::istream & is, Twist2<float> & tw);
+    extern template std::ostream & operator<<(std::ostream & os, const Transform2<double> & tf);
+    extern template std::ostream & operator<<(std::ostream & os, const Transform2<float> & tf);
+    extern template std::istream & operator>>(std::istream & is, Transform2<double> & tf);
+    extern template std::istream & operator>>(std::istream & is, Transform2<float> & tf);
 }
 
 #endif
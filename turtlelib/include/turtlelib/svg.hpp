@@ -2,8 +2,11 @@
 #ifndef SVG_H
 #define SVG_H
 
+#include <cstddef>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <string>
 #include <vector>
 
 /// \file
@@ -67,4 +70,105 @@ private:
     std::vector<std::string> elements;
 };
 
+/// \brief Streaming SVG file writer. Elements go straight to a buffered file instead of being
+/// kept in memory, and long trajectories are written as decimated polylines point by point,
+/// so a whole episode takes the same memory as a single element.
+class SVGStream {
+public:
+    /// \brief Opens the .svg file and writes its header
+    /// \param filename name of the file to write to
+    /// \param width width of the image
+    /// \param height height of the image
+    /// \param buffer_size size of the file buffer, in bytes
+    SVGStream(const std::string& filename, double width, double height, size_t buffer_size = 1 << 16);
+
+    /// \brief Closes the file, if it was not closed already
+    ~SVGStream();
+
+    SVGStream(const SVGStream&) = delete;
+    SVGStream& operator=(const SVGStream&) = delete;
+
+    /// \brief Adds a rectangle to the .svg
+    /// \param x x coordinate of the rectangle
+    /// \param y y coordinate of the rectangle
+    /// \param width width of the rectangle
+    /// \param height height of the rectangle
+    /// \param fill color of the rectangle
+    void addRectangle(double x, double y, double width, double height, const std::string& fill);
+
+    /// \brief Adds a circle to the .svg
+    /// \param cx x coordinate of the centre
+    /// \param cy y coordinate of the centre
+    /// \param r radius of the circle
+    /// \param color color of the circle
+    void addCircle(double cx, double cy, double r, const std::string& color);
+
+    /// \brief Adds a line to the .svg
+    /// \param x1 x of the start of the line
+    /// \param y1 y of the start of the line
+    /// \param x2 x of the end of the line
+    /// \param y2 y of the end of the line
+    /// \param stroke color of the line
+    void addLine(double x1, double y1, double x2, double y2, const std::string& stroke);
+
+    /// \brief Adds text to the .svg
+    /// \param x x coordinate of the text box
+    /// \param y y coordinate of the text box
+    /// \param text the text that is written to the .svg
+    void addText(double x, double y, const std::string& text);
+
+    /// \brief Starts a polyline. Points closer than min_spacing to the last written point are skipped,
+    /// except for the last point of the polyline.
+    /// \param stroke color of the polyline
+    /// \param min_spacing smallest distance between consecutive written points
+    void beginPolyline(const std::string& stroke, double min_spacing = 0.0);
+
+    /// \brief Adds a point to the open polyline
+    /// \param x x coordinate of the point
+    /// \param y y coordinate of the point
+    void addPoint(double x, double y);
+
+    /// \brief Ends the open polyline
+    void endPolyline();
+
+    /// \brief Writes the closing tag and closes the file. Nothing can be added afterwards.
+    void close();
+
+    /// \brief Gets the number of polyline points written to the file
+    /// \return the number of written points
+    size_t pointsWritten() const;
+
+    /// \brief Gets the number of polyline points skipped by decimation
+    /// \return the number of skipped points
+    size_t pointsSkipped() const;
+
+private:
+    /// \brief the .svg file, or nullptr once closed
+    std::FILE* file = nullptr;
+    /// \brief buffer of the file
+    std::vector<char> buffer;
+    /// \brief whether a polyline is open
+    bool polyline_open = false;
+    /// \brief squared smallest distance between consecutive points of the open polyline
+    double min_spacing_sq = 0.0;
+    /// \brief whether the open polyline has a written point
+    bool has_last = false;
+    /// \brief last written point of the open polyline
+    double last_x = 0.0, last_y = 0.0;
+    /// \brief whether a skipped point is waiting to end the open polyline
+    bool has_pending = false;
+    /// \brief latest skipped point of the open polyline
+    double pending_x = 0.0, pending_y = 0.0;
+    /// \brief number of polyline points written
+    size_t written = 0;
+    /// \brief number of polyline points skipped
+    size_t skipped = 0;
+
+    /// \brief throws if the file is closed or a polyline is open, since elements cannot be written then
+    void checkElement() const;
+
+    /// \brief writes one point of the open polyline
+    void writePoint(double x, double y);
+};
+
 #endif // SVG_H
\ No newline at end of file
@@ -0,0 +1,400 @@
+/// \file
+/// \brief Latency and allocation benchmarks of the SLAM estimators, circle fitting, batched transforms and fleet kinematics.
+///
+/// Every benchmark prints one JSON object per line to stdout, so results can be collected
+/// and compared between builds. Usage: bench_turtlelib [iterations]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <armadillo>
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/se2d.hpp"
+#include "turtlelib/diff_drive.hpp"
+#include "turtlelib/ekf.hpp"
+#include "turtlelib/fastslam.hpp"
+#include "turtlelib/circle_fitting.hpp"
+
+namespace
+{
+    /// \brief number of heap allocations made by the process so far. Circle fitting allocates from OpenMP threads too.
+    std::atomic<size_t> allocations{0};
+}
+
+// Armadillo takes matrix memory straight from posix_memalign or malloc, not from operator new.
+// The benchmark is linked with --wrap for every C allocation function, so the linker sends those calls here.
+extern "C"
+{
+    void * __real_malloc(std::size_t size);
+    void * __real_calloc(std::size_t count, std::size_t size);
+    void * __real_realloc(void * block, std::size_t size);
+    int __real_posix_memalign(void ** block, std::size_t alignment, std::size_t size);
+    void * __real_aligned_alloc(std::size_t alignment, std::size_t size);
+    void __real_free(void * block);
+
+    void * __wrap_malloc(std::size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return __real_malloc(size);
+    }
+
+    void * __wrap_calloc(std::size_t count, std::size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return __real_calloc(count, size);
+    }
+
+    void * __wrap_realloc(void * block, std::size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return __real_realloc(block, size);
+    }
+
+    int __wrap_posix_memalign(void ** block, std::size_t alignment, std::size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return __real_posix_memalign(block, alignment, size);
+    }
+
+    void * __wrap_aligned_alloc(std::size_t alignment, std::size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return __real_aligned_alloc(alignment, size);
+    }
+
+    void __wrap_free(void * block)
+    {
+        __real_free(block);
+    }
+}
+
+// operator new is replaced too, so allocations made inside libstdc++ reach the wrapped malloc and are counted once.
+// The replacements stay out of line. Inlined into a caller, GCC pairs the malloc in operator new
+// with the free in operator delete and reports a false -Wmismatched-new-delete.
+__attribute__((noinline)) void * operator new(std::size_t size)
+{
+    if (void * block = std::malloc(size == 0 ? 1 : size))
+    {
+        return block;
+    }
+    throw std::bad_alloc{};
+}
+
+__attribute__((noinline)) void * operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void * block) noexcept
+{
+    std::free(block);
+}
+
+__attribute__((noinline)) void operator delete[](void * block) noexcept
+{
+    std::free(block);
+}
+
+__attribute__((noinline)) void operator delete(void * block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+__attribute__((noinline)) void operator delete[](void * block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// \brief landmark counts swept by the estimator benchmarks
+    const std::vector<size_t> landmark_counts{4, 8, 16, 32, 64};
+    /// \brief cluster sizes swept by the circle fitting benchmark
+    const std::vector<size_t> cluster_sizes{8, 16, 32, 64, 128, 256};
+    /// \brief fleet sizes swept by the kinematics benchmark
+    const std::vector<size_t> fleet_sizes{1, 8, 64};
+    /// \brief robot pose of the estimator benchmarks. Off the origin, where unseen landmarks have zero range.
+    const turtlelib::Pose2D bench_pose{0.0, -0.069, 0.0};
+
+    /// \brief Timing samples of one benchmark
+    struct Samples
+    {
+        /// \brief latency of every call [ns]
+        std::vector<double> latency{};
+        /// \brief heap allocations made by all calls
+        size_t allocations = 0;
+    };
+
+    /// \brief time op over iterations calls, after a few untimed warm up calls
+    /// \param iterations - number of timed calls
+    /// \param op - called with the iteration number
+    template<class Op>
+    Samples measure(size_t iterations, Op && op)
+    {
+        for (size_t i = 0; i < std::min<size_t>(iterations, 10); i++)
+        {
+            op(i);
+        }
+
+        Samples samples{};
+        samples.latency.resize(iterations);
+        const size_t allocations_before = allocations;
+        for (size_t i = 0; i < iterations; i++)
+        {
+            const auto start = Clock::now();
+            op(i);
+            samples.latency[i] = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        }
+        samples.allocations = allocations - allocations_before;
+        return samples;
+    }
+
+    /// \brief print one JSON line with the latency statistics of a benchmark
+    /// \param name - name of the benchmark
+    /// \param parameter - name of the swept parameter
+    /// \param value - value of the swept parameter
+    /// \param samples - timing samples
+    void report(const std::string & name, const std::string & parameter, size_t value, Samples samples)
+    {
+        std::vector<double> & latency = samples.latency;
+        std::sort(latency.begin(), latency.end());
+        double total = 0.0;
+        for (const auto sample : latency)
+        {
+            total += sample;
+        }
+        const size_t count = latency.size();
+        const auto percentile = [&](double p)
+        {
+            return latency[std::min(count - 1, static_cast<size_t>(p * static_cast<double>(count)))];
+        };
+
+        std::cout << "{\"benchmark\": \"" << name << "\""
+                  << ", \"" << parameter << "\": " << value
+                  << ", \"iterations\": " << count
+                  << ", \"mean_ns\": " << total / static_cast<double>(count)
+                  << ", \"p50_ns\": " << percentile(0.5)
+                  << ", \"p99_ns\": " << percentile(0.99)
+                  << ", \"allocs_per_op\": " << static_cast<double>(samples.allocations) / static_cast<double>(count)
+                  << "}" << std::endl;
+    }
+
+    /// \brief points evenly spread on a ring around the robot, like the returns of one lidar scan
+    /// \param count - number of landmarks
+    std::vector<turtlelib::Point2D> ring_measurements(size_t count)
+    {
+        std::vector<turtlelib::Point2D> measurements{};
+        for (size_t k = 0; k < count; k++)
+        {
+            const double angle = 2.0 * turtlelib::PI * static_cast<double>(k) / static_cast<double>(count);
+            const double range = 1.0 + 0.5 * static_cast<double>(k % 3);
+            measurements.push_back(turtlelib::Point2D{range * std::cos(angle), range * std::sin(angle)});
+        }
+        return measurements;
+    }
+
+    /// \brief landmarks on rings of seven around the benchmark pose, relative to the robot.
+    /// Neighbours are 0.8 m apart in range or 0.9 rad apart in bearing, so data association tells every landmark apart.
+    /// \param count - number of landmarks
+    std::vector<turtlelib::Point2D> landmark_measurements(size_t count)
+    {
+        const size_t per_ring = 7;
+        std::vector<turtlelib::Point2D> measurements{};
+        for (size_t k = 0; k < count; k++)
+        {
+            const double ring = static_cast<double>(k / per_ring);
+            const double angle = 2.0 * turtlelib::PI * static_cast<double>(k % per_ring) / static_cast<double>(per_ring) + 0.4 * ring;
+            const double range = 1.0 + 0.8 * ring;
+            measurements.push_back(turtlelib::Point2D{range * std::cos(angle), range * std::sin(angle)});
+        }
+        return measurements;
+    }
+
+    /// \brief true if every measurement associates with landmark k + 1 of the filter.
+    /// Association then starts no new landmark, so repeated calls all see the same state.
+    /// \param filter - filter to check, left unchanged
+    /// \param measurements - one measurement per mapped landmark, in landmark order
+    bool associates_with_map(const turtlelib::EKFSlam & filter, const std::vector<turtlelib::Point2D> & measurements)
+    {
+        turtlelib::EKFSlam probe = filter;
+        const std::vector<size_t> indices = probe.associate_indices(measurements);
+        for (size_t k = 0; k < indices.size(); k++)
+        {
+            if (indices[k] != k + 1)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// \brief an EKF that has mapped count landmarks, seeded like the slam node: associate, then correct
+    /// \param count - number of landmarks
+    turtlelib::EKFSlam mapped_ekf(size_t count)
+    {
+        turtlelib::EKFSlam filter{bench_pose};
+        for (const auto & measurement : landmark_measurements(count))
+        {
+            const size_t j = filter.associate_index(measurement);
+            if (j != 0)
+            {
+                filter.correct(measurement.x, measurement.y, j);
+            }
+        }
+        return filter;
+    }
+
+    /// \brief a particle filter that has mapped count landmarks
+    /// \param count - number of landmarks
+    turtlelib::FastSlam mapped_fastslam(size_t count)
+    {
+        turtlelib::FastSlam filter{bench_pose};
+        const std::vector<turtlelib::Point2D> measurements = landmark_measurements(count);
+        for (size_t j = 1; j <= count; j++)
+        {
+            filter.correct(measurements[j - 1].x, measurements[j - 1].y, j);
+        }
+        return filter;
+    }
+
+    /// \brief noisy points on an arc of a circle of radius 0.038 at (1, 0.5), like a lidar return of an obstacle
+    /// \param count - number of points
+    std::vector<turtlelib::Point2D> arc_cluster(size_t count)
+    {
+        std::mt19937 generator{0};
+        std::normal_distribution<double> noise{0.0, 0.002};
+        std::vector<turtlelib::Point2D> cluster{};
+        for (size_t k = 0; k < count; k++)
+        {
+            const double angle = turtlelib::PI * (0.5 + static_cast<double>(k) / static_cast<double>(count));
+            cluster.push_back(turtlelib::Point2D{1.0 + 0.038 * std::cos(angle) + noise(generator),
+                                                 0.5 + 0.038 * std::sin(angle) + noise(generator)});
+        }
+        return cluster;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    const size_t iterations = argc > 1 ? static_cast<size_t>(std::stoul(argv[1])) : 1000;
+    if (iterations == 0)
+    {
+        std::cerr << "Need at least one iteration" << std::endl;
+        return 1;
+    }
+
+    const turtlelib::Twist2D twist{0.01, 0.002, 0.0};
+
+    for (const auto count : landmark_counts)
+    {
+        const std::vector<turtlelib::Point2D> measurements = landmark_measurements(count);
+        // Every timed association call has to see the same map of count landmarks
+        const turtlelib::EKFSlam mapped = mapped_ekf(count);
+        if (mapped.num_seen_landmarks() != count || !associates_with_map(mapped, measurements))
+        {
+            std::cerr << "Data association does not recover the " << count << " mapped landmarks" << std::endl;
+            return 1;
+        }
+
+        turtlelib::EKFSlam predict_filter = mapped;
+        report("ekf_predict", "landmarks", count, measure(iterations, [&](size_t)
+        {
+            predict_filter.predict(twist);
+        }));
+
+        turtlelib::EKFSlam correct_filter = mapped;
+        report("ekf_correct", "landmarks", count, measure(iterations, [&](size_t i)
+        {
+            const size_t j = i % count + 1;
+            correct_filter.correct(measurements[j - 1].x, measurements[j - 1].y, j);
+        }));
+
+        turtlelib::EKFSlam batch_filter = mapped;
+        std::vector<size_t> indices(count);
+        for (size_t j = 1; j <= count; j++)
+        {
+            indices[j - 1] = j;
+        }
+        report("ekf_correct_batch", "landmarks", count, measure(iterations, [&](size_t)
+        {
+            batch_filter.correct_batch(measurements, indices);
+        }));
+
+        turtlelib::EKFSlam associate_filter = mapped;
+        report("ekf_associate_index", "landmarks", count, measure(iterations, [&](size_t i)
+        {
+            associate_filter.associate_index(measurements[i % count]);
+        }));
+
+        turtlelib::EKFSlam associate_batch_filter = mapped;
+        report("ekf_associate_indices", "landmarks", count, measure(iterations, [&](size_t)
+        {
+            associate_batch_filter.associate_indices(measurements);
+        }));
+
+        turtlelib::FastSlam particle_filter = mapped_fastslam(count);
+        report("fastslam_correct", "landmarks", count, measure(iterations, [&](size_t i)
+        {
+            const size_t j = i % count + 1;
+            particle_filter.correct(measurements[j - 1].x, measurements[j - 1].y, j);
+        }));
+    }
+
+    for (const auto size : cluster_sizes)
+    {
+        const std::vector<turtlelib::Point2D> cluster = arc_cluster(size);
+        double sink = 0.0;
+        report("circle_fitting", "cluster_size", size, measure(iterations, [&](size_t)
+        {
+            sink += turtlelib::circle_fitting(cluster).R;
+        }));
+        if (std::isnan(sink))
+        {
+            std::cerr << "circle_fitting gave NaN for " << size << " points" << std::endl;
+        }
+    }
+
+    const size_t beams = 360;
+    const std::vector<turtlelib::Point2D> scan = ring_measurements(beams);
+    std::vector<double> scan_x(beams), scan_y(beams), world_x(beams), world_y(beams);
+    for (size_t k = 0; k < beams; k++)
+    {
+        scan_x[k] = scan[k].x;
+        scan_y[k] = scan[k].y;
+    }
+    const turtlelib::Transform2D T_world_scan{turtlelib::Vector2D{1.0, -0.5}, 0.3};
+    report("transform_apply", "points", beams, measure(iterations, [&](size_t)
+    {
+        T_world_scan.apply(scan_x.data(), scan_y.data(), world_x.data(), world_y.data(), beams);
+    }));
+
+    const std::vector<float> scan_x_f(scan_x.begin(), scan_x.end()), scan_y_f(scan_y.begin(), scan_y.end());
+    std::vector<float> world_x_f(beams), world_y_f(beams);
+    const turtlelib::Transform2F T_world_scan_f{turtlelib::Vector2F{1.0f, -0.5f}, 0.3f};
+    report("transform_apply_float", "points", beams, measure(iterations, [&](size_t)
+    {
+        T_world_scan_f.apply(scan_x_f.data(), scan_y_f.data(), world_x_f.data(), world_y_f.data(), beams);
+    }));
+
+    for (const auto robots : fleet_sizes)
+    {
+        turtlelib::DiffDriveFleet fleet{0.033, 0.16, robots};
+        const std::vector<double> delta_left(robots, 0.1), delta_right(robots, 0.12);
+        std::vector<double> omega(robots), x_dot(robots);
+        report("fleet_drive_wheels", "robots", robots, measure(iterations, [&](size_t)
+        {
+            fleet.driveWheels(delta_left.data(), delta_right.data(), omega.data(), x_dot.data());
+        }));
+    }
+
+    return 0;
+}
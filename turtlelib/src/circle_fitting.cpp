@@ -1,122 +1,371 @@
-#include <iostream>
-#include <armadillo>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 #include "turtlelib/circle_fitting.hpp"
 #include "turtlelib/geometry2d.hpp"
 
 namespace turtlelib
 {
+    namespace
+    {
+        /// \brief Eigen decomposition of a symmetric 4 x 4 matrix with cyclic Jacobi rotations
+        /// \param S - symmetric matrix, diagonalized in place
+        /// \param V - output, eigenvectors in the columns, in the order of the diagonal of S
+        void symmetric_eigen(double S[4][4], double V[4][4])
+        {
+            for (int r = 0; r < 4; r++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    V[r][c] = r == c ? 1.0 : 0.0;
+                }
+            }
+
+            for (int sweep = 0; sweep < 50; sweep++)
+            {
+                double off_diagonal = 0.0;
+                double diagonal = 0.0;
+                for (int r = 0; r < 4; r++)
+                {
+                    diagonal += S[r][r] * S[r][r];
+                    for (int c = r + 1; c < 4; c++)
+                    {
+                        off_diagonal += S[r][c] * S[r][c];
+                    }
+                }
+                if (off_diagonal <= 1e-30 * diagonal || off_diagonal == 0.0)
+                {
+                    return;
+                }
 
-    Circle circle_fitting(std::vector<turtlelib::Point2D> cluster)
+                for (int p = 0; p < 3; p++)
+                {
+                    for (int q = p + 1; q < 4; q++)
+                    {
+                        if (S[p][q] == 0.0)
+                        {
+                            continue;
+                        }
+
+                        // Rotation that zeroes S[p][q]
+                        const double theta = (S[q][q] - S[p][p]) / (2.0 * S[p][q]);
+                        const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                        const double c = 1.0 / std::sqrt(t * t + 1.0);
+                        const double s = t * c;
+
+                        for (int k = 0; k < 4; k++)
+                        {
+                            const double s_kp = S[k][p];
+                            const double s_kq = S[k][q];
+                            S[k][p] = c * s_kp - s * s_kq;
+                            S[k][q] = s * s_kp + c * s_kq;
+                        }
+                        for (int k = 0; k < 4; k++)
+                        {
+                            const double s_pk = S[p][k];
+                            const double s_qk = S[q][k];
+                            S[p][k] = c * s_pk - s * s_qk;
+                            S[q][k] = s * s_pk + c * s_qk;
+                        }
+                        for (int k = 0; k < 4; k++)
+                        {
+                            const double v_kp = V[k][p];
+                            const double v_kq = V[k][q];
+                            V[k][p] = c * v_kp - s * v_kq;
+                            V[k][q] = s * v_kp + c * v_kq;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    Circle circle_fitting(const Point2D * points, size_t count)
     {
+        if (count < 3)
+        {
+            throw std::runtime_error("Circle fitting needs at least 3 points!");
+        }
+
         // 1. Find the mean of the x and y coordinates: 
         double centroid_x = 0.0;
         double centroid_y = 0.0;
-        double cluster_size = static_cast<double>(cluster.size());
+        const double cluster_size = static_cast<double>(count);
 
-        for (size_t i = 0; i < cluster.size(); i++)
+#ifdef _OPENMP
+        #pragma omp simd reduction(+:centroid_x, centroid_y)
+#endif
+        for (size_t i = 0; i < count; i++)
         {
-            centroid_x += cluster.at(i).x;
-            centroid_y += cluster.at(i).y;
+            centroid_x += points[i].x;
+            centroid_y += points[i].y;
         }
 
         centroid_x /= cluster_size; // eq...(1)
         centroid_y /= cluster_size; // eq...(2)
 
-        double xc_i = 0.0;
-        double yc_i = 0.0;
-        double zc_i = 0.0;
-        double z_mean = 0.0;
-        arma::mat Z{};
-
-        for (size_t i = 0; i < cluster.size(); i++)
+        // 2-6. Shift the coordinates so that the centroid is at the origin, compute z_i,
+        // and accumulate Z^T Z for the rows [z_i x_i y_i 1] of the data matrix Z, without forming Z.
+        // Every entry is its own sum, so the loop vectorizes.
+        double sum_zz = 0.0;
+        double sum_zx = 0.0;
+        double sum_zy = 0.0;
+        double sum_z = 0.0;
+        double sum_xx = 0.0;
+        double sum_xy = 0.0;
+        double sum_yy = 0.0;
+        double sum_x = 0.0;
+        double sum_y = 0.0;
+#ifdef _OPENMP
+        #pragma omp simd reduction(+:sum_zz, sum_zx, sum_zy, sum_z, sum_xx, sum_xy, sum_yy, sum_x, sum_y)
+#endif
+        for (size_t i = 0; i < count; i++)
         {
-            // 2. Shift the coordinates so that the centroid is at the origin:
-            
-            xc_i = cluster.at(i).x - centroid_x;          // eq...(3)
-            yc_i = cluster.at(i).y - centroid_y;          // eq...(4)
+            const double xc_i = points[i].x - centroid_x;   // eq...(3)
+            const double yc_i = points[i].y - centroid_y;   // eq...(4)
+            const double zc_i = xc_i*xc_i + yc_i*yc_i;
 
-            // 3. Compute z_i
-
-            zc_i = xc_i*xc_i + yc_i*yc_i;                         
-
-            // 4. Compute mean of z
-            z_mean += zc_i;
-
-            // 5. Form the data matrix from the n data points
-            Z.insert_rows(i,arma::rowvec{zc_i, xc_i, yc_i, 1}); // eq...(6)
+            sum_zz += zc_i * zc_i;
+            sum_zx += zc_i * xc_i;
+            sum_zy += zc_i * yc_i;
+            sum_z += zc_i;
+            sum_xx += xc_i * xc_i;
+            sum_xy += xc_i * yc_i;
+            sum_yy += yc_i * yc_i;
+            sum_x += xc_i;
+            sum_y += yc_i;
         }
 
-        z_mean /= cluster_size;
+        double ZtZ[4][4] = {
+            {sum_zz, sum_zx, sum_zy, sum_z},
+            {sum_zx, sum_xx, sum_xy, sum_x},
+            {sum_zy, sum_xy, sum_yy, sum_y},
+            {sum_z, sum_x, sum_y, cluster_size}}; // eq...(6)
 
-        // 6. Form the Moment Matrix
-        arma::mat M = (1/cluster_size)*Z.t()*Z;
+        const double z_mean = sum_z / cluster_size;
 
-        // 7,8. Form the constraint matrix for the "Hyperaccurate algebraic fit"
-        arma::mat H(4, 4, arma::fill::zeros);
-        H(0,0) = 8.0*z_mean;    // eq...(7)
-        H(3,0) = 2.0;
-        H(0,3) = 2.0;
-        H(1,1) = 1.0;
-        H(2,2) = 1.0;
+        // 7,8. Inverse of the constraint matrix H of the "Hyperaccurate algebraic fit", whose only non-zero
+        // entries are H(0,0) = 8 z_mean, H(0,3) = H(3,0) = 2 and H(1,1) = H(2,2) = 1
+        double H_inv[4][4] = {};
+        H_inv[0][3] = 0.5;
+        H_inv[3][0] = 0.5;
+        H_inv[3][3] = -2.0*z_mean;
+        H_inv[1][1] = 1.0;
+        H_inv[2][2] = 1.0;
 
-        // 9. Compute the Singular Value Decomposition of Z = U Σ V^T
-        arma::mat U{};
-        arma::vec sigma{};
-        arma::mat V{};
-        arma::svd(U, sigma, V, Z);    // eq...(9)
+        // 9. Z = U Σ V^T, so Z^T Z = V Σ² V^T, and the singular values of Z are the roots of its eigenvalues
+        double V[4][4];
+        symmetric_eigen(ZtZ, V);
+        double sigma[4];
+        int smallest = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            sigma[k] = std::sqrt(std::max(ZtZ[k][k], 0.0));
+            if (sigma[k] < sigma[smallest])
+            {
+                smallest = k;
+            }
+        }
 
-        // 10. If the smallest singular value σ4 is less than 1e−12, then Let A be the the 4th column of the V matrix
-        arma::colvec A{};
-        if (sigma(3) < 10e-12)
+        // 10. If the smallest singular value σ4 is less than 1e−12, then Let A be its right singular vector
+        double A[4];
+        if (sigma[smallest] < 10e-12)
         {
-            A = V.col(3);
+            for (int r = 0; r < 4; r++)
+            {
+                A[r] = V[r][smallest];
+            }
         }
         // 11. If σ4 > 1e−12  then let Y = V Σ V^T
         else
         {
-            arma::mat Y = V*arma::diagmat(sigma)*trans(V);    // eq...(10)
-
-            // Then find the eigenvalues and vectors of Q = Y H^−1 Y
-            arma::mat Q = Y*H.i()*Y;
-
-            arma::cx_vec eigval{};
-            arma::cx_mat eigvec{};
-            arma::eig_gen(eigval, eigvec, Q);
+            double Y[4][4] = {};
+            for (int r = 0; r < 4; r++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    for (int k = 0; k < 4; k++)
+                    {
+                        Y[r][c] += V[r][k] * sigma[k] * V[c][k];    // eq...(10)
+                    }
+                }
+            }
 
-            arma::mat real_eigval = arma::real(eigval); // Select real eigenvalues.
-            arma::mat real_eigvec = arma::real(eigvec); // and eigenvectors
+            // Then find the eigenvalues and vectors of Q = Y H^−1 Y, which is symmetric
+            double YH_inv[4][4] = {};
+            for (int r = 0; r < 4; r++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    for (int k = 0; k < 4; k++)
+                    {
+                        YH_inv[r][c] += Y[r][k] * H_inv[k][c];
+                    }
+                }
+            }
+            double Q[4][4] = {};
+            for (int r = 0; r < 4; r++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    for (int k = 0; k < 4; k++)
+                    {
+                        Q[r][c] += YH_inv[r][k] * Y[k][c];
+                    }
+                }
+            }
+            double Q_vec[4][4];
+            symmetric_eigen(Q, Q_vec);
 
             // Let A∗ be the eigenvector corresponding to the smallest positive eigenvalue of Q
             double min = 1e6;
-            size_t min_index = 0;
-            // if(arma::any(real_eigval > min)) 
-            // {
-            //     throw std::runtime_error("Eigenvalues are too large!");
-            // }
-
-            for (size_t i = 0; i < real_eigval.size(); i++)
+            int min_index = 0;
+            for (int k = 0; k < 4; k++)
             {
-                if (real_eigval(i) < min && real_eigval(i) > 0.0) // Find the smallest positive eigval
+                if (Q[k][k] < min && Q[k][k] > 0.0) // Find the smallest positive eigval
                 {
-                    min = real_eigval(i);
-                    min_index = i;
+                    min = Q[k][k];
+                    min_index = k;
                 }
             }
-            arma::vec A_star = real_eigvec.col(min_index); // Extract eigvec that corresponds with the eigen value
 
-            // Solve Y A = A∗ for A
-            A = Y.i()*A_star;
+            // Solve Y A = A∗ for A, with Y^-1 = V Σ^-1 V^T
+            for (int r = 0; r < 4; r++)
+            {
+                A[r] = 0.0;
+                for (int k = 0; k < 4; k++)
+                {
+                    double projection = 0.0;
+                    for (int c = 0; c < 4; c++)
+                    {
+                        projection += V[c][k] * Q_vec[c][min_index];
+                    }
+                    A[r] += V[r][k] * projection / sigma[k];
+                }
+            }
         }
 
         // 12. Once we have A then the equation for the circle is
-        double a = -A(1)/(2.0*A(0));    // eq...(12)
-        double b = -A(2)/(2.0*A(0));    // eq...(13)
-        double R = std::sqrt((A(1)*A(1) + A(2)*A(2) - 4.0*A(0)*A(3)) / (4.0*A(0)*A(0))); // eq...(14)
+        const double a = -A[1]/(2.0*A[0]);    // eq...(12)
+        const double b = -A[2]/(2.0*A[0]);    // eq...(13)
+        const double R = std::sqrt((A[1]*A[1] + A[2]*A[2] - 4.0*A[0]*A[3]) / (4.0*A[0]*A[0])); // eq...(14)
 
         // 13. We shifted the coordinate system, so the actual center is at
-        double cx = a + centroid_x;
-        double cy = b + centroid_y;
+        const double cx = a + centroid_x;
+        const double cy = b + centroid_y;
 
     return {cx, cy, R};
     }
-}
\ No newline at end of file
+
+    Circle circle_fitting(const std::vector<Point2D> & cluster)
+    {
+        return circle_fitting(cluster.data(), cluster.size());
+    }
+
+    ClusterReject classify_cluster(const Point2D * points, size_t count, const ClusterLimits & limits)
+    {
+        if (count < 3)
+        {
+            return ClusterReject::too_few_points;
+        }
+
+        // A cluster spans at most the diameter of the largest circle
+        const Point2D & first = points[0];
+        const Point2D & last = points[count - 1];
+        const double chord = magnitude(last - first);
+        if (chord > 2.0 * limits.max_radius)
+        {
+            return ClusterReject::too_wide;
+        }
+
+        // Mean and variance of the angle under which each inner point sees the end points
+        double sum = 0.0;
+        double sum_squares = 0.0;
+        double polyline = magnitude(points[1] - first);
+        for (size_t i = 1; i + 1 < count; i++)
+        {
+            const Vector2D to_first = first - points[i];
+            const Vector2D to_last = last - points[i];
+            const double angle = std::abs(std::atan2(to_first.x * to_last.y - to_first.y * to_last.x, dot(to_first, to_last)));
+            sum += angle;
+            sum_squares += angle * angle;
+            polyline += magnitude(points[i + 1] - points[i]);
+        }
+        const double inner = static_cast<double>(count - 2);
+        const double mean = sum / inner;
+        const double deviation = std::sqrt(std::max(sum_squares / inner - mean * mean, 0.0));
+
+        if (mean < limits.min_mean_angle || mean > limits.max_mean_angle)
+        {
+            return ClusterReject::angle_out_of_range;
+        }
+        if (deviation > limits.max_angle_deviation)
+        {
+            return ClusterReject::angle_spread;
+        }
+
+        // The inscribed angle θ fixes the arc over the chord. Its central angle is 2(π − θ) and its radius chord / (2 sin(π − θ)).
+        const double half_central = PI - mean;
+        const double radius = chord / (2.0 * std::sin(half_central));
+        const double arc = 2.0 * half_central * radius;
+        if (radius > limits.max_radius || polyline > limits.max_arc_ratio * arc)
+        {
+            return ClusterReject::arc_mismatch;
+        }
+
+        return ClusterReject::none;
+    }
+
+    const char * to_string(ClusterReject reason)
+    {
+        switch (reason)
+        {
+            case ClusterReject::none:
+                return "none";
+            case ClusterReject::too_few_points:
+                return "too_few_points";
+            case ClusterReject::too_wide:
+                return "too_wide";
+            case ClusterReject::angle_out_of_range:
+                return "angle_out_of_range";
+            case ClusterReject::angle_spread:
+                return "angle_spread";
+            case ClusterReject::arc_mismatch:
+                return "arc_mismatch";
+        }
+        return "unknown";
+    }
+
+    void circle_fitting_batch(const Point2D * points, const size_t * offsets, size_t num_clusters, Circle * circles)
+    {
+        // Check every cluster first, so that no fit throws inside the parallel loop
+        for (size_t k = 0; k < num_clusters; k++)
+        {
+            if (offsets[k + 1] < offsets[k] + 3)
+            {
+                throw std::runtime_error("Circle fitting needs at least 3 points per cluster!");
+            }
+        }
+
+        const long long clusters = static_cast<long long>(num_clusters);
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 4) if(num_clusters >= parallel_fit_clusters)
+#endif
+        for (long long k = 0; k < clusters; k++)
+        {
+            circles[k] = circle_fitting(points + offsets[k], offsets[k + 1] - offsets[k]);
+        }
+    }
+
+    std::vector<Circle> circle_fitting_batch(const std::vector<Point2D> & points, const std::vector<size_t> & offsets)
+    {
+        if (offsets.empty() || offsets.back() > points.size())
+        {
+            throw std::runtime_error("Cluster offsets do not match the points!");
+        }
+
+        std::vector<Circle> circles(offsets.size() - 1);
+        circle_fitting_batch(points.data(), offsets.data(), circles.size(), circles.data());
+        return circles;
+    }
+}
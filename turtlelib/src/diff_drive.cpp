@@ -7,6 +7,47 @@
 
 namespace turtlelib
 {
+    namespace
+    {
+        /// \brief radius of curvature above which integrate_twist treats a twist as a pure translation [m]
+        constexpr double max_arc_radius = 30.0;
+
+        /// \brief wrap an angle to (-PI, PI] like normalize_angle, with an exact remainder instead of atan2, sin and cos
+        double wrap_angle(double rad)
+        {
+            const double wrapped = std::remainder(rad, 2.0 * PI);
+            return almost_equal(wrapped, -PI) ? PI : wrapped;
+        }
+
+        /// \brief Drive a pose along the body twist (omega, v, 0) for one time unit. The closed form of
+        /// T_wb * integrate_twist(V_b), with the same pure translation cases.
+        /// \param omega - angular velocity of the body twist
+        /// \param v - linear velocity of the body twist
+        /// \param theta [in/out] - heading in the world frame
+        /// \param x [in/out] - x position in the world frame
+        /// \param y [in/out] - y position in the world frame
+        void drive_pose(double omega, double v, double & theta, double & x, double & y)
+        {
+            // Displacement in the body frame, along an arc of radius v / omega
+            double dx = v;
+            double dy = 0.0;
+            double dtheta = 0.0;
+            if (!almost_equal(omega, 0.0) && !(std::abs(v) / omega > max_arc_radius))
+            {
+                const double rho = v / omega;
+                dx = rho * std::sin(omega);
+                dy = rho * (1.0 - std::cos(omega));
+                dtheta = omega;
+            }
+
+            const double c = std::cos(theta);
+            const double s = std::sin(theta);
+            x += c * dx - s * dy;
+            y += s * dx + c * dy;
+            theta = wrap_angle(theta + dtheta);
+        }
+    }
+
     // CONSTRUCTORS.
 
     // Create a new Diff Drive.
@@ -100,6 +141,146 @@ namespace turtlelib
         return q;
     }
 
+    // FLEET OF DIFF DRIVES.
+
+    // Create an empty fleet.
+    DiffDriveFleet::DiffDriveFleet(double radius, double sep) :
+    wheel_radius{radius}, wheel_sep{sep}
+    {}
+
+    // Create a fleet at the origin.
+    DiffDriveFleet::DiffDriveFleet(double radius, double sep, size_t num_robots) :
+    wheel_radius{radius}, wheel_sep{sep},
+    phi_left(num_robots, 0.0), phi_right(num_robots, 0.0), theta(num_robots, 0.0), x(num_robots, 0.0), y(num_robots, 0.0)
+    {}
+
+    // Add a robot.
+    size_t DiffDriveFleet::add(wheelAngles wheels, Pose2D pose)
+    {
+        phi_left.push_back(normalize_angle(wheels.left));
+        phi_right.push_back(normalize_angle(wheels.right));
+        theta.push_back(normalize_angle(pose.theta));
+        x.push_back(pose.x);
+        y.push_back(pose.y);
+        return theta.size() - 1;
+    }
+
+    // Drive every robot forward through the wheels (compute forward velocity kinematics)
+    void DiffDriveFleet::driveWheels(const double * delta_left, const double * delta_right, double * omega, double * x_dot)
+    {
+        const size_t num_robots = size();
+        const double omega_per_rad = wheel_radius / wheel_sep;
+        const double x_dot_per_rad = wheel_radius / 2;
+
+        for (size_t i = 0; i < num_robots; i++)
+        {
+            const double w = omega_per_rad * (delta_right[i] - delta_left[i]);
+            const double v = x_dot_per_rad * (delta_right[i] + delta_left[i]);
+            drive_pose(w, v, theta[i], x[i], y[i]);
+            if (omega)
+            {
+                omega[i] = w;
+            }
+            if (x_dot)
+            {
+                x_dot[i] = v;
+            }
+        }
+
+        for (size_t i = 0; i < num_robots; i++)
+        {
+            phi_left[i] = wrap_angle(phi_left[i] + delta_left[i]);
+            phi_right[i] = wrap_angle(phi_right[i] + delta_right[i]);
+        }
+    }
+
+    // Drive one robot forward through the wheels
+    Twist2D DiffDriveFleet::driveWheels(size_t i, wheelAngles delta_phi)
+    {
+        Twist2D V_b;
+        V_b.omega = (wheel_radius / wheel_sep) * (delta_phi.right - delta_phi.left);
+        V_b.x = (wheel_radius / 2) * (delta_phi.right + delta_phi.left);
+        V_b.y = 0;
+
+        drive_pose(V_b.omega, V_b.x, theta.at(i), x.at(i), y.at(i));
+        phi_left.at(i) = wrap_angle(phi_left.at(i) + delta_phi.left);
+        phi_right.at(i) = wrap_angle(phi_right.at(i) + delta_phi.right);
+
+        return V_b;
+    }
+
+    // Predict the pose of one robot
+    Pose2D DiffDriveFleet::predictPose(size_t i, wheelAngles delta_phi) const
+    {
+        Pose2D q = pose(i);
+        drive_pose((wheel_radius / wheel_sep) * (delta_phi.right - delta_phi.left),
+                   (wheel_radius / 2) * (delta_phi.right + delta_phi.left),
+                   q.theta, q.x, q.y);
+        return q;
+    }
+
+    // Wheel increments of every robot from body twists (compute inverse velocity kinematics)
+    void DiffDriveFleet::TwistToWheels(const double * omega, const double * x_dot, double * delta_left, double * delta_right) const
+    {
+        const size_t num_robots = size();
+        const double half_sep = wheel_sep / 2;
+
+        for (size_t i = 0; i < num_robots; i++)
+        {
+            delta_left[i] = (1 / wheel_radius) * (x_dot[i] - half_sep * omega[i]);
+            delta_right[i] = (1 / wheel_radius) * (x_dot[i] + half_sep * omega[i]);
+        }
+    }
+
+    // SETTERS.
+
+    // Set pose of one robot
+    void DiffDriveFleet::setPose(size_t i, Pose2D pose)
+    {
+        theta.at(i) = normalize_angle(pose.theta);
+        x.at(i) = pose.x;
+        y.at(i) = pose.y;
+    }
+
+    // Set wheel angles of one robot
+    void DiffDriveFleet::setWheels(size_t i, wheelAngles wheels)
+    {
+        phi_left.at(i) = normalize_angle(wheels.left);
+        phi_right.at(i) = normalize_angle(wheels.right);
+    }
+
+    // GETTERS.
+
+    // Get number of robots
+    size_t DiffDriveFleet::size() const
+    {
+        return theta.size();
+    }
+
+    // Get wheel radius
+    double DiffDriveFleet::radius() const
+    {
+        return wheel_radius;
+    }
+
+    // Get wheel separation
+    double DiffDriveFleet::separation() const
+    {
+        return wheel_sep;
+    }
+
+    // Get wheel angles of one robot
+    wheelAngles DiffDriveFleet::wheels(size_t i) const
+    {
+        return wheelAngles{phi_left.at(i), phi_right.at(i)};
+    }
+
+    // Get pose of one robot
+    Pose2D DiffDriveFleet::pose(size_t i) const
+    {
+        return Pose2D{theta.at(i), x.at(i), y.at(i)};
+    }
+
     // // Create a pure translation transform.
     // DiffDrive::DiffDrive(double left_wheel_angle, double right_wheel_angle, Pose2D pose) :
     // phi_l{left_wheel_angle}, phi_r{right_wheel_angle}, q{pose}
@@ -1,4 +1,8 @@
 #include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
 #include <armadillo>
 #include "turtlelib/se2d.hpp"
 #include "turtlelib/geometry2d.hpp"
@@ -24,15 +28,179 @@ namespace turtlelib
     void EKFSlam::initialize_covariance()
     {
         arma::mat sigma_0_q = arma::zeros<arma::mat>(num_dof, num_dof); // We are absolutely sure about the initial pose
-        arma::mat sigma_0_m = arma::eye(2 * num_landmarks, 2 * num_landmarks) * 1e6; // Uncertainity in sensing, very high with no knowledge of obstacles
-        arma::mat zeros_12 = arma::zeros<arma::mat>(num_dof, 2*num_landmarks); // Zeros due to sensing and localization noise being independent
-        arma::mat zeros_21 = arma::zeros<arma::mat>(2*num_landmarks, num_dof); // Zeros due to sensing and localization noise being independent
+        arma::mat sigma_0_m = arma::eye(2 * capacity, 2 * capacity) * 1e6; // Uncertainity in sensing, very high with no knowledge of obstacles
+        arma::mat zeros_12 = arma::zeros<arma::mat>(num_dof, 2*capacity); // Zeros due to sensing and localization noise being independent
+        arma::mat zeros_21 = arma::zeros<arma::mat>(2*capacity, num_dof); // Zeros due to sensing and localization noise being independent
         sigma =
             arma::join_vert(
             arma::join_horiz(sigma_0_q, zeros_12), 
             arma::join_horiz(zeros_21, sigma_0_m));
     }
 
+    arma::uword EKFSlam::dim() const
+    {
+        return num_dof + 2 * n;
+    }
+
+    void EKFSlam::reserve_landmarks(size_t count)
+    {
+        if (count <= capacity)
+        {
+            return;
+        }
+
+        // Double the capacity, so that adding landmarks one by one reallocates only log(n) times
+        const size_t new_capacity = std::max(count, 2 * capacity);
+        const arma::uword old_size = num_dof + 2 * capacity;
+        const arma::uword new_size = num_dof + 2 * new_capacity;
+
+        // New slots start with the prior: unknown landmark, uncorrelated with everything else
+        arma::mat new_sigma{new_size, new_size, arma::fill::zeros};
+        new_sigma.diag().fill(1e6);
+        new_sigma.submat(0, 0, old_size - 1, old_size - 1) = sigma;
+        sigma = std::move(new_sigma);
+
+        arma::mat new_A{new_size, new_size, arma::fill::eye};
+        new_A.submat(0, 0, old_size - 1, old_size - 1) = A;
+        A = std::move(new_A);
+
+        // resize keeps the existing elements and zero fills the rest
+        Xi.resize(new_size);
+        m.resize(2 * new_capacity);
+        sigma_Ht_i.set_size(new_size, 2);
+
+        capacity = new_capacity;
+    }
+
+    void EKFSlam::activate_landmarks(size_t count)
+    {
+        reserve_landmarks(count);
+        n = std::max(n, count);
+    }
+
+    void EKFSlam::set_submap_radius(double radius)
+    {
+        if (radius < 0.0)
+        {
+            throw std::runtime_error("Submap radius must not be negative!");
+        }
+        submap_radius = radius;
+        if (submap_radius <= 0.0)
+        {
+            return;
+        }
+
+        // Unused slots after the last landmark leave the active state, they only hold the prior
+        while (n > 0 && (n > slot_landmark.size() || slot_landmark.at(n-1) == 0))
+        {
+            n--;
+        }
+        freeze_far_landmarks();
+    }
+
+    size_t EKFSlam::landmark_to_slot(size_t j)
+    {
+        if (landmark_slot.size() < j)
+        {
+            landmark_slot.resize(j, 0);
+        }
+        if (landmark_slot.at(j-1) != 0)
+        {
+            return landmark_slot.at(j-1);
+        }
+
+        // Without submaps landmark j always lives in slot j. With submaps the active slots are kept packed.
+        const size_t slot = (submap_radius > 0.0) ? n + 1 : j;
+        activate_landmarks(slot);
+        if (slot_landmark.size() < slot)
+        {
+            slot_landmark.resize(slot, 0);
+        }
+        slot_landmark.at(slot-1) = j;
+        landmark_slot.at(j-1) = slot;
+
+        // A frozen landmark rejoins with its marginal, uncorrelated with the rest of the state
+        const auto frozen = frozen_landmarks.find(j);
+        if (frozen != frozen_landmarks.end())
+        {
+            const arma::uword c = num_dof + 2 * (slot-1);
+            m(2 * (slot-1)) = frozen->second.x;
+            m(2 * (slot-1) + 1) = frozen->second.y;
+            Xi(c) = frozen->second.x;
+            Xi(c + 1) = frozen->second.y;
+            sigma(c, c) = frozen->second.sigma_xx;
+            sigma(c, c + 1) = frozen->second.sigma_xy;
+            sigma(c + 1, c) = frozen->second.sigma_xy;
+            sigma(c + 1, c + 1) = frozen->second.sigma_yy;
+            frozen_landmarks.erase(frozen);
+        }
+
+        return slot;
+    }
+
+    void EKFSlam::freeze_far_landmarks()
+    {
+        if (submap_radius <= 0.0)
+        {
+            return;
+        }
+
+        size_t slot = 1;
+        while (slot <= n)
+        {
+            const size_t j = (slot <= slot_landmark.size()) ? slot_landmark.at(slot-1) : 0;
+            const arma::uword c = num_dof + 2 * (slot-1);
+            if (j == 0 || magnitude(Vector2D{m(2 * (slot-1)) - q(1), m(2 * (slot-1) + 1) - q(2)}) <= submap_radius)
+            {
+                slot++;
+                continue;
+            }
+
+            // Keep the landmark's mean and marginal covariance, and drop its correlations
+            frozen_landmarks[j] = FrozenLandmark{m(2 * (slot-1)), m(2 * (slot-1) + 1), sigma(c, c), sigma(c, c + 1), sigma(c + 1, c + 1)};
+            landmark_slot.at(j-1) = 0;
+
+            // Move the last active slot into the freed one, so the active state stays packed. O(capacity)
+            const size_t last = n;
+            const arma::uword c_last = num_dof + 2 * (last-1);
+            if (last != slot)
+            {
+                for (arma::uword k = 0; k < 2; k++)
+                {
+                    sigma.swap_rows(c + k, c_last + k);
+                    sigma.swap_cols(c + k, c_last + k);
+                    std::swap(Xi(c + k), Xi(c_last + k));
+                    std::swap(m(2 * (slot-1) + k), m(2 * (last-1) + k));
+                }
+                const size_t j_last = (last <= slot_landmark.size()) ? slot_landmark.at(last-1) : 0;
+                slot_landmark.at(slot-1) = j_last;
+                if (j_last != 0)
+                {
+                    landmark_slot.at(j_last-1) = slot;
+                }
+            }
+            else
+            {
+                slot_landmark.at(slot-1) = 0;
+            }
+            if (last <= slot_landmark.size())
+            {
+                slot_landmark.at(last-1) = 0;
+            }
+
+            // The last slot goes back to the prior of an unseen landmark
+            for (arma::uword k = 0; k < 2; k++)
+            {
+                sigma.row(c_last + k).zeros();
+                sigma.col(c_last + k).zeros();
+                sigma(c_last + k, c_last + k) = 1e6;
+                Xi(c_last + k) = 0.0;
+                m(2 * (last-1) + k) = 0.0;
+            }
+            n--;
+        }
+    }
+
     void EKFSlam::initialize_pose(Pose2D turtle_pose_0)
     {
         q(0) = turtle_pose_0.theta;
@@ -50,7 +218,7 @@ namespace turtlelib
             Xi(pose_index) = q(pose_index);
         }
         // Populate with map vector
-        for (int landmark_index = 0; landmark_index < num_landmarks; landmark_index++)
+        for (size_t landmark_index = 0; landmark_index < n; landmark_index++)
         {
             Xi(num_dof + 2*landmark_index) = m(2*landmark_index); // X coordinate of landmark
             Xi(num_dof + 2*landmark_index + 1) = m(2*landmark_index + 1); // Y coordinate of landmark
@@ -65,7 +233,7 @@ namespace turtlelib
             q(pose_index) = Xi(pose_index);
         }
         // Populate map vector
-        for (int landmark_index = 0; landmark_index < num_landmarks; landmark_index++)
+        for (size_t landmark_index = 0; landmark_index < n; landmark_index++)
         {
             m(2*landmark_index) = Xi(num_dof + 2*landmark_index); // X coordinate of landmark
             m(2*landmark_index + 1) = Xi(num_dof + 2*landmark_index + 1); // Y coordinate of landmark
@@ -89,38 +257,17 @@ namespace turtlelib
         // First we predict the covariance ˆΣ-_t using current A_t which is calculated using the previous state ξ_{t−1}, and current input u_t.
         // ˆΣ¯_t = A_t ˆΣ_{t−1} A_t^{T} + Q-,
 
-        // Calculate A matrix.
-        arma::mat zeros_12{num_dof, 2 * num_landmarks, arma::fill::zeros};
-        arma::mat zeros_21{2 * num_landmarks, num_dof, arma::fill::zeros};
-        arma::mat zeros_22{2 * num_landmarks, 2 * num_landmarks, arma::fill::zeros};
-        arma::mat pose_state_matrix(num_dof, num_dof, arma::fill::zeros);
-
-        // Zero rotational velocity
-        if (almost_equal(u(0), 0.0)) 
-        {     
-            pose_state_matrix(1, 0) = -u(1) * sin(q(0));
-            pose_state_matrix(2, 0) = u(1) * cos(q(0));
-        } 
-        // Non-zero rotational velocity
-        else 
-        {   
-            pose_state_matrix(1, 0) = -(u(1) / u(0)) * cos(q(0)) + (u(1) / u(0)) * cos(normalize_angle(q(0) + u(0)));
-            pose_state_matrix(2, 0) = -(u(1) / u(0)) * sin(q(0)) + (u(1) / u(0)) * sin(normalize_angle(q(0) + u(0)));
-        }
+        // A_t = I + G_t, where the only non-zero entries of G_t are d(x, y)/dθ
+        double g_x = 0.0; // A(1, 0)
+        double g_y = 0.0; // A(2, 0)
+        ekf_motion_jacobian(q(0), u(0), u(1), g_x, g_y);
 
-        A = I +
-            arma::join_vert(
-            arma::join_horiz(pose_state_matrix, zeros_12),
-            arma::join_horiz(zeros_21, zeros_22));
+        // The rest of A is identity and never changes
+        A(1, 0) = g_x;
+        A(2, 0) = g_y;
 
-        // Represent process noise Q as Q_bar
-        arma::mat Q_bar =
-            arma::join_vert(
-            arma::join_horiz(Q, zeros_12), 
-            arma::join_horiz(zeros_21, zeros_22));
-        
-        // Update covariance matrix
-        sigma = A * sigma * A.t() + Q_bar;
+        // Update covariance matrix in place
+        ekf_propagate_covariance(sigma, dim(), g_x, g_y, Q);
         
         // Now we predict the mean pose ˆξ-_t using the current pose ξ_{t−1}
         // ˆξ¯_t = g(ˆξ_{t−1}, u_t, 0)
@@ -130,11 +277,17 @@ namespace turtlelib
         Transform2D twist_as_tf_TbB = integrate_twist(twist);   // Change in mean pose
         Transform2D newpose_as_tf_TwB = pose_as_tf_Twb * twist_as_tf_TbB;  // Final mean pose
 
-        // Update pose and state
+        // Update pose and state. The map does not move during prediction.
         q(0) = newpose_as_tf_TwB.rotation();
         q(1) = newpose_as_tf_TwB.translation().x;
         q(2) = newpose_as_tf_TwB.translation().y;
-        update_state_vector();
+        for (int pose_index = 0; pose_index < num_dof; pose_index++)
+        {
+            Xi(pose_index) = q(pose_index);
+        }
+
+        // Landmarks the robot has moved away from leave the active state
+        freeze_far_landmarks();
 
         // // Check covariance matrix (symmetric and positive semi-definite)
         // // Check if symmetric
@@ -160,214 +313,525 @@ namespace turtlelib
         double r_j = magnitude(Vector2D{x, y});
         double phi_j = std::atan2(y, x);      
 
+        // Grow the state if this landmark does not have a slot yet
+        const size_t s = landmark_to_slot(j);
+        const arma::uword d = dim();
+
         // If landmark has not been seen before, add it to the map
         // Since our pose variables are predictions (distributions), our map is also a prediction. 
         if (seen_landmarks.find(j) == seen_landmarks.end()) 
         {
             // Initialize the landmark prediction as x and y predictions in map frame
-            m(2 * (j-1)) = q(1) + r_j * cos(phi_j + q(0)); // ˆm_{x,j}
-            m(2 * (j-1) + 1) = q(2) + r_j * sin(phi_j + q(0)); // ˆm_{y,j}
+            m(2 * (s-1)) = q(1) + r_j * cos(phi_j + q(0)); // ˆm_{x,j}
+            m(2 * (s-1) + 1) = q(2) + r_j * sin(phi_j + q(0)); // ˆm_{y,j}
             // Insert the new landmark index in the unordered_set
             seen_landmarks.insert(j);
             update_state_vector();
         }
         // Actual Measurement of that landmark. Not a distribution.
+        z_i.set_size(2);
+        z_i_hat.set_size(2);
         z_i(0) = r_j;
         z_i(1) = phi_j;
 
-        // Relative predictions of landmark position, as cartesian coordinates
-        // δ_{x,j} = ˆm_{x,j} − ˆx_t
-        // δ_{y,j} = ˆm_{y,j} − ˆy_t
-        // d_j = δ_{x,j}^2 + δ_{y,j}^2
-        Vector2D delta_j{m(2*(j-1)) - q(1), m(2*(j-1)+1) - q(2)};
-        double d_j = std::pow(magnitude(delta_j), 2);
+        // Predicted measurement and the non-zero blocks of H. Only the pose block and the block of landmark j are non-zero.
+        arma::mat::fixed<2, num_dof> small_H_first; // Dependence on pose
+        arma::mat::fixed<2, 2> small_H_second; // Dependence on sensed landmark
+        const arma::uword c = num_dof + 2 * (s-1); // First column of landmark j
+        ekf_measurement_model(q(0), q(1), q(2), m(2*(s-1)), m(2*(s-1)+1), z_i_hat, small_H_first, small_H_second);
 
-        // Relative predictions of landmark position, as range-bearing
-        double r_j_hat = std::sqrt(d_j);
-        double phi_j_hat = normalize_angle(atan2(delta_j.y, delta_j.x) - q(0));
-        z_i_hat(0) = r_j_hat;
-        z_i_hat(1) = phi_j_hat;
-
-        // Calculate H matrix
-        arma::mat small_H_first{2, num_dof, arma::fill::zeros}; // Dependence on pose
-        arma::mat zeros_2_first{2, 2 * (j-1), arma::fill::zeros}; // Dependence on landmarks having smaller indices
-        arma::mat small_H_second{2, 2, arma::fill::zeros}; // Dependence on sensed landmark
-        arma::mat zeros_2_second{2, 2 * num_landmarks - 2 * j, arma::fill::zeros}; // Dependence on landmarks having larger indices
-
-        small_H_first(0, 0) = 0.0;
-        small_H_first(0, 1) = -delta_j.x / std::sqrt(d_j);
-        small_H_first(0, 2) = -delta_j.y / std::sqrt(d_j);
-        small_H_first(1, 0) = -1;
-        small_H_first(1, 1) = delta_j.y / d_j;
-        small_H_first(1, 2) = -delta_j.x / d_j;
-
-        small_H_second(0, 0) = delta_j.x / std::sqrt(d_j);
-        small_H_second(0, 1) = delta_j.y / std::sqrt(d_j);
-        small_H_second(1, 0) = -delta_j.y / d_j;
-        small_H_second(1, 1) = delta_j.x / d_j;
-
-        H_i = arma::join_horiz(arma::join_horiz(small_H_first, zeros_2_first), arma::join_horiz(small_H_second, zeros_2_second));
+        // Only the blocks are kept, sensor_matrix() builds the dense H_i on request
+        H_pose_i = small_H_first;
+        H_landmark_i = small_H_second;
+        H_columns.assign(1, c);
+        H_cols = d;
 
         // Sensor noise matrix
         R = arma::mat{2, 2, arma::fill::eye} * R_noise;
         // Rj = R.submat(j, j, j + 1, j + 1);
 
-        // Kalman gain
-        // K_i = Σ¯_t H_{i}^{T} (H_i Σ¯_t H_{i}^{T} + R)^{-1}
-        K_i = sigma * H_i.t() * (H_i * sigma * H_i.t() + R).i();
-
-        // Update state to corrected prediction
-        
         // Subtract z_i and z_i_hat correcctly
-        arma::colvec z_i_diff{2, arma::fill::zeros};
+        arma::vec::fixed<2> z_i_diff;
         z_i_diff(0) = z_i(0) - z_i_hat(0);
         z_i_diff(1) = normalize_angle(z_i(1) - z_i_hat(1));
 
-        // ξ_t = ˆξ¯_t + K_i (z^i_t − ˆz^i_t)
-        Xi = Xi + K_i * (z_i_diff);    
+        // Kalman gain, state and covariance update
+        K_i.set_size(d, 2);
+        ekf_update(sigma, Xi, d, c, small_H_first, small_H_second, z_i_diff, R, sigma_Ht_i, K_i);
         update_pose_and_map();
 
-        // Update covariance
-        // Σ_t = (I − K_i H_i) Σ¯_t
-        sigma = (I - K_i * H_i) * sigma;
-
         // Srikanth is super cool
     }
 
-    size_t EKFSlam::associate_index(Point2D measurement)
+    /// \brief Correct the state and covariance once for every landmark sensed in a scan
+    void EKFSlam::correct_batch(const std::vector<Point2D> & measurements, const std::vector<size_t> & indices)
     {
-        // For each measurement z_i
-        // Convert relative measurements to range-bearing
-        // r_i = (x^2 + y^2)^0.5
-        // ϕ_i = atan2(y, x)
-        double r_i = std::sqrt(measurement.x * measurement.x + measurement.y * measurement.y);
-        double phi_i = std::atan2(measurement.y, measurement.x);      // Normalize ?? TODO ??
+        if (measurements.size() != indices.size())
+        {
+            throw std::runtime_error("Every measurement needs a landmark index!");
+        }
 
-        // Create a temp map with new temp landmark
-        arma::colvec m_temp{2*(num_landmarks+2), arma::fill::zeros};
+        // Index 0 marks an outlier
+        std::vector<size_t> used{};
+        used.reserve(measurements.size());
+        for (size_t i = 0; i < measurements.size(); i++)
+        {
+            if (indices[i] != 0)
+            {
+                used.push_back(i);
+            }
+        }
+        if (used.empty())
+        {
+            return;
+        }
 
-        for(int index = 0; index < std::min(static_cast<int>(2*(N+1)), 2*num_landmarks); index++)
+        // A large stack costs more to factorize than it saves. Fall back to one landmark at a time, which only streams over Σ.
+        if (used.size() == 1 || used.size() > max_batch_landmarks)
         {
-            m_temp(index) = m(index);
+            for (const size_t i : used)
+            {
+                correct(measurements[i].x, measurements[i].y, indices[i]);
+            }
+            return;
         }
-        // Initialize the landmark estimate x and y coordinates in the map
-        m_temp(2*(N+1)) = q(1) + r_i * cos(phi_i + q(0));
-        m_temp(2*(N+1) + 1) = q(2) + r_i * sin(phi_i + q(0));
 
-        // m_temp(2*(N)) = q(1) + r_i * cos(phi_i + q(0));
-        // m_temp(2*(N) + 1) = q(2) + r_i * sin(phi_i + q(0));
+        // Grow the state if some landmarks do not have a slot yet
+        std::vector<size_t> slots(used.size());
+        for (size_t u = 0; u < used.size(); u++)
+        {
+            slots[u] = landmark_to_slot(indices[used[u]]);
+        }
+        const arma::uword d = dim();
+        const arma::uword k = 2 * used.size();
 
-        // Actual measurements
-        arma::colvec z_i_temp{2, arma::fill::zeros};
-        z_i_temp(0) = r_i;
-        z_i_temp(1) = phi_i;
+        // Convert relative measurements to range-bearing
+        // r_j = (x^2 + y^2)^0.5
+        // ϕ_j = atan2(y, x)
+        z_i.set_size(k);
+        for (size_t u = 0; u < used.size(); u++)
+        {
+            const Point2D & measurement = measurements[used[u]];
+            z_i(2*u) = magnitude(Vector2D{measurement.x, measurement.y});
+            z_i(2*u + 1) = std::atan2(measurement.y, measurement.x);
+        }
 
-        // Sensor noise matrix
-        R = arma::mat{2, 2, arma::fill::eye} * R_noise; 
+        // New landmarks start at their first measurement in the scan
+        bool new_landmark = false;
+        for (size_t u = 0; u < used.size(); u++)
+        {
+            const size_t j = indices[used[u]];
+            const size_t s = slots[u];
+            if (seen_landmarks.find(j) == seen_landmarks.end()) 
+            {
+                m(2 * (s-1)) = q(1) + z_i(2*u) * cos(z_i(2*u + 1) + q(0)); // ˆm_{x,j}
+                m(2 * (s-1) + 1) = q(2) + z_i(2*u) * sin(z_i(2*u + 1) + q(0)); // ˆm_{y,j}
+                seen_landmarks.insert(j);
+                new_landmark = true;
+            }
+        }
+        if (new_landmark)
+        {
+            update_state_vector();
+        }
 
-        std::vector<arma::mat> maha_distances{}; // Mahalanobis distance for each landmark
-        std::vector<arma::mat> eu_distances{}; // euclidean distance for each landmark
+        // Stacked prediction, innovation and H. Each pair of rows of H only has non-zero pose and landmark j blocks.
+        arma::mat::fixed<2, num_dof> small_H_first; // Dependence on pose
+        arma::mat::fixed<2, 2> small_H_second; // Dependence on sensed landmark
+        arma::vec::fixed<2> z_hat;
+        std::vector<arma::uword> & columns = H_columns;
+        arma::mat & H_pose = H_pose_i;
+        arma::mat & H_landmark = H_landmark_i;
+        columns.resize(used.size());
+        H_pose.set_size(k, num_dof);
+        H_landmark.set_size(k, 2);
+        H_cols = d;
+        arma::colvec z_diff(k);
+        z_i_hat.set_size(k);
+        for (size_t u = 0; u < used.size(); u++)
+        {
+            const size_t s = slots[u];
+            const arma::uword c = num_dof + 2 * (s-1);
+            columns[u] = c;
+            ekf_measurement_model(q(0), q(1), q(2), m(2*(s-1)), m(2*(s-1)+1), z_hat, small_H_first, small_H_second);
+            H_pose.rows(2*u, 2*u + 1) = small_H_first;
+            H_landmark.rows(2*u, 2*u + 1) = small_H_second;
+            z_i_hat(2*u) = z_hat(0);
+            z_i_hat(2*u + 1) = z_hat(1);
+            z_diff(2*u) = z_i(2*u) - z_hat(0);
+            z_diff(2*u + 1) = normalize_angle(z_i(2*u + 1) - z_hat(1));
+        }
 
-        for (size_t k = 1; k <= static_cast<size_t>(std::min(static_cast<int>(N+1), num_landmarks)); k++)
-        {            
-            Vector2D delta_k{m_temp(2*(k-1)) - q(1), m_temp(2*(k-1)+1) - q(2)};
-            double d_k = std::pow(magnitude(delta_k), 2);
+        // Σ¯_t H^T, d x k. Only reads the pose columns and the columns of the sensed landmarks.
+        arma::mat sigma_Ht(d, k);
+        for (arma::uword row_H = 0; row_H < k; row_H++)
+        {
+            const arma::uword c = columns[row_H / 2];
+            for (arma::uword row = 0; row < d; row++)
+            {
+                double sum = 0.0;
+                for (arma::uword p = 0; p < num_dof; p++)
+                {
+                    sum += sigma(row, p) * H_pose(row_H, p);
+                }
+                sum += sigma(row, c) * H_landmark(row_H, 0) + sigma(row, c + 1) * H_landmark(row_H, 1);
+                sigma_Ht(row, row_H) = sum;
+            }
+        }
 
-            // Compute H_k 
+        // Stacked innovation covariance, k x k. S = H Σ¯_t H^T + R, where the stacked R is R_noise on the diagonal.
+        // Added in place, so the member R stays the 2 x 2 noise of one measurement.
+        arma::mat S(k, k);
+        for (arma::uword row_H = 0; row_H < k; row_H++)
+        {
+            const arma::uword c = columns[row_H / 2];
+            for (arma::uword col = 0; col < k; col++)
+            {
+                double sum = (row_H == col) ? R_noise : 0.0;
+                for (arma::uword p = 0; p < num_dof; p++)
+                {
+                    sum += H_pose(row_H, p) * sigma_Ht(p, col);
+                }
+                sum += H_landmark(row_H, 0) * sigma_Ht(c, col) + H_landmark(row_H, 1) * sigma_Ht(c + 1, col);
+                S(row_H, col) = sum;
+            }
+        }
 
-            arma::mat H_k{2, num_dof+2*num_landmarks, arma::fill::zeros};
+        // Kalman gain. S is symmetric, so K = Σ¯_t H^T S^{-1} = (S^{-1} (Σ¯_t H^T)^T)^T
+        K_i = arma::solve(S, sigma_Ht.t()).t();
 
-            arma::mat small_H_first{2, num_dof, arma::fill::zeros}; // Dependence on pose
-            arma::mat zeros_2_first{2, 2 * (k-1), arma::fill::zeros}; // Dependence on landmarks having smaller indices
-            arma::mat small_H_second{2, 2, arma::fill::zeros}; // Dependence on sensed landmark
-            arma::mat zeros_2_second{2, 2 * num_landmarks - 2 * k, arma::fill::zeros}; // Dependence on landmarks having larger indices
+        // ξ_t = ˆξ¯_t + K (z_t − ˆz_t)
+        Xi.head(d) += K_i * z_diff;
 
-            small_H_first(0, 0) = 0.0;
-            small_H_first(0, 1) = -delta_k.x / std::sqrt(d_k);
-            small_H_first(0, 2) = -delta_k.y / std::sqrt(d_k);
-            small_H_first(1, 0) = -1;
-            small_H_first(1, 1) = delta_k.y / d_k;
-            small_H_first(1, 2) = -delta_k.x / d_k;
+        // Σ_t = Σ¯_t − K (Σ¯_t H^T)^T, one pass over Σ for the whole scan
+        sigma.submat(0, 0, d - 1, d - 1) -= K_i * sigma_Ht.t();
 
-            small_H_second(0, 0) = delta_k.x / std::sqrt(d_k);
-            small_H_second(0, 1) = delta_k.y / std::sqrt(d_k);
-            small_H_second(1, 0) = -delta_k.y / d_k;
-            small_H_second(1, 1) = delta_k.x / d_k;
+        update_pose_and_map();
+    }
 
-            H_k = arma::join_horiz(arma::join_horiz(small_H_first, zeros_2_first), arma::join_horiz(small_H_second, zeros_2_second));
+    void EKFSlam::landmark_innovation(size_t k, arma::vec::fixed<2> & z_hat, arma::mat::fixed<2, 2> & psi) const
+    {
+        // H_k only has non-zero columns for the pose and landmark k, so Ψ_k = H_k Σ H_k^T + R only needs that 5 x 5 block of Σ
+        const arma::uword c = num_dof + 2 * (k-1);
+        const arma::uword index[5] = {0, 1, 2, c, c + 1};
+        double block[5][5];
+        for (arma::uword t = 0; t < 5; t++)
+        {
+            for (arma::uword u = 0; u < 5; u++)
+            {
+                block[t][u] = sigma(index[t], index[u]);
+            }
+        }
+        block_innovation(m(2*(k-1)), m(2*(k-1)+1), block, z_hat, psi);
+    }
 
-            // Compute the covariance of the landmark in the map Ψ_k = H_k Σ H_k^T + R
+    void EKFSlam::frozen_landmark_innovation(const FrozenLandmark & landmark, arma::vec::fixed<2> & z_hat, arma::mat::fixed<2, 2> & psi) const
+    {
+        // Pose block from the active state, marginal of the landmark, no correlation between them
+        double block[5][5] = {};
+        for (arma::uword t = 0; t < num_dof; t++)
+        {
+            for (arma::uword u = 0; u < num_dof; u++)
+            {
+                block[t][u] = sigma(t, u);
+            }
+        }
+        block[3][3] = landmark.sigma_xx;
+        block[3][4] = landmark.sigma_xy;
+        block[4][3] = landmark.sigma_xy;
+        block[4][4] = landmark.sigma_yy;
+        block_innovation(landmark.x, landmark.y, block, z_hat, psi);
+    }
 
-            arma::mat psi_k{2,2, arma::fill::zeros};
+    void EKFSlam::block_innovation(double m_x, double m_y, const double block[5][5], arma::vec::fixed<2> & z_hat, arma::mat::fixed<2, 2> & psi) const
+    {
+        arma::mat::fixed<2, num_dof> small_H_first; // Dependence on pose
+        arma::mat::fixed<2, 2> small_H_second; // Dependence on landmark k
+        ekf_measurement_model(q(0), q(1), q(2), m_x, m_y, z_hat, small_H_first, small_H_second);
 
-            psi_k = H_k * sigma * H_k.t() + R;
+        double H_block[2][5];
+        for (arma::uword a = 0; a < 2; a++)
+        {
+            for (arma::uword t = 0; t < num_dof; t++)
+            {
+                H_block[a][t] = small_H_first(a, t);
+            }
+            H_block[a][3] = small_H_second(a, 0);
+            H_block[a][4] = small_H_second(a, 1);
+        }
 
-            // Compute the expected measurement ^z_k = h(μ)
+        for (arma::uword a = 0; a < 2; a++)
+        {
+            for (arma::uword b = 0; b < 2; b++)
+            {
+                double sum = R(a, b);
+                for (arma::uword t = 0; t < 5; t++)
+                {
+                    for (arma::uword u = 0; u < 5; u++)
+                    {
+                        sum += H_block[a][t] * block[t][u] * H_block[b][u];
+                    }
+                }
+                psi(a, b) = sum;
+            }
+        }
+    }
 
-            double r_k_hat = std::sqrt(d_k);
-            double phi_k_hat = normalize_angle(atan2(delta_k.y, delta_k.x) - q(0));
+    size_t EKFSlam::associate_index(Point2D measurement)
+    {
+        return associate_indices(std::vector<Point2D>{measurement}).front();
+    }
 
-            arma::colvec z_k_hat{2,arma::fill::zeros};
-            z_k_hat(0) = r_k_hat;
-            z_k_hat(1) = phi_k_hat;
+    std::vector<size_t> EKFSlam::associate_indices(const std::vector<Point2D> & measurements)
+    {
+        const size_t M = measurements.size();
+        std::vector<size_t> indices(M, 0);
+        if (M == 0)
+        {
+            return indices;
+        }
 
-            // Compute the Mahalanobis distance D_k = (z_i − ^z_k)^T Ψ^{−1} (z_i − ^z_k)
+        // Without submaps, known landmarks are read from their slots. Slots past n still hold the prior, so they only need to be allocated, not activated
+        if (submap_radius <= 0.0)
+        {
+            reserve_landmarks(N);
+        }
 
-            arma::colvec z_k_diff{2, arma::fill::zeros};
-            z_k_diff(0) = z_i_temp(0) - z_k_hat(0);
-            z_k_diff(1) = normalize_angle(z_i_temp(1) - z_k_hat(1));
+        // Sensor noise matrix
+        R = arma::mat{2, 2, arma::fill::eye} * R_noise; 
 
-            arma::colvec D_k{1, arma::fill::zeros};
-            D_k = z_k_diff.t() * psi_k.i() * z_k_diff;
+        double maha_benchmark = 0.0000004;
+        double landmark_radius = 0.038;
+        double eu_distance_threshold = (2.0) * landmark_radius + 0.5;
 
-            // Calculate Euclidean distance
-            arma::colvec eu_D_k{1, arma::fill::zeros};
-            eu_D_k = z_k_diff.t() * z_k_diff;
+        // Predicted measurement and inverse innovation covariance of one landmark slot
+        struct Candidate
+        {
+            arma::vec::fixed<2> z_hat;
+            arma::mat::fixed<2, 2> psi_inv;
+            double psi_max = 0.0; // Largest eigenvalue of Ψ
+        };
+        // Landmark k = 0 is a new landmark, still at its prior
+        const auto make_candidate = [this](size_t k)
+        {
+            Candidate candidate;
+            arma::mat::fixed<2, 2> psi;
+            size_t slot = k;
+            if (submap_radius > 0.0)
+            {
+                slot = (k != 0 && k <= landmark_slot.size()) ? landmark_slot.at(k-1) : 0;
+            }
+            if (slot != 0)
+            {
+                landmark_innovation(slot, candidate.z_hat, psi);
+            }
+            else
+            {
+                const auto frozen = frozen_landmarks.find(k);
+                frozen_landmark_innovation((frozen != frozen_landmarks.end()) ? frozen->second : FrozenLandmark{}, candidate.z_hat, psi);
+            }
+            const double det = psi(0, 0) * psi(1, 1) - psi(0, 1) * psi(1, 0);
+            candidate.psi_inv(0, 0) = psi(1, 1) / det;
+            candidate.psi_inv(0, 1) = -psi(0, 1) / det;
+            candidate.psi_inv(1, 0) = -psi(1, 0) / det;
+            candidate.psi_inv(1, 1) = psi(0, 0) / det;
+            const double half_trace = 0.5 * (psi(0, 0) + psi(1, 1));
+            const double half_diff = 0.5 * (psi(0, 0) - psi(1, 1));
+            candidate.psi_max = half_trace + std::sqrt(half_diff * half_diff + psi(0, 1) * psi(1, 0));
+            return candidate;
+        };
+
+        // Mahalanobis D_k = (z_i − ^z_k)^T Ψ^{−1} (z_i − ^z_k) and squared euclidean distance (z_i − ^z_k)^T (z_i − ^z_k)
+        const auto distances = [](const arma::vec::fixed<2> & z, const Candidate & candidate, double & maha, double & eu)
+        {
+            const double dr = z(0) - candidate.z_hat(0);
+            const double dphi = normalize_angle(z(1) - candidate.z_hat(1));
+            maha = dr * (candidate.psi_inv(0, 0) * dr + candidate.psi_inv(0, 1) * dphi) +
+                   dphi * (candidate.psi_inv(1, 0) * dr + candidate.psi_inv(1, 1) * dphi);
+            eu = dr * dr + dphi * dphi;
+        };
 
-            maha_distances.push_back(D_k);
-            eu_distances.push_back(eu_D_k);
+        // Convert relative measurements to range-bearing
+        // r_i = (x^2 + y^2)^0.5
+        // ϕ_i = atan2(y, x)
+        std::vector<arma::vec::fixed<2>> z(M);
+        for (size_t i = 0; i < M; i++)
+        {
+            z[i](0) = std::sqrt(measurements[i].x * measurements[i].x + measurements[i].y * measurements[i].y);
+            z[i](1) = std::atan2(measurements[i].y, measurements[i].x);
         }
 
-        // Set Mahalanobis distance threshold to distance N+1
-        double maha_benchmark = 0.0000004;
-        // double maha_benchmark = 0.4;
-        double maha_distance_threshold = std::max(maha_distances.at(maha_distances.size()-1)(0), maha_benchmark);
-        double landmark_radius = 0.038;
-        double eu_distance_threshold = (2.0) * landmark_radius + 0.5;
-        // double eu_distance_threshold = (2.0) * landmark_radius;
-        size_t index = N+1;
-        bool new_landmark = true;
+        // Known landmarks, and the prior every new landmark of this scan starts from
+        std::vector<Candidate> known(N);
+        for (size_t k = 1; k <= N; k++)
+        {
+            known[k-1] = make_candidate(k);
+        }
+        const Candidate fresh = make_candidate(0);
 
-        if (N >= num_landmarks)
+        // The Mahalanobis threshold of a measurement starts at its distance to the new slot and only shrinks.
+        // Bounding it over the scan bounds how far a landmark can be from a measurement it matches.
+        double maha_bound = maha_benchmark;
+        for (size_t i = 0; i < M; i++)
         {
-            index = 0;
-            new_landmark = false;
+            double maha = 0.0;
+            double eu = 0.0;
+            distances(z[i], fresh, maha, eu);
+            maha_bound = std::max(maha_bound, maha);
         }
 
-        for (size_t j = 1; j <= maha_distances.size(); j++)
+        // Polar grid pre-gate over the predicted measurements of the known landmarks.
+        // A landmark can only match or reject a measurement if (z_i − ^z_k)^T (z_i − ^z_k) < max(eu threshold, λ_max(Ψ_k) * maha bound),
+        // so it is inserted in every cell its gate box touches. Landmarks with very wide gates are checked against every measurement.
+        const double range_bin = std::sqrt(eu_distance_threshold);
+        const long num_bearing_bins = std::max(1L, static_cast<long>(2.0 * PI / range_bin));
+        const double bearing_bin = 2.0 * PI / static_cast<double>(num_bearing_bins);
+        const long max_gate_cells = 64;
+        const auto cell_key = [num_bearing_bins](long range_index, long bearing_index)
         {
-            if (maha_distances.at(j-1)(0) < maha_distance_threshold) // Check for same landmark
+            bearing_index %= num_bearing_bins;
+            if (bearing_index < 0)
             {
-                maha_distance_threshold = std::max(maha_distances.at(j-1)(0), maha_benchmark);
-                index = j;
-                new_landmark = false; // Not a new landmark
+                bearing_index += num_bearing_bins;
             }
-            else if (eu_distances.at(j-1)(0) < eu_distance_threshold) // Check for outliers
+            return range_index * num_bearing_bins + bearing_index;
+        };
+
+        std::unordered_map<long, std::vector<size_t>> grid{};
+        std::vector<size_t> ungated{};
+        for (size_t k = 1; k <= N; k++)
+        {
+            const Candidate & candidate = known[k-1];
+            const double gate = std::sqrt(std::max(eu_distance_threshold, candidate.psi_max * maha_bound));
+            const long range_first = static_cast<long>(std::floor(std::max(0.0, candidate.z_hat(0) - gate) / range_bin));
+            const long range_last = static_cast<long>(std::floor((candidate.z_hat(0) + gate) / range_bin));
+            const long bearing_first = static_cast<long>(std::floor((candidate.z_hat(1) + PI - gate) / bearing_bin));
+            const long bearing_last = std::min(bearing_first + num_bearing_bins - 1,
+                                               static_cast<long>(std::floor((candidate.z_hat(1) + PI + gate) / bearing_bin)));
+
+            if ((range_last - range_first + 1) * (bearing_last - bearing_first + 1) > max_gate_cells)
+            {
+                ungated.push_back(k);
+                continue;
+            }
+            for (long range_index = range_first; range_index <= range_last; range_index++)
+            {
+                for (long bearing_index = bearing_first; bearing_index <= bearing_last; bearing_index++)
+                {
+                    grid[cell_key(range_index, bearing_index)].push_back(k);
+                }
+            }
+        }
+
+        // Associate every measurement against the same state, in order
+        std::vector<size_t> shortlist{};
+        std::vector<double> matched_maha(M, 0.0);
+        std::vector<size_t> started{}; // Measurements that started a new landmark in this scan
+        size_t next_slot = N + 1;
+
+        for (size_t i = 0; i < M; i++)
+        {
+            // Candidates from the measurement's cell, in increasing landmark index like a full scan over 1..N
+            shortlist.clear();
+            const auto cell = grid.find(cell_key(static_cast<long>(std::floor(z[i](0) / range_bin)),
+                                                 static_cast<long>(std::floor((z[i](1) + PI) / bearing_bin))));
+            if (cell == grid.end())
+            {
+                shortlist = ungated;
+            }
+            else
+            {
+                std::merge(cell->second.begin(), cell->second.end(), ungated.begin(), ungated.end(), std::back_inserter(shortlist));
+            }
+
+            // Set Mahalanobis distance threshold to the distance of the new slot
+            double new_maha = 0.0;
+            double new_eu = 0.0;
+            distances(z[i], fresh, new_maha, new_eu);
+            double maha_distance_threshold = std::max(new_maha, maha_benchmark);
+            size_t index = next_slot;
+            bool new_landmark = true;
+
+            for (const size_t k : shortlist)
+            {
+                double maha = 0.0;
+                double eu = 0.0;
+                distances(z[i], known[k-1], maha, eu);
+                if (maha < maha_distance_threshold) // Check for same landmark
+                {
+                    maha_distance_threshold = std::max(maha, maha_benchmark);
+                    index = k;
+                    matched_maha[i] = maha;
+                    new_landmark = false; // Not a new landmark
+                }
+                else if (eu < eu_distance_threshold) // Check for outliers
+                {
+                    index = 0;
+                    new_landmark = false; // Not a new landmark
+                }
+            }
+
+            // Landmarks started earlier in this scan are not in the state yet. Measurements close to one belong to it.
+            for (const size_t other : started)
+            {
+                const double dr = z[i](0) - z[other](0);
+                const double dphi = normalize_angle(z[i](1) - z[other](1));
+                if (dr * dr + dphi * dphi < eu_distance_threshold)
+                {
+                    index = indices[other];
+                    new_landmark = false;
+                }
+            }
+
+            // The new slot is checked last, as landmark N+1
+            if (new_maha < maha_distance_threshold)
+            {
+                index = next_slot;
+                new_landmark = false;
+            }
+            else if (new_eu < eu_distance_threshold)
             {
                 index = 0;
-                new_landmark = false; // Not a new landmark
+                new_landmark = false;
             }
+
+            if (new_landmark == true) // If it is a new landmark take the next slot
+            {
+                started.push_back(i);
+                ++next_slot;
+            }
+            indices[i] = index;
         }
 
-        if (new_landmark == true) // If it is a new landmark increase N
+        // Joint constraint: a known landmark explains at most one measurement of a scan. The closest one keeps it, the rest are outliers.
+        std::unordered_map<size_t, size_t> owner{};
+        for (size_t i = 0; i < M; i++)
         {
-            ++N;
+            if (indices[i] == 0 || indices[i] > N)
+            {
+                continue;
+            }
+            const auto claim = owner.emplace(indices[i], i);
+            if (claim.second)
+            {
+                continue;
+            }
+            size_t & current = claim.first->second;
+            if (matched_maha[i] < matched_maha[current])
+            {
+                indices[current] = 0;
+                current = i;
+            }
+            else
+            {
+                indices[i] = 0;
+            }
         }
 
-        return index;
-    }
+        N = next_slot - 1;
 
-    // /// \brief 
+        return indices;
+    }
     // size_t EKFSlam::associate_index(Point2D measurement)
     // {
     //     // For each measurement z_i
@@ -497,6 +961,144 @@ namespace turtlelib
     //     // return (0.01*1e9);
     // }
 
+    void ekf_motion_jacobian(double theta, double omega, double v, double & g_x, double & g_y)
+    {
+        // Zero rotational velocity
+        if (almost_equal(omega, 0.0)) 
+        {     
+            g_x = -v * sin(theta);
+            g_y = v * cos(theta);
+        } 
+        // Non-zero rotational velocity
+        else 
+        {   
+            g_x = -(v / omega) * cos(theta) + (v / omega) * cos(normalize_angle(theta + omega));
+            g_y = -(v / omega) * sin(theta) + (v / omega) * sin(normalize_angle(theta + omega));
+        }
+    }
+
+    void ekf_propagate_covariance(arma::mat & sigma, arma::uword d, double g_x, double g_y, const arma::mat & Q)
+    {
+        // Only the x and y rows and columns change.
+        // Rows: (A Σ)_x = Σ_x + g_x Σ_θ, (A Σ)_y = Σ_y + g_y Σ_θ
+        for (arma::uword col = 0; col < d; col++)
+        {
+            sigma(1, col) += g_x * sigma(0, col);
+            sigma(2, col) += g_y * sigma(0, col);
+        }
+        // Columns: (A Σ A^T)_x = (A Σ)_x + g_x (A Σ)_θ, same for y
+        double * sigma_theta = sigma.colptr(0);
+        double * sigma_x = sigma.colptr(1);
+        double * sigma_y = sigma.colptr(2);
+        for (arma::uword row = 0; row < d; row++)
+        {
+            sigma_x[row] += g_x * sigma_theta[row];
+            sigma_y[row] += g_y * sigma_theta[row];
+        }
+        // Process noise only enters the pose block
+        for (int pose_index = 0; pose_index < num_dof; pose_index++)
+        {
+            for (int pose_index_2 = 0; pose_index_2 < num_dof; pose_index_2++)
+            {
+                sigma(pose_index, pose_index_2) += Q(pose_index, pose_index_2);
+            }
+        }
+    }
+
+    void ekf_measurement_model(double theta, double x, double y, double m_x, double m_y,
+                               arma::colvec & z_hat, arma::mat & H_pose, arma::mat & H_landmark)
+    {
+        // Relative predictions of landmark position, as cartesian coordinates
+        // δ_{x,j} = ˆm_{x,j} − ˆx_t
+        // δ_{y,j} = ˆm_{y,j} − ˆy_t
+        // d_j = δ_{x,j}^2 + δ_{y,j}^2
+        const Vector2D delta_j{m_x - x, m_y - y};
+        const double d_j = delta_j.x * delta_j.x + delta_j.y * delta_j.y;
+        const double r_j_hat = std::sqrt(d_j);
+
+        // Relative predictions of landmark position, as range-bearing
+        z_hat(0) = r_j_hat;
+        z_hat(1) = normalize_angle(atan2(delta_j.y, delta_j.x) - theta);
+
+        H_pose(0, 0) = 0.0;
+        H_pose(0, 1) = -delta_j.x / r_j_hat;
+        H_pose(0, 2) = -delta_j.y / r_j_hat;
+        H_pose(1, 0) = -1;
+        H_pose(1, 1) = delta_j.y / d_j;
+        H_pose(1, 2) = -delta_j.x / d_j;
+
+        H_landmark(0, 0) = delta_j.x / r_j_hat;
+        H_landmark(0, 1) = delta_j.y / r_j_hat;
+        H_landmark(1, 0) = -delta_j.y / d_j;
+        H_landmark(1, 1) = delta_j.x / d_j;
+    }
+
+    void ekf_update(arma::mat & sigma, arma::colvec & Xi, arma::uword d, arma::uword c,
+                    const arma::mat & H_pose, const arma::mat & H_landmark, const arma::colvec & z_diff,
+                    const arma::mat & R, arma::mat & sigma_Ht, arma::mat & K)
+    {
+        // Σ¯_t H_{i}^{T} only reads the pose columns and the columns of landmark j. O(n)
+        for (arma::uword k = 0; k < 2; k++)
+        {
+            for (arma::uword row = 0; row < d; row++)
+            {
+                double sum = 0.0;
+                for (arma::uword p = 0; p < num_dof; p++)
+                {
+                    sum += sigma(row, p) * H_pose(k, p);
+                }
+                sum += sigma(row, c) * H_landmark(k, 0) + sigma(row, c + 1) * H_landmark(k, 1);
+                sigma_Ht(row, k) = sum;
+            }
+        }
+
+        // Innovation covariance, 2 x 2. H_i Σ¯_t H_{i}^{T} + R
+        double S[2][2];
+        for (arma::uword a = 0; a < 2; a++)
+        {
+            for (arma::uword b = 0; b < 2; b++)
+            {
+                double sum = R(a, b);
+                for (arma::uword p = 0; p < num_dof; p++)
+                {
+                    sum += H_pose(a, p) * sigma_Ht(p, b);
+                }
+                sum += H_landmark(a, 0) * sigma_Ht(c, b) + H_landmark(a, 1) * sigma_Ht(c + 1, b);
+                S[a][b] = sum;
+            }
+        }
+        const double det = S[0][0] * S[1][1] - S[0][1] * S[1][0];
+        const double S_inv[2][2] = {{S[1][1] / det, -S[0][1] / det}, {-S[1][0] / det, S[0][0] / det}};
+
+        // Kalman gain
+        // K_i = Σ¯_t H_{i}^{T} (H_i Σ¯_t H_{i}^{T} + R)^{-1}
+        for (arma::uword row = 0; row < d; row++)
+        {
+            K(row, 0) = sigma_Ht(row, 0) * S_inv[0][0] + sigma_Ht(row, 1) * S_inv[1][0];
+            K(row, 1) = sigma_Ht(row, 0) * S_inv[0][1] + sigma_Ht(row, 1) * S_inv[1][1];
+        }
+
+        // ξ_t = ˆξ¯_t + K_i (z^i_t − ˆz^i_t)
+        for (arma::uword row = 0; row < d; row++)
+        {
+            Xi(row) += K(row, 0) * z_diff(0) + K(row, 1) * z_diff(1);
+        }
+
+        // Update covariance
+        // Σ_t = (I − K_i H_i) Σ¯_t = Σ¯_t − K_i (Σ¯_t H_{i}^{T})^{T}, since Σ¯_t is symmetric.
+        // Rank-2 update in place, column by column. O(n^2)
+        for (arma::uword col = 0; col < d; col++)
+        {
+            const double p0 = sigma_Ht(col, 0);
+            const double p1 = sigma_Ht(col, 1);
+            double * sigma_col = sigma.colptr(col);
+            for (arma::uword row = 0; row < d; row++)
+            {
+                sigma_col[row] -= K(row, 0) * p0 + K(row, 1) * p1;
+            }
+        }
+    }
+
     /// GETTERS
 
     /// \brief get current pose prediction/correction of the robot
@@ -508,19 +1110,41 @@ namespace turtlelib
     /// \brief get current map vector prediction/correction of the robot
     arma::colvec EKFSlam::map() const
     {
-        return m;
+        if (submap_radius <= 0.0)
+        {
+            return m.head(2 * n);
+        }
+
+        // Active landmarks from the state, frozen ones from their submaps, by landmark index
+        arma::colvec full_map{2 * landmark_slot.size(), arma::fill::zeros};
+        for (size_t j = 1; j <= landmark_slot.size(); j++)
+        {
+            const size_t slot = landmark_slot.at(j-1);
+            const auto frozen = frozen_landmarks.find(j);
+            if (slot != 0)
+            {
+                full_map(2*(j-1)) = m(2*(slot-1));
+                full_map(2*(j-1) + 1) = m(2*(slot-1) + 1);
+            }
+            else if (frozen != frozen_landmarks.end())
+            {
+                full_map(2*(j-1)) = frozen->second.x;
+                full_map(2*(j-1) + 1) = frozen->second.y;
+            }
+        }
+        return full_map;
     }
 
     /// \brief get current state vector prediction/correction of the robot
     arma::colvec EKFSlam::state_vector() const
     {
-        return Xi;
+        return Xi.head(dim());
     }
 
     /// \brief get current covariance matrix prediction/correction of the robot
     arma::mat EKFSlam::covariance_matrix() const
     {
-        return sigma;
+        return sigma.submat(0, 0, dim() - 1, dim() - 1);
     }
 
     /// \brief get current twist input to the robot
@@ -532,7 +1156,7 @@ namespace turtlelib
     /// \brief get current state matrix prediction of the robot
     arma::mat EKFSlam::state_matrix() const
     {
-        return A;
+        return A.submat(0, 0, dim() - 1, dim() - 1);
     }
 
     /// \brief set the initial state of the robot
@@ -550,6 +1174,18 @@ namespace turtlelib
     /// \brief get the current predicted sensor matrix 
     arma::mat EKFSlam::sensor_matrix() const
     {
+        // Dense H_i from the blocks of the last correction. Only built here, the corrections never multiply by it
+        arma::mat H_i{H_pose_i.n_rows, H_cols, arma::fill::zeros};
+        for (arma::uword row = 0; row < H_pose_i.n_rows; row++)
+        {
+            const arma::uword c = H_columns[row / 2];
+            for (arma::uword p = 0; p < num_dof; p++)
+            {
+                H_i(row, p) = H_pose_i(row, p);
+            }
+            H_i(row, c) = H_landmark_i(row, 0);
+            H_i(row, c + 1) = H_landmark_i(row, 1);
+        }
         return H_i;
     }
 
@@ -558,5 +1194,11 @@ namespace turtlelib
     {
         return seen_landmarks.size();
     }
+
+    /// \brief get the number of landmark slots in the active state
+    size_t EKFSlam::num_active_landmarks() const
+    {
+        return n;
+    }
     
 }
\ No newline at end of file
@@ -0,0 +1,567 @@
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <armadillo>
+#include "turtlelib/se2d.hpp"
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/diff_drive.hpp"
+#include "turtlelib/fastslam.hpp"
+
+namespace turtlelib
+{
+    namespace
+    {
+        /// \brief Symmetric 2 x 2 matrix [a b; b c]
+        struct Sym2
+        {
+            double a = 0.0;
+            double b = 0.0;
+            double c = 0.0;
+
+            double det() const
+            {
+                return a * c - b * b;
+            }
+        };
+
+        /// \brief Range-bearing prediction of a landmark from a pose, with the Jacobian H of the measurement
+        /// with respect to the landmark. H = [h00 h01; h10 h11]
+        struct LandmarkPrediction
+        {
+            double r = 0.0;
+            double phi = 0.0;
+            double h00 = 0.0;
+            double h01 = 0.0;
+            double h10 = 0.0;
+            double h11 = 0.0;
+        };
+
+        LandmarkPrediction predict_measurement(const Pose2D & pose, double m_x, double m_y)
+        {
+            const double dx = m_x - pose.x;
+            const double dy = m_y - pose.y;
+            const double q = dx * dx + dy * dy;
+            const double r = std::sqrt(q);
+
+            LandmarkPrediction prediction{};
+            prediction.r = r;
+            prediction.phi = normalize_angle(std::atan2(dy, dx) - pose.theta);
+            prediction.h00 = dx / r;
+            prediction.h01 = dy / r;
+            prediction.h10 = -dy / q;
+            prediction.h11 = dx / q;
+            return prediction;
+        }
+
+        /// \brief innovation covariance S = H P H^T + R, and P H^T = [pht00 pht01; pht10 pht11]
+        Sym2 innovation_covariance(const LandmarkPrediction & h, const LandmarkGaussian & landmark,
+                                   double & pht00, double & pht01, double & pht10, double & pht11)
+        {
+            pht00 = landmark.sigma_xx * h.h00 + landmark.sigma_xy * h.h01;
+            pht01 = landmark.sigma_xx * h.h10 + landmark.sigma_xy * h.h11;
+            pht10 = landmark.sigma_xy * h.h00 + landmark.sigma_yy * h.h01;
+            pht11 = landmark.sigma_xy * h.h10 + landmark.sigma_yy * h.h11;
+
+            Sym2 S{};
+            S.a = h.h00 * pht00 + h.h01 * pht10 + R_noise;
+            S.b = h.h00 * pht01 + h.h01 * pht11;
+            S.c = h.h10 * pht01 + h.h11 * pht11 + R_noise;
+            return S;
+        }
+
+        /// \brief squared Mahalanobis distance of an innovation
+        double mahalanobis(const Sym2 & S, double dr, double dphi)
+        {
+            return (S.c * dr * dr - 2.0 * S.b * dr * dphi + S.a * dphi * dphi) / S.det();
+        }
+    }
+
+    void LandmarkPool::reserve(size_t count)
+    {
+        nodes.reserve(count);
+        free_nodes.reserve(count);
+    }
+
+    void LandmarkPool::retain(uint32_t node)
+    {
+        if (node != nil)
+        {
+            nodes[node].refs++;
+        }
+    }
+
+    void LandmarkPool::release(uint32_t node)
+    {
+        if (node == nil || --nodes[node].refs > 0)
+        {
+            return;
+        }
+        release(nodes[node].child[0]);
+        release(nodes[node].child[1]);
+        free_nodes.push_back(node);
+    }
+
+    uint32_t LandmarkPool::acquire()
+    {
+        uint32_t node = nil;
+        if (free_nodes.empty())
+        {
+            node = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        else
+        {
+            node = free_nodes.back();
+            free_nodes.pop_back();
+        }
+        nodes[node] = Node{};
+        nodes[node].refs = 1;
+        return node;
+    }
+
+    uint32_t LandmarkPool::make_unique(uint32_t node)
+    {
+        if (node == nil)
+        {
+            return acquire();
+        }
+        if (nodes[node].refs == 1)
+        {
+            return node;
+        }
+
+        // Shared, so copy it. The copy takes over one reference of the original, and references its children.
+        const uint32_t copy = acquire();
+        nodes[copy].child[0] = nodes[node].child[0];
+        nodes[copy].child[1] = nodes[node].child[1];
+        nodes[copy].landmark = nodes[node].landmark;
+        retain(nodes[copy].child[0]);
+        retain(nodes[copy].child[1]);
+        nodes[node].refs--;
+        return copy;
+    }
+
+    uint32_t LandmarkPool::grow(uint32_t root)
+    {
+        if (root == nil)
+        {
+            return nil;
+        }
+        const uint32_t grown = acquire();
+        nodes[grown].child[0] = root;
+        return grown;
+    }
+
+    const LandmarkGaussian * LandmarkPool::find(uint32_t root, size_t depth, size_t slot) const
+    {
+        uint32_t node = root;
+        for (size_t level = depth; level > 0 && node != nil; level--)
+        {
+            node = nodes[node].child[(slot >> (level - 1)) & 1];
+        }
+        return node == nil ? nullptr : &nodes[node].landmark;
+    }
+
+    LandmarkGaussian & LandmarkPool::write(uint32_t & root, size_t depth, size_t slot)
+    {
+        root = make_unique(root);
+        uint32_t node = root;
+        for (size_t level = depth; level > 0; level--)
+        {
+            const size_t side = (slot >> (level - 1)) & 1;
+            const uint32_t child = make_unique(nodes[node].child[side]);
+            nodes[node].child[side] = child;
+            node = child;
+        }
+        return nodes[node].landmark;
+    }
+
+    size_t LandmarkPool::num_nodes() const
+    {
+        return nodes.size() - free_nodes.size();
+    }
+
+    FastSlam::FastSlam() : FastSlam(Pose2D{0.0, 0.0, 0.0}) {}
+
+    FastSlam::FastSlam(Pose2D turtle_pose_0, size_t num_particles, unsigned int seed) :
+    generator{seed}
+    {
+        if (num_particles == 0)
+        {
+            throw std::runtime_error("FastSLAM needs at least one particle!");
+        }
+
+        // Every particle starts certain about the pose, with an empty map
+        particles.assign(num_particles, Particle{turtle_pose_0, 0.0, LandmarkPool::nil});
+        resampled.reserve(num_particles);
+        weights.assign(num_particles, 1.0 / static_cast<double>(num_particles));
+        pool.reserve(num_particles * 2 * (num_landmarks + 1));
+    }
+
+    void FastSlam::set_motion_noise(double rotation, double translation)
+    {
+        if (rotation < 0.0 || translation < 0.0)
+        {
+            throw std::runtime_error("Motion noise cannot be negative!");
+        }
+        rotation_noise = rotation;
+        translation_noise = translation;
+    }
+
+    void FastSlam::predict(Twist2D twist)
+    {
+        if (!almost_equal(twist.y, 0.0))
+        {
+            throw std::runtime_error("Improper twist for estimation!");
+        }
+
+        std::normal_distribution<double> standard_normal{0.0, 1.0};
+        const double omega_deviation = rotation_noise * std::abs(twist.omega);
+        const double v_deviation = translation_noise * std::abs(twist.x);
+
+        // Every particle follows its own noisy version of the twist
+        for (auto & particle : particles)
+        {
+            Twist2D sampled{twist.omega, twist.x, 0.0};
+            if (omega_deviation > 0.0)
+            {
+                sampled.omega += omega_deviation * standard_normal(generator);
+            }
+            if (v_deviation > 0.0)
+            {
+                sampled.x += v_deviation * standard_normal(generator);
+            }
+
+            const Transform2D T_wB = Transform2D{Vector2D{particle.pose.x, particle.pose.y}, particle.pose.theta} * integrate_twist(sampled);
+            particle.pose.theta = T_wB.rotation();
+            particle.pose.x = T_wB.translation().x;
+            particle.pose.y = T_wB.translation().y;
+        }
+    }
+
+    double FastSlam::update_landmark(Particle & particle, double r_j, double phi_j, size_t j)
+    {
+        const size_t slot = j - 1;
+        const LandmarkGaussian * known = pool.find(particle.map, depth, slot);
+
+        // Initialize a new landmark at its measured position, with the sensor noise mapped through H^-1
+        if (known == nullptr)
+        {
+            LandmarkGaussian landmark{};
+            landmark.x = particle.pose.x + r_j * std::cos(phi_j + particle.pose.theta);
+            landmark.y = particle.pose.y + r_j * std::sin(phi_j + particle.pose.theta);
+
+            const LandmarkPrediction h = predict_measurement(particle.pose, landmark.x, landmark.y);
+            const double det = h.h00 * h.h11 - h.h01 * h.h10;
+            const double i00 = h.h11 / det;
+            const double i01 = -h.h01 / det;
+            const double i10 = -h.h10 / det;
+            const double i11 = h.h00 / det;
+            landmark.sigma_xx = R_noise * (i00 * i00 + i01 * i01);
+            landmark.sigma_xy = R_noise * (i00 * i10 + i01 * i11);
+            landmark.sigma_yy = R_noise * (i10 * i10 + i11 * i11);
+
+            pool.write(particle.map, depth, slot) = landmark;
+            return 0.0;
+        }
+
+        LandmarkGaussian landmark = *known;
+        const LandmarkPrediction h = predict_measurement(particle.pose, landmark.x, landmark.y);
+        double pht00 = 0.0;
+        double pht01 = 0.0;
+        double pht10 = 0.0;
+        double pht11 = 0.0;
+        const Sym2 S = innovation_covariance(h, landmark, pht00, pht01, pht10, pht11);
+        const double det = S.det();
+
+        const double dr = r_j - h.r;
+        const double dphi = normalize_angle(phi_j - h.phi);
+
+        // K = P H^T S^-1
+        const double k00 = (pht00 * S.c - pht01 * S.b) / det;
+        const double k01 = (pht01 * S.a - pht00 * S.b) / det;
+        const double k10 = (pht10 * S.c - pht11 * S.b) / det;
+        const double k11 = (pht11 * S.a - pht10 * S.b) / det;
+
+        // μ = μ + K (z - ^z), P = P - K H P, where H P = (P H^T)^T
+        landmark.x += k00 * dr + k01 * dphi;
+        landmark.y += k10 * dr + k11 * dphi;
+        landmark.sigma_xx -= k00 * pht00 + k01 * pht01;
+        landmark.sigma_xy -= k00 * pht10 + k01 * pht11;
+        landmark.sigma_yy -= k10 * pht10 + k11 * pht11;
+
+        pool.write(particle.map, depth, slot) = landmark;
+
+        // Log of the Gaussian likelihood of the innovation
+        return -0.5 * mahalanobis(S, dr, dphi) - 0.5 * std::log(det) - std::log(2.0 * PI);
+    }
+
+    void FastSlam::correct(double x, double y, size_t j)
+    {
+        correct_batch(std::vector<Point2D>{Point2D{x, y}}, std::vector<size_t>{j});
+    }
+
+    void FastSlam::correct_batch(const std::vector<Point2D> & measurements, const std::vector<size_t> & indices)
+    {
+        if (measurements.size() != indices.size())
+        {
+            throw std::runtime_error("Every measurement needs a landmark index!");
+        }
+
+        bool corrected = false;
+        for (size_t i = 0; i < measurements.size(); i++)
+        {
+            const size_t j = indices[i];
+            if (j == 0)
+            {
+                continue;
+            }
+
+            // Grow every tree until it has a slot for landmark j
+            while (j > (size_t{1} << depth))
+            {
+                for (auto & particle : particles)
+                {
+                    particle.map = pool.grow(particle.map);
+                }
+                depth++;
+            }
+
+            if (j > seen_landmarks.size())
+            {
+                seen_landmarks.resize(j, false);
+            }
+            if (!seen_landmarks[j - 1])
+            {
+                seen_landmarks[j - 1] = true;
+                num_seen++;
+            }
+
+            const double r_j = std::sqrt(measurements[i].x * measurements[i].x + measurements[i].y * measurements[i].y);
+            const double phi_j = std::atan2(measurements[i].y, measurements[i].x);
+            for (auto & particle : particles)
+            {
+                particle.log_weight += update_landmark(particle, r_j, phi_j, j);
+            }
+            corrected = true;
+        }
+
+        if (corrected)
+        {
+            resample_if_degenerate();
+        }
+    }
+
+    void FastSlam::normalize_weights()
+    {
+        double max_log_weight = -std::numeric_limits<double>::infinity();
+        for (const auto & particle : particles)
+        {
+            max_log_weight = std::max(max_log_weight, particle.log_weight);
+        }
+
+        double total = 0.0;
+        for (size_t k = 0; k < particles.size(); k++)
+        {
+            weights[k] = std::exp(particles[k].log_weight - max_log_weight);
+            total += weights[k];
+        }
+        for (auto & weight : weights)
+        {
+            weight /= total;
+        }
+    }
+
+    void FastSlam::resample_if_degenerate()
+    {
+        normalize_weights();
+
+        double sum_squares = 0.0;
+        for (const auto weight : weights)
+        {
+            sum_squares += weight * weight;
+        }
+        const double M = static_cast<double>(particles.size());
+        if (1.0 / sum_squares >= 0.5 * M)
+        {
+            return;
+        }
+
+        // Low-variance resampling. A drawn particle shares its map with the original.
+        std::uniform_real_distribution<double> offset{0.0, 1.0 / M};
+        const double r = offset(generator);
+        double cumulative = weights[0];
+        size_t k = 0;
+        resampled.clear();
+        for (size_t m = 0; m < particles.size(); m++)
+        {
+            const double u = r + static_cast<double>(m) / M;
+            while (u > cumulative && k + 1 < particles.size())
+            {
+                k++;
+                cumulative += weights[k];
+            }
+            resampled.push_back(Particle{particles[k].pose, 0.0, particles[k].map});
+            pool.retain(particles[k].map);
+        }
+
+        for (const auto & particle : particles)
+        {
+            pool.release(particle.map);
+        }
+        particles.swap(resampled);
+        std::fill(weights.begin(), weights.end(), 1.0 / M);
+    }
+
+    size_t FastSlam::best_particle() const
+    {
+        size_t best = 0;
+        for (size_t k = 1; k < particles.size(); k++)
+        {
+            if (particles[k].log_weight > particles[best].log_weight)
+            {
+                best = k;
+            }
+        }
+        return best;
+    }
+
+    std::vector<size_t> FastSlam::associate_indices(const std::vector<Point2D> & measurements) const
+    {
+        const Particle & best = particles[best_particle()];
+        const size_t M = measurements.size();
+        std::vector<size_t> indices(M, 0);
+        std::vector<double> matched_maha(M, 0.0);
+        size_t next_new = seen_landmarks.size() + 1;
+
+        for (size_t i = 0; i < M; i++)
+        {
+            const double r_i = std::sqrt(measurements[i].x * measurements[i].x + measurements[i].y * measurements[i].y);
+            const double phi_i = std::atan2(measurements[i].y, measurements[i].x);
+
+            // Closest landmark of the best particle, by Mahalanobis distance
+            double min_maha = std::numeric_limits<double>::infinity();
+            size_t closest = 0;
+            pool.for_each(best.map, depth, [&](size_t slot, const LandmarkGaussian & landmark)
+            {
+                const LandmarkPrediction h = predict_measurement(best.pose, landmark.x, landmark.y);
+                double pht00 = 0.0;
+                double pht01 = 0.0;
+                double pht10 = 0.0;
+                double pht11 = 0.0;
+                const Sym2 S = innovation_covariance(h, landmark, pht00, pht01, pht10, pht11);
+                const double maha = mahalanobis(S, r_i - h.r, normalize_angle(phi_i - h.phi));
+                if (maha < min_maha)
+                {
+                    min_maha = maha;
+                    closest = slot + 1;
+                }
+            });
+
+            if (min_maha < fastslam_match_gate)
+            {
+                indices[i] = closest;
+                matched_maha[i] = min_maha;
+            }
+            else if (min_maha > fastslam_new_landmark_gate)
+            {
+                indices[i] = next_new++;
+            }
+        }
+
+        // A known landmark goes to the measurement closest to it, the others are outliers
+        for (size_t i = 0; i < M; i++)
+        {
+            if (indices[i] == 0 || indices[i] > seen_landmarks.size())
+            {
+                continue;
+            }
+            for (size_t other = i + 1; other < M; other++)
+            {
+                if (indices[other] != indices[i])
+                {
+                    continue;
+                }
+                if (matched_maha[other] < matched_maha[i])
+                {
+                    indices[i] = 0;
+                    break;
+                }
+                indices[other] = 0;
+            }
+        }
+
+        return indices;
+    }
+
+    Pose2D FastSlam::pose() const
+    {
+        // Normalized weights, without touching the scratch
+        double max_log_weight = -std::numeric_limits<double>::infinity();
+        for (const auto & particle : particles)
+        {
+            max_log_weight = std::max(max_log_weight, particle.log_weight);
+        }
+
+        double total = 0.0;
+        double x = 0.0;
+        double y = 0.0;
+        double cos_theta = 0.0;
+        double sin_theta = 0.0;
+        for (const auto & particle : particles)
+        {
+            const double weight = std::exp(particle.log_weight - max_log_weight);
+            total += weight;
+            x += weight * particle.pose.x;
+            y += weight * particle.pose.y;
+            cos_theta += weight * std::cos(particle.pose.theta);
+            sin_theta += weight * std::sin(particle.pose.theta);
+        }
+        return Pose2D{std::atan2(sin_theta, cos_theta), x / total, y / total};
+    }
+
+    arma::colvec FastSlam::map() const
+    {
+        arma::colvec map_vector(2 * seen_landmarks.size(), arma::fill::zeros);
+        pool.for_each(particles[best_particle()].map, depth, [&](size_t slot, const LandmarkGaussian & landmark)
+        {
+            map_vector(2 * slot) = landmark.x;
+            map_vector(2 * slot + 1) = landmark.y;
+        });
+        return map_vector;
+    }
+
+    size_t FastSlam::num_seen_landmarks() const
+    {
+        return num_seen;
+    }
+
+    size_t FastSlam::num_particles() const
+    {
+        return particles.size();
+    }
+
+    double FastSlam::effective_particles() const
+    {
+        double max_log_weight = -std::numeric_limits<double>::infinity();
+        for (const auto & particle : particles)
+        {
+            max_log_weight = std::max(max_log_weight, particle.log_weight);
+        }
+
+        double total = 0.0;
+        double sum_squares = 0.0;
+        for (const auto & particle : particles)
+        {
+            const double weight = std::exp(particle.log_weight - max_log_weight);
+            total += weight;
+            sum_squares += weight * weight;
+        }
+        return total * total / sum_squares;
+    }
+
+    size_t FastSlam::num_map_nodes() const
+    {
+        return pool.num_nodes();
+    }
+}
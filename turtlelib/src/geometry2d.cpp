@@ -5,32 +5,14 @@
 
 namespace turtlelib
 {
-    double normalize_angle(double rad)
-    {
-        // Normalize to range (-PI, PI].
-        if (almost_equal(rad, -PI))
-        {
-            return PI;
-        }
-        return atan2(sin(rad), cos(rad));
-    }
-
-    Vector2D operator-(const Point2D & head, const Point2D & tail)
-    {   
-        return Vector2D{head.x - tail.x, head.y - tail.y};
-    }
-
-    Point2D operator+(const Point2D & tail, const Vector2D & disp)
-    {   
-        return Point2D{tail.x + disp.x, tail.y + disp.y};
-    }
-
-    std::ostream & operator<<(std::ostream & os, const Point2D & p)
+    template<class T>
+    std::ostream & operator<<(std::ostream & os, const Point2<T> & p)
     {
         return os << "[" << p.x << " " << p.y << "]";
     }
 
-    std::istream & operator>>(std::istream & is, Point2D & p)
+    template<class T>
+    std::istream & operator>>(std::istream & is, Point2<T> & p)
     {
         const auto c = is.peek();        // examine the next character without extracting it
 
@@ -47,12 +29,14 @@ namespace turtlelib
         return is;
     }
 
-    std::ostream & operator<<(std::ostream & os, const Vector2D & v)
+    template<class T>
+    std::ostream & operator<<(std::ostream & os, const Vector2<T> & v)
     {
         return os << "[" << v.x << " " << v.y << "]";
     }
 
-    std::istream & operator>>(std::istream & is, Vector2D & v)
+    template<class T>
+    std::istream & operator>>(std::istream & is, Vector2<T> & v)
     {
         const auto c = is.peek();        // examine the next character without extracting it
 
@@ -69,10 +53,11 @@ namespace turtlelib
         return is;
     }
 
-    Vector2D normalizeVector(const Vector2D & v)
+    template<class T>
+    Vector2<T> normalizeVector(const Vector2<T> & v)
     {
-        Vector2D v_hat{};
-        double v_norm = sqrt(v.x * v.x + v.y * v.y);
+        Vector2<T> v_hat{};
+        T v_norm = std::sqrt(v.x * v.x + v.y * v.y);
 
         if(v_norm == 0.0)
         {
@@ -87,56 +72,8 @@ namespace turtlelib
         return v_hat;
     }
 
-    Vector2D operator-(const Vector2D & va, const Vector2D & vb)
-    {
-        return Vector2D{va.x - vb.x, va.y - vb.y};
-    }
-
-    Vector2D operator+(const Vector2D & va, const Vector2D & vb)
-    {
-        return Vector2D{va.x + vb.x, va.y + vb.y};
-    }
-
-    Vector2D operator*(const double & scale, const Vector2D & v)
-    {
-        return Vector2D{scale * v.x, scale * v.y};
-    }
-
-    Vector2D operator*(const Vector2D & v, const double & scale)
-    {
-        return Vector2D{scale * v.x, scale * v.y};
-    }
-
-    Vector2D operator-=(Vector2D & lhv, const Vector2D & rhv)
-    {
-        lhv = lhv - rhv;
-        return lhv;
-    }
-
-    Vector2D operator+=(Vector2D & lhv, const Vector2D & rhv)
-    {
-        lhv = lhv + rhv;
-        return lhv;
-    }
-
-    Vector2D operator*=(Vector2D & lhv, const double & scale)
-    {
-        lhv = scale * scale * lhv;
-        lhv = lhv * (1/scale);
-        return lhv;
-    }
-
-    double dot(const Vector2D & va, const Vector2D & vb)
-    {
-        return va.x * vb.x + va.y * vb.y;
-    }
-
-    double magnitude(const Vector2D & v)
-    {
-        return sqrt(dot(v,v));
-    }
-
-    double angle(const Vector2D & va, const Vector2D & vb)
+    template<class T>
+    T angle(const Vector2<T> & va, const Vector2<T> & vb)
     {
         double angle_a = 0.0, angle_b = 0.0;
         
@@ -160,8 +97,19 @@ namespace turtlelib
             angle_b = atan2(vb.y, vb.x);
         }
         
-        return normalize_angle(angle_a - angle_b);
-    }
-
-    
+        return static_cast<T>(normalize_angle(angle_a - angle_b));
+    }
+
+    template std::ostream & operator<<(std::ostream & os, const Point2<double> & p);
+    template std::ostream & operator<<(std::ostream & os, const Point2<float> & p);
+    template std::istream & operator>>(std::istream & is, Point2<double> & p);
+    template std::istream & operator>>(std::istream & is, Point2<float> & p);
+    template std::ostream & operator<<(std::ostream & os, const Vector2<double> & v);
+    template std::ostream & operator<<(std::ostream & os, const Vector2<float> & v);
+    template std::istream & operator>>(std::istream & is, Vector2<double> & v);
+    template std::istream & operator>>(std::istream & is, Vector2<float> & v);
+    template Vector2<double> normalizeVector(const Vector2<double> & v);
+    template Vector2<float> normalizeVector(const Vector2<float> & v);
+    template double angle(const Vector2<double> & va, const Vector2<double> & vb);
+    template float angle(const Vector2<float> & va, const Vector2<float> & vb);
 }
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cmath>
+#include "turtlelib/line_extraction.hpp"
+#include "turtlelib/geometry2d.hpp"
+
+namespace turtlelib
+{
+    LineExtractor::LineExtractor() : LineExtractor(360) {}
+
+    LineExtractor::LineExtractor(size_t max_points, LineExtractionLimits limits) : limits{limits}
+    {
+        // A segment has at least two points, and every split adds one interval
+        line_segments.reserve(max_points / 2 + 1);
+        line_corners.reserve(max_points / 2 + 1);
+        pending.reserve(max_points + 1);
+    }
+
+    LineSegment LineExtractor::fit(const Point2D * points, size_t first, size_t last) const
+    {
+        // Total least squares line through the centroid
+        const double n = static_cast<double>(last - first + 1);
+        double mean_x = 0.0;
+        double mean_y = 0.0;
+        for (size_t i = first; i <= last; i++)
+        {
+            mean_x += points[i].x;
+            mean_y += points[i].y;
+        }
+        mean_x /= n;
+        mean_y /= n;
+
+        double s_xx = 0.0;
+        double s_yy = 0.0;
+        double s_xy = 0.0;
+        for (size_t i = first; i <= last; i++)
+        {
+            const double dx = points[i].x - mean_x;
+            const double dy = points[i].y - mean_y;
+            s_xx += dx * dx;
+            s_yy += dy * dy;
+            s_xy += dx * dy;
+        }
+
+        LineSegment segment{};
+        segment.first = first;
+        segment.last = last;
+        segment.alpha = 0.5 * std::atan2(-2.0 * s_xy, s_yy - s_xx);
+        segment.rho = mean_x * std::cos(segment.alpha) + mean_y * std::sin(segment.alpha);
+        if (segment.rho < 0.0)
+        {
+            segment.rho = -segment.rho;
+            segment.alpha += PI;
+        }
+        segment.alpha = normalize_angle(segment.alpha);
+
+        // End points are the first and last points projected on the line
+        const double c = std::cos(segment.alpha);
+        const double s = std::sin(segment.alpha);
+        const auto project = [&](const Point2D & p)
+        {
+            const double distance = p.x * c + p.y * s - segment.rho;
+            return Point2D{p.x - distance * c, p.y - distance * s};
+        };
+        segment.start = project(points[first]);
+        segment.end = project(points[last]);
+        return segment;
+    }
+
+    void LineExtractor::split(const Point2D * points, size_t first, size_t last)
+    {
+        // Iterative end point fit. The right half is pushed first so segments come out in scan order.
+        pending.clear();
+        pending.emplace_back(first, last);
+        while (!pending.empty())
+        {
+            const auto [from, to] = pending.back();
+            pending.pop_back();
+            if (to - from + 1 < limits.min_points)
+            {
+                continue;
+            }
+
+            // Farthest point from the chord between the end points
+            const Vector2D chord = points[to] - points[from];
+            const double chord_length = magnitude(chord);
+            size_t farthest = from;
+            double max_distance = 0.0;
+            for (size_t i = from + 1; i < to; i++)
+            {
+                const Vector2D offset = points[i] - points[from];
+                const double distance = chord_length > 0.0 ?
+                    std::abs(chord.x * offset.y - chord.y * offset.x) / chord_length : magnitude(offset);
+                if (distance > max_distance)
+                {
+                    max_distance = distance;
+                    farthest = i;
+                }
+            }
+
+            if (max_distance > limits.split_distance)
+            {
+                // The farthest point is the end of both halves
+                pending.emplace_back(farthest, to);
+                pending.emplace_back(from, farthest);
+                continue;
+            }
+
+            line_segments.push_back(fit(points, from, to));
+        }
+    }
+
+    void LineExtractor::merge(const Point2D * points)
+    {
+        size_t kept = 0;
+        for (size_t k = 0; k < line_segments.size(); k++)
+        {
+            if (kept > 0)
+            {
+                LineSegment & previous = line_segments[kept - 1];
+                const LineSegment & current = line_segments[k];
+                const bool adjacent = current.first <= previous.last + 1 &&
+                                      magnitude(points[current.first] - points[previous.last]) <= limits.max_gap;
+                const bool collinear = std::abs(normalize_angle(current.alpha - previous.alpha)) < limits.merge_angle &&
+                                       std::abs(current.rho - previous.rho) < limits.merge_distance;
+                if (adjacent && collinear)
+                {
+                    previous = fit(points, previous.first, current.last);
+                    continue;
+                }
+            }
+            line_segments[kept++] = line_segments[k];
+        }
+        line_segments.resize(kept);
+
+        // Drop the segments too short to be walls
+        line_segments.erase(std::remove_if(line_segments.begin(), line_segments.end(), [&](const LineSegment & segment)
+        {
+            return magnitude(segment.end - segment.start) < limits.min_length;
+        }), line_segments.end());
+    }
+
+    void LineExtractor::find_corners()
+    {
+        for (size_t k = 0; k + 1 < line_segments.size(); k++)
+        {
+            const LineSegment & a = line_segments[k];
+            const LineSegment & b = line_segments[k + 1];
+            if (magnitude(b.start - a.end) > limits.corner_distance)
+            {
+                continue;
+            }
+
+            const double angle = std::abs(normalize_angle(b.alpha - a.alpha));
+            if (angle < limits.min_corner_angle || angle > PI - limits.min_corner_angle)
+            {
+                continue;
+            }
+
+            // Intersection of x cos(α_a) + y sin(α_a) = ρ_a and x cos(α_b) + y sin(α_b) = ρ_b
+            const double det = std::sin(b.alpha - a.alpha);
+            Corner corner{};
+            corner.position.x = (a.rho * std::sin(b.alpha) - b.rho * std::sin(a.alpha)) / det;
+            corner.position.y = (b.rho * std::cos(a.alpha) - a.rho * std::cos(b.alpha)) / det;
+            corner.angle = angle;
+            corner.segment = k;
+            line_corners.push_back(corner);
+        }
+    }
+
+    void LineExtractor::extract(const Point2D * points, size_t count)
+    {
+        line_segments.clear();
+        line_corners.clear();
+
+        // Split every run of points without gaps
+        size_t run_start = 0;
+        for (size_t i = 1; i <= count; i++)
+        {
+            if (i == count || magnitude(points[i] - points[i - 1]) > limits.max_gap)
+            {
+                split(points, run_start, i - 1);
+                run_start = i;
+            }
+        }
+
+        merge(points);
+        find_corners();
+    }
+
+    void LineExtractor::extract(const std::vector<Point2D> & points)
+    {
+        extract(points.data(), points.size());
+    }
+
+    const std::vector<LineSegment> & LineExtractor::segments() const
+    {
+        return line_segments;
+    }
+
+    const std::vector<Corner> & LineExtractor::corners() const
+    {
+        return line_corners;
+    }
+}
@@ -1,19 +1,112 @@
 #include <cstdio>
 #include <cmath>
 #include <iostream>
+#include <stdexcept>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include "turtlelib/geometry2d.hpp"
 #include "turtlelib/se2d.hpp"
 
 namespace turtlelib
 {
+    namespace
+    {
+        /// \brief rotate by the angle with cosine c and sine s, then translate by (tx, ty), every point of a batch
+        void rotate_translate(double c, double s, double tx, double ty,
+                              const double * xs, const double * ys, double * out_x, double * out_y, size_t count)
+        {
+            size_t i = 0;
+
+            // Each lane loads both coordinates before storing, so transforming in place is safe
+#if defined(__AVX__)
+            const __m256d c4 = _mm256_set1_pd(c);
+            const __m256d s4 = _mm256_set1_pd(s);
+            const __m256d tx4 = _mm256_set1_pd(tx);
+            const __m256d ty4 = _mm256_set1_pd(ty);
+            for (; i + 4 <= count; i += 4)
+            {
+                const __m256d x = _mm256_loadu_pd(xs + i);
+                const __m256d y = _mm256_loadu_pd(ys + i);
+                _mm256_storeu_pd(out_x + i, _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(x, c4), _mm256_mul_pd(y, s4)), tx4));
+                _mm256_storeu_pd(out_y + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, s4), _mm256_mul_pd(y, c4)), ty4));
+            }
+#elif defined(__SSE2__)
+            const __m128d c2 = _mm_set1_pd(c);
+            const __m128d s2 = _mm_set1_pd(s);
+            const __m128d tx2 = _mm_set1_pd(tx);
+            const __m128d ty2 = _mm_set1_pd(ty);
+            for (; i + 2 <= count; i += 2)
+            {
+                const __m128d x = _mm_loadu_pd(xs + i);
+                const __m128d y = _mm_loadu_pd(ys + i);
+                _mm_storeu_pd(out_x + i, _mm_add_pd(_mm_sub_pd(_mm_mul_pd(x, c2), _mm_mul_pd(y, s2)), tx2));
+                _mm_storeu_pd(out_y + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, s2), _mm_mul_pd(y, c2)), ty2));
+            }
+#endif
+
+            // Points left over from the vector kernels, or all of them without SIMD
+            for (; i < count; i++)
+            {
+                const double x = xs[i];
+                const double y = ys[i];
+                out_x[i] = x * c - y * s + tx;
+                out_y[i] = x * s + y * c + ty;
+            }
+        }
+
+        /// \brief rotate_translate in single precision, with twice as many points per vector
+        void rotate_translate(float c, float s, float tx, float ty,
+                              const float * xs, const float * ys, float * out_x, float * out_y, size_t count)
+        {
+            size_t i = 0;
+
+#if defined(__AVX__)
+            const __m256 c8 = _mm256_set1_ps(c);
+            const __m256 s8 = _mm256_set1_ps(s);
+            const __m256 tx8 = _mm256_set1_ps(tx);
+            const __m256 ty8 = _mm256_set1_ps(ty);
+            for (; i + 8 <= count; i += 8)
+            {
+                const __m256 x = _mm256_loadu_ps(xs + i);
+                const __m256 y = _mm256_loadu_ps(ys + i);
+                _mm256_storeu_ps(out_x + i, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(x, c8), _mm256_mul_ps(y, s8)), tx8));
+                _mm256_storeu_ps(out_y + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, s8), _mm256_mul_ps(y, c8)), ty8));
+            }
+#elif defined(__SSE2__)
+            const __m128 c4 = _mm_set1_ps(c);
+            const __m128 s4 = _mm_set1_ps(s);
+            const __m128 tx4 = _mm_set1_ps(tx);
+            const __m128 ty4 = _mm_set1_ps(ty);
+            for (; i + 4 <= count; i += 4)
+            {
+                const __m128 x = _mm_loadu_ps(xs + i);
+                const __m128 y = _mm_loadu_ps(ys + i);
+                _mm_storeu_ps(out_x + i, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(x, c4), _mm_mul_ps(y, s4)), tx4));
+                _mm_storeu_ps(out_y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, s4), _mm_mul_ps(y, c4)), ty4));
+            }
+#endif
+
+            for (; i < count; i++)
+            {
+                const float x = xs[i];
+                const float y = ys[i];
+                out_x[i] = x * c - y * s + tx;
+                out_y[i] = x * s + y * c + ty;
+            }
+        }
+    }
+
     // Print 2D Twist
-    std::ostream & operator<<(std::ostream & os, const Twist2D & tw)
+    template<class T>
+    std::ostream & operator<<(std::ostream & os, const Twist2<T> & tw)
     {
         return os << "[" << tw.omega << " " << tw.x << " " << tw.y << "]";
     }
 
     // Read 2D Twist
-    std::istream & operator>>(std::istream & is, Twist2D & tw)
+    template<class T>
+    std::istream & operator>>(std::istream & is, Twist2<T> & tw)
     {
         const auto c = is.peek();        // examine the next character without extracting it
 
@@ -31,137 +124,52 @@ namespace turtlelib
         return is;
     }
 
-    // CONSTRUCTORS.
-
-    // Create an identity transformation.
-    Transform2D::Transform2D() : 
-    translationVector{0.0, 0.0}, rotationAngle{0.0} 
-    {}
-
-    // Create a pure translation transform.
-    Transform2D::Transform2D(Vector2D displacement) :
-    translationVector{displacement}
-    {}
+    // TRANSFORM BATCHES OF POINTS.
 
-    // Create a pure rotation transform.
-    Transform2D::Transform2D(double angle) :
-    rotationAngle{normalize_angle(angle)}
-    {}
-
-    // Create a transform with translation and rotation.
-    // First rotate, then translate (in intermediate frame); which is equivalent to first translate, then rotate (in global frame).
-    Transform2D::Transform2D(Vector2D displacement, double angle) :
-    translationVector{displacement}, rotationAngle{normalize_angle(angle)}
-    {}
-
-    // TRANSFORM DIFFERENT ENTITIES THROUGH operator().
-
-    // Transform a point.
-    Point2D Transform2D::operator()(Point2D p) const
+    template<class T>
+    void Transform2<T>::apply(const T * xs, const T * ys, T * out_x, T * out_y, size_t count) const
     {
-        Point2D newp{};
-
-        // Rotate.
-        newp.x = p.x * cos(rotationAngle) - p.y * sin(rotationAngle);
-        newp.y = p.x * sin(rotationAngle) + p.y * cos(rotationAngle);
-
-        // Translate in global frame.
-        newp = newp + translationVector;
-        
-        return newp;
+        rotate_translate(cosRotation, sinRotation, translationVector.x, translationVector.y, xs, ys, out_x, out_y, count);
     }
 
-    // Transform a vector.
-    Vector2D Transform2D::operator()(Vector2D v) const
+    template<class T>
+    void Transform2<T>::apply(const std::vector<T> & xs, const std::vector<T> & ys,
+                              std::vector<T> & out_x, std::vector<T> & out_y) const
     {
-        Vector2D newv{};
-
-        // Rotate.
-        newv.x = v.x * cos(rotationAngle) - v.y * sin(rotationAngle);
-        newv.y = v.x * sin(rotationAngle) + v.y * cos(rotationAngle);
-
-        return newv;
-    }
-
-    // Transform a twist.
-    Twist2D Transform2D::operator()(Twist2D v) const
-    {
-        Twist2D newv{};
-
-        // Multiply with Adjoint.
-        newv.omega = v.omega;
-        newv.x = v.x * cos(rotationAngle) - v.y * sin(rotationAngle) + translationVector.y * newv.omega;
-        newv.y = v.x * sin(rotationAngle) + v.y * cos(rotationAngle) - translationVector.x * newv.omega;
-
-        return newv;
-    }
-
-    // RETURN INVERSE.
-    Transform2D Transform2D::inv() const
-    {
-        Vector2D newTranslationVector{};
-        double newRotationAngle{};
-
-        // R^T
-        newRotationAngle = -rotationAngle;
-
-        // -R^T p
-        newTranslationVector.x = -(translationVector.x * cos(newRotationAngle) - translationVector.y * sin(newRotationAngle));
-        newTranslationVector.y = -(translationVector.x * sin(newRotationAngle) + translationVector.y * cos(newRotationAngle));
-
-        // Create inverted Transform
-        Transform2D inv{newTranslationVector, newRotationAngle};
-
-        return inv;
-    }
-
-    // COMPOSE TRANSFORMS.
-    Transform2D & Transform2D::operator*=(const Transform2D & rhs)
-    {
-        double newRotationAngle{};
-
-        // R_a * R_rhs
-        newRotationAngle = normalize_angle(rotationAngle + rhs.rotation());
-
-        // Convert translation vector to point (p_rhs)
-        Point2D temp{rhs.translation().x, rhs.translation().y};
-
-        // R_a * p_rhs + p_a, which is equivalent to T_a * p_rhs
-        Vector2D newTranslationVector{(*this)(temp).x, (*this)(temp).y};
-
-        // Rewrite this transform as the composed transform.
-        translationVector = newTranslationVector;
-        rotationAngle = newRotationAngle;
-
-        return *this;
-    }
-
-    // GETTERS.
-
-    // Get translation vector.
-    Vector2D Transform2D::translation() const
-    {
-        return translationVector;
+        if (xs.size() != ys.size())
+        {
+            throw std::runtime_error("Point batch has different numbers of x and y coordinates.");
+        }
+        out_x.resize(xs.size());
+        out_y.resize(ys.size());
+        apply(xs.data(), ys.data(), out_x.data(), out_y.data(), xs.size());
     }
 
-    // Get rotation angle.
-    double Transform2D::rotation() const
+    template<class T>
+    void Transform2<T>::apply_composed(const Transform2 & rhs, const T * xs, const T * ys,
+                                       T * out_x, T * out_y, size_t count) const
     {
-        return rotationAngle;
+        // R_a * R_rhs by the angle sum identities, and R_a * p_rhs + p_a
+        const T c = cosRotation * rhs.cosRotation - sinRotation * rhs.sinRotation;
+        const T s = sinRotation * rhs.cosRotation + cosRotation * rhs.sinRotation;
+        const Point2<T> p = (*this)(Point2<T>{rhs.translationVector.x, rhs.translationVector.y});
+        rotate_translate(c, s, p.x, p.y, xs, ys, out_x, out_y, count);
     }
 
     // Print SE(2) Transform.
-    std::ostream & operator<<(std::ostream & os, const Transform2D & tf)
+    template<class T>
+    std::ostream & operator<<(std::ostream & os, const Transform2<T> & tf)
     {
         return os << "deg: " << rad2deg(tf.rotation()) << " x: " << tf.translation().x << " y: " << tf.translation().y;
     }
 
     // Read SE(2) Transform.
-    std::istream & operator>>(std::istream & is, Transform2D & tf) // Adapted from Abhishek Sankar
+    template<class T>
+    std::istream & operator>>(std::istream & is, Transform2<T> & tf) // Adapted from Abhishek Sankar
     {
         std::string trash_1, trash_2, trash_3;
-        double rotationAngle {};
-        Vector2D translationVector {};
+        T rotationAngle {};
+        Vector2<T> translationVector {};
         char next = is.peek(); //look at next character
 
         if(next == 'd')
@@ -177,16 +185,20 @@ namespace turtlelib
         {
             is >> rotationAngle >> translationVector.x >> translationVector.y;
         }
-        tf = Transform2D(translationVector, deg2rad(rotationAngle));
+        tf = Transform2<T>(translationVector, static_cast<T>(deg2rad(rotationAngle)));
         return is;
     }
 
-    Transform2D operator*(Transform2D lhs, const Transform2D & rhs)
-    {
-        lhs *= rhs;
-
-        return lhs;
-    }
+    template class Transform2<double>;
+    template class Transform2<float>;
+    template std::ostream & operator<<(std::ostream & os, const Twist2<double> & tw);
+    template std::ostream & operator<<(std::ostream & os, const Twist2<float> & tw);
+    template std::istream & operator>>(std::istream & is, Twist2<double> & tw);
+    template std::istream & operator>>(std::istream & is, Twist2<float> & tw);
+    template std::ostream & operator<<(std::ostream & os, const Transform2<double> & tf);
+    template std::ostream & operator<<(std::ostream & os, const Transform2<float> & tf);
+    template std::istream & operator>>(std::istream & is, Transform2<double> & tf);
+    template std::istream & operator>>(std::istream & is, Transform2<float> & tf);
 
     Transform2D integrate_twist(const Twist2D & twist)
     {
@@ -1,4 +1,5 @@
 // SVG.cpp
+#include <stdexcept>
 #include "turtlelib/svg.hpp"
 
 SVG::SVG(int width, int height) : width(width), height(height) {
@@ -42,3 +43,133 @@ void SVG::saveToFile(const std::string& filename, const std::string& additionalC
 int SVG::getWidth(){
     return width;
 }
+
+SVGStream::SVGStream(const std::string& filename, double width, double height, size_t buffer_size) :
+    buffer(buffer_size > 0 ? buffer_size : 1) {
+    file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        throw std::runtime_error("Unable to open file: " + filename);
+    }
+    std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    std::fprintf(file, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%g\" height=\"%g\">\n", width, height);
+}
+
+SVGStream::~SVGStream() {
+    // Destructors must not throw, so a failed write is only reported by an explicit close()
+    try {
+        close();
+    } catch (const std::runtime_error&) {
+    }
+}
+
+void SVGStream::checkElement() const {
+    if (!file) {
+        throw std::runtime_error("SVG file is already closed.");
+    }
+    if (polyline_open) {
+        throw std::runtime_error("Cannot add an element inside a polyline.");
+    }
+}
+
+void SVGStream::addRectangle(double x, double y, double w, double h, const std::string& fill) {
+    checkElement();
+    std::fprintf(file, "<rect x=\"%g\" y=\"%g\" width=\"%g\" height=\"%g\" fill=\"%s\"/>\n", x, y, w, h, fill.c_str());
+}
+
+void SVGStream::addCircle(double cx, double cy, double r, const std::string& color) {
+    checkElement();
+    std::fprintf(file, "<circle cx=\"%g\" cy=\"%g\" r=\"%g\" stroke=\"%s\" fill=\"%s\" stroke-width=\"1\"/>\n",
+                 cx, cy, r, color.c_str(), color.c_str());
+}
+
+void SVGStream::addLine(double x1, double y1, double x2, double y2, const std::string& stroke) {
+    checkElement();
+    std::fprintf(file, "<line x1=\"%g\" y1=\"%g\" x2=\"%g\" y2=\"%g\" stroke=\"%s\" stroke-width=\"2\"/>\n",
+                 x1, y1, x2, y2, stroke.c_str());
+}
+
+void SVGStream::addText(double x, double y, const std::string& text) {
+    checkElement();
+    std::fprintf(file, "<text x=\"%g\" y=\"%g\">%s</text>\n", x, y, text.c_str());
+}
+
+void SVGStream::beginPolyline(const std::string& stroke, double min_spacing) {
+    checkElement();
+    if (min_spacing < 0.0) {
+        throw std::runtime_error("Polyline spacing must not be negative.");
+    }
+    std::fprintf(file, "<polyline fill=\"none\" stroke=\"%s\" stroke-width=\"1\" points=\"", stroke.c_str());
+    polyline_open = true;
+    min_spacing_sq = min_spacing * min_spacing;
+    has_last = false;
+    has_pending = false;
+}
+
+void SVGStream::writePoint(double x, double y) {
+    std::fprintf(file, has_last ? " %g,%g" : "%g,%g", x, y);
+    has_last = true;
+    last_x = x;
+    last_y = y;
+    written++;
+}
+
+void SVGStream::addPoint(double x, double y) {
+    if (!polyline_open) {
+        throw std::runtime_error("No polyline to add a point to.");
+    }
+
+    const double dx = x - last_x;
+    const double dy = y - last_y;
+    if (has_last && dx * dx + dy * dy < min_spacing_sq) {
+        // Held back in case it ends the polyline
+        if (has_pending) {
+            skipped++;
+        }
+        has_pending = true;
+        pending_x = x;
+        pending_y = y;
+        return;
+    }
+
+    if (has_pending) {
+        skipped++;
+        has_pending = false;
+    }
+    writePoint(x, y);
+}
+
+void SVGStream::endPolyline() {
+    if (!polyline_open) {
+        throw std::runtime_error("No polyline to end.");
+    }
+    if (has_pending) {
+        writePoint(pending_x, pending_y);
+        has_pending = false;
+    }
+    std::fputs("\"/>\n", file);
+    polyline_open = false;
+}
+
+void SVGStream::close() {
+    if (!file) {
+        return;
+    }
+    if (polyline_open) {
+        endPolyline();
+    }
+    std::fputs("</svg>\n", file);
+    const bool failed = std::ferror(file) != 0;
+    const bool close_failed = std::fclose(file) != 0;
+    file = nullptr;
+    if (failed || close_failed) {
+        throw std::runtime_error("Failed to write the SVG file.");
+    }
+}
+
+size_t SVGStream::pointsWritten() const {
+    return written;
+}
+
+size_t SVGStream::pointsSkipped() const {
+    return skipped;
+}
@@ -1,4 +1,5 @@
 #include <sstream>
+#include <string>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 
@@ -44,4 +45,107 @@ TEST_CASE( "Circle fitting works", "[normalize_angle]" )
     REQUIRE_THAT( circle2.x, WithinAbs(0.4908357, accuracy * fabs(circle2.x) / 100.0));
     REQUIRE_THAT( circle2.y, WithinAbs(-22.15212,accuracy * fabs(circle2.y) / 100.0));
     REQUIRE_THAT( circle2.R, WithinAbs(22.17979,accuracy * fabs(circle2.R) / 100.0));
-}
\ No newline at end of file
+}
+TEST_CASE( "Circle fitting recovers an arc of a cylinder", "[circle_fitting(const Point2D *, size_t)]" ) 
+{
+    // Exact points on a quarter of a 0.038 m cylinder, as the lidar sees it
+    std::vector<turtlelib::Point2D> arc;
+    for (int k = 0; k < 12; k++)
+    {
+        const double angle = PI * (0.75 + 0.5 * k / 11.0);
+        arc.push_back(Point2D{1.2 + 0.038 * cos(angle), -0.4 + 0.038 * sin(angle)});
+    }
+
+    Circle circle = circle_fitting(arc.data(), arc.size());
+    REQUIRE_THAT( circle.x, WithinAbs(1.2, 1e-9));
+    REQUIRE_THAT( circle.y, WithinAbs(-0.4, 1e-9));
+    REQUIRE_THAT( circle.R, WithinAbs(0.038, 1e-9));
+
+    // Same fit through the vector overload, and through a sub-range of the points
+    Circle from_vector = circle_fitting(arc);
+    REQUIRE_THAT( from_vector.R, WithinAbs(circle.R, 1e-12));
+    Circle from_range = circle_fitting(arc.data() + 4, 5);
+    REQUIRE_THAT( from_range.x, WithinAbs(1.2, 1e-6));
+    REQUIRE_THAT( from_range.y, WithinAbs(-0.4, 1e-6));
+    REQUIRE_THAT( from_range.R, WithinAbs(0.038, 1e-6));
+
+    REQUIRE_THROWS( circle_fitting(arc.data(), 2));
+}
+
+TEST_CASE( "Batched circle fitting matches fitting each cluster", "[circle_fitting_batch]" ) 
+{
+    // Enough clusters of different sizes to fit in parallel
+    std::vector<turtlelib::Point2D> points;
+    std::vector<size_t> offsets{0};
+    for (size_t k = 0; k < 40; k++)
+    {
+        const size_t size = 4 + k % 9;
+        for (size_t i = 0; i < size; i++)
+        {
+            const double angle = PI * (0.5 + static_cast<double>(i) / static_cast<double>(size)) + 0.1 * k;
+            points.push_back(Point2D{0.1 * k + 0.05 * cos(angle), 1.0 - 0.02 * k + 0.05 * sin(angle) + 1e-4 * (i % 2)});
+        }
+        offsets.push_back(points.size());
+    }
+
+    const std::vector<Circle> circles = turtlelib::circle_fitting_batch(points, offsets);
+    REQUIRE(circles.size() == 40);
+    for (size_t k = 0; k < circles.size(); k++)
+    {
+        const Circle single = circle_fitting(points.data() + offsets.at(k), offsets.at(k + 1) - offsets.at(k));
+        REQUIRE_THAT( circles.at(k).x, WithinAbs(single.x, 1e-12));
+        REQUIRE_THAT( circles.at(k).y, WithinAbs(single.y, 1e-12));
+        REQUIRE_THAT( circles.at(k).R, WithinAbs(single.R, 1e-12));
+    }
+
+    REQUIRE(turtlelib::circle_fitting_batch(points, std::vector<size_t>{0}).empty());
+    REQUIRE_THROWS( turtlelib::circle_fitting_batch(points, std::vector<size_t>{0, 2}));
+    REQUIRE_THROWS( turtlelib::circle_fitting_batch(points, std::vector<size_t>{0, points.size() + 1}));
+}
+
+TEST_CASE( "Cluster classification rejects clusters that are not circles", "[classify_cluster]" ) 
+{
+    using turtlelib::ClusterReject;
+    using turtlelib::classify_cluster;
+
+    // Front half of a 0.038 m cylinder at 1 m, as the lidar sees it
+    std::vector<turtlelib::Point2D> arc;
+    for (int k = 0; k < 9; k++)
+    {
+        const double angle = PI * (0.55 + 0.9 * k / 8.0);
+        arc.push_back(Point2D{1.0 + 0.038 * cos(angle), 0.038 * sin(angle)});
+    }
+    REQUIRE(classify_cluster(arc.data(), arc.size()) == ClusterReject::none);
+
+    // Short straight piece of a wall
+    std::vector<turtlelib::Point2D> wall;
+    for (int k = 0; k < 9; k++)
+    {
+        wall.push_back(Point2D{2.0, -0.08 + 0.02 * k});
+    }
+    REQUIRE(classify_cluster(wall.data(), wall.size()) == ClusterReject::angle_out_of_range);
+
+    // Long wall, wider than any landmark
+    std::vector<turtlelib::Point2D> long_wall;
+    for (int k = 0; k < 30; k++)
+    {
+        long_wall.push_back(Point2D{2.0, -0.6 + 0.04 * k});
+    }
+    REQUIRE(classify_cluster(long_wall.data(), long_wall.size()) == ClusterReject::too_wide);
+
+    // Corner of a wall and a short stub
+    std::vector<turtlelib::Point2D> corner{{1.0, 0.0}, {1.02, 0.0}, {1.04, 0.0}, {1.06, 0.0}, {1.08, 0.0}, {1.1, 0.0}, {1.12, 0.0}, {1.12, 0.02}, {1.12, 0.04}};
+    REQUIRE(classify_cluster(corner.data(), corner.size()) == ClusterReject::angle_spread);
+
+    // Arc of a circle too large to be a landmark
+    std::vector<turtlelib::Point2D> large_arc;
+    for (int k = 0; k < 9; k++)
+    {
+        const double angle = PI * (0.785 + 0.43 * k / 8.0);
+        large_arc.push_back(Point2D{2.0 + 0.15 * cos(angle), 0.15 * sin(angle)});
+    }
+    REQUIRE(classify_cluster(large_arc.data(), large_arc.size()) == ClusterReject::arc_mismatch);
+
+    REQUIRE(classify_cluster(arc.data(), 2) == ClusterReject::too_few_points);
+    REQUIRE(std::string{turtlelib::to_string(ClusterReject::angle_spread)} == "angle_spread");
+}
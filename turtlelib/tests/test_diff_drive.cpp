@@ -1,5 +1,6 @@
 #include <sstream>
 #include <cmath>
+#include <vector>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 
@@ -17,6 +18,7 @@ using turtlelib::Transform2D;
 using turtlelib::wheelAngles;
 using turtlelib::Pose2D;
 using turtlelib::DiffDrive;
+using turtlelib::DiffDriveFleet;
 using turtlelib::PI;
 using Catch::Matchers::WithinAbs;
 
@@ -191,3 +193,75 @@ TEST_CASE( "Getting wheel increments from body twist works", "[TwistToWheels()]"
     REQUIRE_THROWS(turtle5.TwistToWheels(V_b5));
 }
 
+
+TEST_CASE( "Driving a fleet matches driving every robot on its own", "[DiffDriveFleet::driveWheels()]")
+{
+    const double radius = 0.033, sep = 0.16;
+    std::vector<DiffDrive> robots{};
+    DiffDriveFleet fleet{radius, sep};
+    for (int i = 0; i < 7; i++)
+    {
+        const Pose2D pose{0.9 * i - 3.0, 0.1 * i, -0.2 * i};
+        robots.push_back(DiffDrive{radius, sep, wheelAngles{0.3 * i, -0.1 * i}, pose});
+        REQUIRE(fleet.add(wheelAngles{0.3 * i, -0.1 * i}, pose) == static_cast<size_t>(i));
+    }
+    REQUIRE(fleet.size() == robots.size());
+
+    // Straight, forward and backward arcs, spinning in place, standing still, and an arc too wide to turn
+    const std::vector<double> delta_left{1.0, 0.5, -0.8, -0.7, 0.0, 2.0, 10.0};
+    const std::vector<double> delta_right{1.0, 1.5, -0.2, 0.7, 0.0, -1.0, 10.001};
+    std::vector<double> omega(fleet.size()), x_dot(fleet.size());
+    for (int step = 0; step < 5; step++)
+    {
+        fleet.driveWheels(delta_left.data(), delta_right.data(), omega.data(), x_dot.data());
+        for (size_t i = 0; i < robots.size(); i++)
+        {
+            const Twist2D V_b = robots.at(i).driveWheels(wheelAngles{delta_left.at(i), delta_right.at(i)});
+            REQUIRE_THAT(omega.at(i), WithinAbs(V_b.omega, 1.0e-12));
+            REQUIRE_THAT(x_dot.at(i), WithinAbs(V_b.x, 1.0e-12));
+        }
+    }
+
+    for (size_t i = 0; i < robots.size(); i++)
+    {
+        REQUIRE_THAT(normalize_angle(fleet.pose(i).theta - robots.at(i).pose().theta), WithinAbs(0.0, 1.0e-9));
+        REQUIRE_THAT(fleet.pose(i).x, WithinAbs(robots.at(i).pose().x, 1.0e-9));
+        REQUIRE_THAT(fleet.pose(i).y, WithinAbs(robots.at(i).pose().y, 1.0e-9));
+        REQUIRE_THAT(fleet.wheels(i).left, WithinAbs(robots.at(i).wheels().left, 1.0e-9));
+        REQUIRE_THAT(fleet.wheels(i).right, WithinAbs(robots.at(i).wheels().right, 1.0e-9));
+    }
+
+    // Predicting leaves the robot where it is, driving one robot leaves the others
+    const wheelAngles delta_phi{0.4, 0.9};
+    const Pose2D before = fleet.pose(1);
+    const Pose2D predicted = fleet.predictPose(1, delta_phi);
+    REQUIRE_THAT(fleet.pose(1).x, WithinAbs(before.x, 1.0e-12));
+    fleet.driveWheels(1, delta_phi);
+    robots.at(1).driveWheels(delta_phi);
+    REQUIRE_THAT(predicted.x, WithinAbs(robots.at(1).pose().x, 1.0e-9));
+    REQUIRE_THAT(predicted.y, WithinAbs(robots.at(1).pose().y, 1.0e-9));
+    REQUIRE_THAT(fleet.pose(1).theta, WithinAbs(robots.at(1).pose().theta, 1.0e-9));
+    REQUIRE_THAT(fleet.pose(2).x, WithinAbs(robots.at(2).pose().x, 1.0e-9));
+
+    REQUIRE_THROWS(fleet.pose(robots.size()));
+}
+
+TEST_CASE( "Getting wheel increments of a fleet from body twists works", "[DiffDriveFleet::TwistToWheels()]")
+{
+    const double radius = 0.033, sep = 0.16;
+    DiffDrive robot{radius, sep};
+    const DiffDriveFleet fleet{radius, sep, 3};
+    REQUIRE(fleet.size() == 3);
+    REQUIRE_THAT(fleet.pose(2).x, WithinAbs(0.0, 1.0e-12));
+
+    const std::vector<double> omega{0.0, 1.2, -0.69};
+    const std::vector<double> x_dot{0.22, 0.0, -0.1};
+    std::vector<double> delta_left(3), delta_right(3);
+    fleet.TwistToWheels(omega.data(), x_dot.data(), delta_left.data(), delta_right.data());
+    for (size_t i = 0; i < omega.size(); i++)
+    {
+        const wheelAngles delta_phi = robot.TwistToWheels(Twist2D{omega.at(i), x_dot.at(i), 0.0});
+        REQUIRE_THAT(delta_left.at(i), WithinAbs(delta_phi.left, 1.0e-12));
+        REQUIRE_THAT(delta_right.at(i), WithinAbs(delta_phi.right, 1.0e-12));
+    }
+}
@@ -48,7 +48,6 @@ arma::mat Q_bar =
             arma::join_vert(
             arma::join_horiz(Q, zeros_12), 
             arma::join_horiz(zeros_21, zeros_22));
-
 void ekf_check_pose(EKFSlam subject, Pose2D required_pose);
 void ekf_check_map(EKFSlam subject, arma::vec required_map);
 void ekf_check_state_vector(EKFSlam subject, arma::vec required_state_vector);
@@ -59,6 +58,76 @@ void ekf_check_actual_measurement(EKFSlam subject, arma::vec required_actual_mea
 void ekf_check_predicted_measurement(EKFSlam subject, arma::vec required_predicted_measurement);
 void ekf_check_sensor_matrix(EKFSlam subject, arma::mat required_sensor_matrix);
 
+TEST_CASE( "State grows beyond the initial landmark capacity for EKFSlam", "[correct(double, double, size_t)]") 
+{
+    Pose2D pose{0.0, 0.0, 0.0};
+    EKFSlam estimator(pose);
+
+    const size_t landmarks = 3 * num_landmarks + 1;
+
+    // Landmarks on a circle around the robot
+    for (size_t j = 1; j <= landmarks; j++)
+    {
+        const double angle = 2.0 * PI * static_cast<double>(j) / static_cast<double>(landmarks);
+        estimator.correct(2.0 * std::cos(angle), 2.0 * std::sin(angle), j);
+    }
+
+    REQUIRE(estimator.num_seen_landmarks() == landmarks);
+    REQUIRE(estimator.map().n_elem == 2 * landmarks);
+    REQUIRE(estimator.state_vector().n_elem == num_dof + 2 * landmarks);
+    REQUIRE(estimator.covariance_matrix().n_rows == num_dof + 2 * landmarks);
+    REQUIRE(estimator.covariance_matrix().n_cols == num_dof + 2 * landmarks);
+    REQUIRE(estimator.sensor_matrix().n_cols == num_dof + 2 * landmarks);
+
+    // A perfectly known pose places every landmark exactly where it was measured
+    for (size_t j = 1; j <= landmarks; j++)
+    {
+        const double angle = 2.0 * PI * static_cast<double>(j) / static_cast<double>(landmarks);
+        REQUIRE_THAT( estimator.map()(2*(j-1)), WithinAbs(2.0 * std::cos(angle), 1.0e-6));
+        REQUIRE_THAT( estimator.map()(2*(j-1)+1), WithinAbs(2.0 * std::sin(angle), 1.0e-6));
+    }
+
+    // Growing keeps the pose exactly known and the covariance symmetric
+    ekf_check_pose(estimator, pose);
+    REQUIRE( arma::approx_equal(estimator.covariance_matrix(), estimator.covariance_matrix().t(), "absdiff", 1e-6));
+
+    // Predicting after growth propagates the whole state
+    estimator.predict(Twist2D{0.0, 0.5, 0.0});
+    REQUIRE(estimator.state_matrix().n_rows == num_dof + 2 * landmarks);
+    REQUIRE_THAT( estimator.pose().x, WithinAbs(0.5, 1.0e-6));
+}
+
+TEST_CASE( "Fixed-size EKFSlam matches EKFSlam", "[FixedEKFSlam<N>]") 
+{
+    Pose2D pose{0.1, -0.3, 0.2};
+    EKFSlam estimator(pose);
+    turtlelib::FixedEKFSlam<num_landmarks> fixed_estimator(pose);
+
+    const Twist2D twists[] = {Twist2D{0.0, 0.2, 0.0}, Twist2D{0.3, 0.1, 0.0}, Twist2D{-0.5, 0.0, 0.0}};
+    const double measurements[][2] = {{1.0, 0.5}, {-0.4, 1.2}, {0.8, -0.9}, {2.0, 0.1}};
+
+    for (int step = 0; step < 9; step++)
+    {
+        estimator.predict(twists[step % 3]);
+        fixed_estimator.predict(twists[step % 3]);
+
+        const size_t j = static_cast<size_t>(step % num_landmarks) + 1;
+        estimator.correct(measurements[j-1][0], measurements[j-1][1], j);
+        fixed_estimator.correct(measurements[j-1][0], measurements[j-1][1], j);
+    }
+
+    REQUIRE(fixed_estimator.num_seen_landmarks() == estimator.num_seen_landmarks());
+    REQUIRE_THAT( fixed_estimator.pose().theta, WithinAbs(estimator.pose().theta, 1.0e-9));
+    REQUIRE_THAT( fixed_estimator.pose().x, WithinAbs(estimator.pose().x, 1.0e-9));
+    REQUIRE_THAT( fixed_estimator.pose().y, WithinAbs(estimator.pose().y, 1.0e-9));
+    REQUIRE( arma::approx_equal(fixed_estimator.map(), estimator.map(), "absdiff", 1e-9));
+    REQUIRE( arma::approx_equal(arma::mat(fixed_estimator.covariance_matrix()), estimator.covariance_matrix(), "reldiff", 1e-9));
+
+    // Landmark indices are fixed at compile time
+    REQUIRE_THROWS_AS(fixed_estimator.correct(1.0, 0.0, num_landmarks + 1), std::runtime_error);
+    REQUIRE_THROWS_AS(fixed_estimator.correct(1.0, 0.0, 0), std::runtime_error);
+}
+
 TEST_CASE( "Initialization works for EKFSLam", "[EKFSlam()]") 
 {
     EKFSlam estimator;
@@ -312,9 +381,10 @@ TEST_CASE( "Data association works for EKFSlam", "[associate_index(Point2D)]")
     REQUIRE(j_4 == 4);
     estimator_ptr->correct(fourth_landmark_coordinates.x + 0.069, 0, j_4);
 
-    // Extra landmark which can't be accomodated
+    // Extra landmark beyond the initial capacity
     size_t j_5 = estimator_ptr->associate_index(Point2D{6.9 + 0.069, 0.0});
-    REQUIRE(j_5 == 0);
+    REQUIRE(j_5 == 5);
+    estimator_ptr->correct(6.9 + 0.069, 0.0, j_5);
 
     // Noisy third landmark again
     size_t j_3n2 = estimator_ptr->associate_index(Point2D{third_landmark_coordinates.x + 0.069 + noise_3, third_landmark_coordinates.y});
@@ -354,6 +424,124 @@ TEST_CASE( "Data association works for EKFSlam", "[associate_index(Point2D)]")
     // ekf_check_sensor_matrix((*estimator_ptr), H_1);
 }
 
+TEST_CASE( "Batch correction works for EKFSlam", "[correct_batch(std::vector<Point2D>, std::vector<size_t>)]") 
+{
+    Pose2D pose{0.0, 0.0, 0.0};
+    EKFSlam batch(pose);
+    EKFSlam sequential(pose);
+
+    // Uncertain pose, so that landmarks become correlated
+    batch.predict(Twist2D{0.1, 0.2, 0.0});
+    sequential.predict(Twist2D{0.1, 0.2, 0.0});
+
+    // First sightings have no innovation, so stacking them is exactly the same as correcting one by one
+    const std::vector<Point2D> first_scan{Point2D{1.5, 0.5}, Point2D{-0.5, 2.0}, Point2D{0.3, -1.2}, Point2D{9.0, 9.0}};
+    const std::vector<size_t> first_indices{1, 2, 3, 0};
+    batch.correct_batch(first_scan, first_indices);
+    for (size_t i = 0; i < 3; i++)
+    {
+        sequential.correct(first_scan.at(i).x, first_scan.at(i).y, first_indices.at(i));
+    }
+
+    REQUIRE(batch.num_seen_landmarks() == 3);
+    REQUIRE( arma::approx_equal(batch.state_vector(), sequential.state_vector(), "absdiff", 1e-9));
+    REQUIRE( arma::approx_equal(batch.covariance_matrix(), sequential.covariance_matrix(), "reldiff", 1e-9));
+    REQUIRE(batch.sensor_matrix().n_rows == 6);
+    REQUIRE(batch.actual_measurement().n_rows == 6);
+
+    // Noisy sightings. Stacked and sequential updates only differ by where H is linearized.
+    batch.predict(Twist2D{0.0, 0.1, 0.0});
+    sequential.predict(Twist2D{0.0, 0.1, 0.0});
+    const std::vector<Point2D> second_scan{Point2D{1.41, 0.49}, Point2D{-0.59, 1.99}, Point2D{0.19, -1.21}};
+    const std::vector<size_t> second_indices{1, 2, 3};
+    batch.correct_batch(second_scan, second_indices);
+    for (size_t i = 0; i < second_scan.size(); i++)
+    {
+        sequential.correct(second_scan.at(i).x, second_scan.at(i).y, second_indices.at(i));
+    }
+
+    REQUIRE( arma::approx_equal(batch.state_vector(), sequential.state_vector(), "absdiff", 1e-2));
+    REQUIRE( arma::approx_equal(batch.covariance_matrix(), batch.covariance_matrix().t(), "absdiff", 1e-9));
+
+    // Every measurement needs an index
+    REQUIRE_THROWS_AS(batch.correct_batch(second_scan, std::vector<size_t>{1, 2}), std::runtime_error);
+}
+
+TEST_CASE( "Submaps freeze far landmarks for EKFSlam", "[set_submap_radius(double)]") 
+{
+    Pose2D pose{0.0, 0.0, 0.0};
+    EKFSlam estimator(pose);
+    estimator.set_submap_radius(3.0);
+
+    estimator.correct(1.0, 0.0, 1);
+    estimator.correct(0.0, 1.0, 2);
+    REQUIRE(estimator.num_active_landmarks() == 2);
+    REQUIRE(estimator.state_vector().n_elem == num_dof + 4);
+
+    // Driving away freezes both landmarks, and only the pose remains in the active state
+    estimator.predict(Twist2D{0.0, 5.0, 0.0});
+    REQUIRE(estimator.num_active_landmarks() == 0);
+    REQUIRE(estimator.covariance_matrix().n_rows == num_dof);
+    REQUIRE(estimator.num_seen_landmarks() == 2);
+
+    // Frozen landmarks stay in the map
+    REQUIRE(estimator.map().n_elem == 4);
+    REQUIRE_THAT( estimator.map()(0), WithinAbs(1.0, 1.0e-6));
+    REQUIRE_THAT( estimator.map()(3), WithinAbs(1.0, 1.0e-6));
+
+    // A new landmark takes the first free slot
+    estimator.correct(1.0, 0.0, 3);
+    REQUIRE(estimator.num_active_landmarks() == 1);
+    REQUIRE_THAT( estimator.map()(4), WithinAbs(estimator.pose().x + 1.0, 1.0e-6));
+
+    // Coming back freezes the new landmark and rejoins the first one when it is seen again
+    estimator.predict(Twist2D{0.0, -5.0, 0.0});
+    REQUIRE(estimator.num_active_landmarks() == 0);
+    const size_t j = estimator.associate_index(Point2D{1.0 - estimator.pose().x, -estimator.pose().y});
+    REQUIRE(j == 1);
+    estimator.correct(1.0 - estimator.pose().x, -estimator.pose().y, j);
+    REQUIRE(estimator.num_active_landmarks() == 1);
+    REQUIRE(estimator.map().n_elem == 6);
+    REQUIRE_THAT( estimator.map()(0), WithinAbs(1.0, 1.0e-2));
+    REQUIRE( arma::approx_equal(estimator.covariance_matrix(), estimator.covariance_matrix().t(), "absdiff", 1e-9));
+
+    REQUIRE_THROWS_AS(estimator.set_submap_radius(-1.0), std::runtime_error);
+}
+
+TEST_CASE( "Joint data association works for EKFSlam", "[associate_indices(std::vector<Point2D>)]") 
+{
+    // Away from the origin, where the untouched landmark slots sit
+    Pose2D pose{0.0, -0.069, 0.0};
+    EKFSlam estimator(pose);
+
+    // Three new landmarks seen in one scan, one of them twice
+    const std::vector<Point2D> first_scan{Point2D{2.0, 0.0}, Point2D{0.0, 3.0}, Point2D{-2.5, -1.0}, Point2D{2.0001, 0.0}};
+    const std::vector<size_t> first_indices = estimator.associate_indices(first_scan);
+    REQUIRE(first_indices.size() == first_scan.size());
+    REQUIRE(first_indices.at(0) == 1);
+    REQUIRE(first_indices.at(1) == 2);
+    REQUIRE(first_indices.at(2) == 3);
+    REQUIRE(first_indices.at(3) == 1); // Same landmark as the first measurement
+    for (size_t i = 0; i < first_scan.size(); i++)
+    {
+        estimator.correct(first_scan.at(i).x, first_scan.at(i).y, first_indices.at(i));
+    }
+
+    // Known landmarks in a different order, a duplicate of the first landmark, and a new landmark
+    const double noise = 0.0001;
+    const std::vector<Point2D> second_scan{Point2D{0.0, 3.0 + noise}, Point2D{2.0 + noise, 0.0}, Point2D{2.0 + 2.0 * noise, 0.0}, Point2D{-1.0, 4.0}};
+    const std::vector<size_t> second_indices = estimator.associate_indices(second_scan);
+    REQUIRE(second_indices.at(0) == 2);
+    REQUIRE(second_indices.at(1) == 1);
+    REQUIRE(second_indices.at(2) == 0); // Landmark 1 already explains a closer measurement
+    REQUIRE(second_indices.at(3) == 4);
+
+    // Joint association of one measurement is the same as associate_index
+    EKFSlam other(pose);
+    REQUIRE(other.associate_indices(std::vector<Point2D>{Point2D{2.0, 0.0}}).at(0) == 1);
+    REQUIRE(other.associate_indices(std::vector<Point2D>{}).empty());
+}
+
 
 
 void ekf_check_pose(EKFSlam subject, Pose2D required_pose)
@@ -0,0 +1,154 @@
+#include <cmath>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/se2d.hpp"
+#include "turtlelib/diff_drive.hpp"
+#include "turtlelib/ekf.hpp"
+#include "turtlelib/fastslam.hpp"
+#include <armadillo>
+
+using turtlelib::Point2D;
+using turtlelib::Vector2D;
+using turtlelib::Twist2D;
+using turtlelib::Transform2D;
+using turtlelib::Pose2D;
+using turtlelib::EKFSlam;
+using turtlelib::FastSlam;
+using turtlelib::LandmarkPool;
+using turtlelib::LandmarkGaussian;
+using Catch::Matchers::WithinAbs;
+
+TEST_CASE( "Landmark trees are copied on write", "[LandmarkPool]")
+{
+    LandmarkPool pool{};
+    const size_t depth = 3;
+
+    // Fill all 8 slots of one tree
+    uint32_t original = LandmarkPool::nil;
+    for (size_t slot = 0; slot < 8; slot++)
+    {
+        pool.write(original, depth, slot).x = static_cast<double>(slot);
+    }
+    REQUIRE(pool.num_nodes() == 15);
+
+    // A copy shares every node until it is written to
+    uint32_t copy = original;
+    pool.retain(copy);
+    REQUIRE(pool.num_nodes() == 15);
+
+    // Writing copies only the path to the slot
+    pool.write(copy, depth, 5).x = 50.0;
+    REQUIRE(pool.num_nodes() == 15 + depth + 1);
+    REQUIRE_THAT(pool.find(original, depth, 5)->x, WithinAbs(5.0, 1e-12));
+    REQUIRE_THAT(pool.find(copy, depth, 5)->x, WithinAbs(50.0, 1e-12));
+    REQUIRE_THAT(pool.find(copy, depth, 4)->x, WithinAbs(4.0, 1e-12));
+    REQUIRE(pool.find(copy, depth, 4) == pool.find(original, depth, 4));
+
+    // Growing keeps the slots
+    copy = pool.grow(copy);
+    REQUIRE_THAT(pool.find(copy, depth + 1, 5)->x, WithinAbs(50.0, 1e-12));
+    REQUIRE(pool.find(copy, depth + 1, 12) == nullptr);
+
+    // Released nodes are recycled
+    pool.release(original);
+    REQUIRE(pool.num_nodes() == depth + 2 + 15 - (depth + 1));
+    pool.release(copy);
+    REQUIRE(pool.num_nodes() == 0);
+}
+
+TEST_CASE( "Noiseless FastSlam matches EKFSlam", "[FastSlam(Pose2D, size_t, unsigned int)]")
+{
+    const Pose2D start{0.3, -0.069, 0.2};
+    FastSlam particles{start, 10, 7};
+    particles.set_motion_noise(0.0, 0.0);
+    EKFSlam filter{start};
+
+    const Twist2D twist{0.1, 0.2, 0.0};
+    particles.predict(twist);
+    filter.predict(twist);
+
+    REQUIRE_THAT(particles.pose().theta, WithinAbs(filter.pose().theta, 1e-9));
+    REQUIRE_THAT(particles.pose().x, WithinAbs(filter.pose().x, 1e-9));
+    REQUIRE_THAT(particles.pose().y, WithinAbs(filter.pose().y, 1e-9));
+
+    // First sightings land on the measurement in both filters
+    particles.correct(1.0, 0.5, 1);
+    filter.correct(1.0, 0.5, 1);
+    particles.correct(-0.4, 2.0, 3);
+    filter.correct(-0.4, 2.0, 3);
+
+    REQUIRE(particles.num_seen_landmarks() == 2);
+    REQUIRE(particles.map().n_elem == 6);
+    REQUIRE_THAT(particles.map()(0), WithinAbs(filter.map()(0), 1e-9));
+    REQUIRE_THAT(particles.map()(1), WithinAbs(filter.map()(1), 1e-9));
+    REQUIRE_THAT(particles.map()(2), WithinAbs(0.0, 1e-12));
+    REQUIRE_THAT(particles.map()(3), WithinAbs(0.0, 1e-12));
+    REQUIRE_THAT(particles.map()(4), WithinAbs(filter.map()(4), 1e-9));
+    REQUIRE_THAT(particles.map()(5), WithinAbs(filter.map()(5), 1e-9));
+
+    // Identical particles never degenerate
+    particles.correct(1.0, 0.5, 1);
+    REQUIRE_THAT(particles.effective_particles(), WithinAbs(10.0, 1e-9));
+
+    REQUIRE_THROWS(particles.predict(Twist2D{0.0, 0.1, 0.1}));
+    REQUIRE_THROWS(particles.set_motion_noise(-1.0, 0.0));
+    REQUIRE_THROWS(particles.correct_batch(std::vector<Point2D>{Point2D{1.0, 0.0}}, std::vector<size_t>{}));
+}
+
+TEST_CASE( "FastSlam converges on the landmarks", "[correct_batch(std::vector<Point2D>, std::vector<size_t>)]")
+{
+    const std::vector<Point2D> landmarks{{1.0, 1.0}, {2.0, -1.0}, {3.0, 0.5}, {0.5, -0.8}, {1.5, 0.3}};
+    Transform2D truth{Vector2D{-0.069, 0.0}, 0.0};
+    FastSlam particles{Pose2D{0.0, -0.069, 0.0}, 100, 42};
+
+    const Twist2D twist{0.0, 0.05, 0.0};
+    for (int step = 0; step < 40; step++)
+    {
+        truth *= turtlelib::integrate_twist(twist);
+        particles.predict(twist);
+
+        std::vector<Point2D> measurements{};
+        std::vector<size_t> indices{};
+        for (size_t j = 1; j <= landmarks.size(); j++)
+        {
+            measurements.push_back(truth.inv()(landmarks[j - 1]));
+            indices.push_back(j);
+        }
+        particles.correct_batch(measurements, indices);
+    }
+
+    REQUIRE_THAT(particles.pose().theta, WithinAbs(truth.rotation(), 1e-9));
+    REQUIRE_THAT(particles.pose().x, WithinAbs(truth.translation().x, 0.05));
+    REQUIRE_THAT(particles.pose().y, WithinAbs(truth.translation().y, 1e-9));
+
+    const arma::colvec map = particles.map();
+    REQUIRE(particles.num_seen_landmarks() == landmarks.size());
+    for (size_t j = 1; j <= landmarks.size(); j++)
+    {
+        REQUIRE_THAT(map(2 * (j - 1)), WithinAbs(landmarks[j - 1].x, 0.05));
+        REQUIRE_THAT(map(2 * (j - 1) + 1), WithinAbs(landmarks[j - 1].y, 0.05));
+    }
+
+    // Every particle holds at most a full tree of 8 slots
+    REQUIRE(particles.num_map_nodes() <= particles.num_particles() * 15);
+}
+
+TEST_CASE( "Data association works for FastSlam", "[associate_indices(std::vector<Point2D>)]")
+{
+    FastSlam particles{Pose2D{0.0, -0.069, 0.0}, 10, 3};
+    particles.set_motion_noise(0.0, 0.0);
+    particles.correct(1.0, 0.5, 1);
+    particles.correct(0.5, -1.0, 2);
+
+    // Known, new and known again. Two measurements of the same landmark leave the farther one out.
+    const std::vector<size_t> indices = particles.associate_indices(
+        std::vector<Point2D>{{1.01, 0.5}, {3.0, 3.0}, {0.5, -1.0}, {1.1, 0.6}});
+    REQUIRE(indices.size() == 4);
+    REQUIRE(indices.at(0) == 1);
+    REQUIRE(indices.at(1) == 3);
+    REQUIRE(indices.at(2) == 2);
+    REQUIRE(indices.at(3) == 0);
+}
@@ -252,3 +252,19 @@ TEST_CASE( "Angle works", "[magnitude()]")
 }
 
 
+
+TEST_CASE( "Single precision vectors work", "[Vector2F]")
+{
+    const turtlelib::Vector2F va{3.0f, -4.0f}, vb{-4.2f, 6.9f};
+
+    REQUIRE_THAT(magnitude(va), WithinAbs(5.0, 1.0e-6));
+    REQUIRE_THAT(dot(va, vb), WithinAbs(-40.2, 1.0e-5));
+    REQUIRE_THAT((0.5 * va).y, WithinAbs(-2.0, 1.0e-6));
+    REQUIRE_THAT(normalizeVector(va).x, WithinAbs(0.6, 1.0e-6));
+    REQUIRE_THAT(angle(va, vb), WithinAbs(angle(Vector2D{3.0, -4.0}, Vector2D{-4.2, 6.9}), 1.0e-5));
+
+    const turtlelib::Point2F p = turtlelib::Point2F{1.0f, 1.0f} + va;
+    std::stringstream sstr;
+    sstr << p;
+    REQUIRE(sstr.str() == "[4 -3]");
+}
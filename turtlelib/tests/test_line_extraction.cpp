@@ -0,0 +1,82 @@
+#include <cmath>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/line_extraction.hpp"
+
+using turtlelib::Point2D;
+using turtlelib::PI;
+using turtlelib::LineExtractor;
+using turtlelib::LineSegment;
+using turtlelib::Corner;
+using Catch::Matchers::WithinAbs;
+
+TEST_CASE( "Line extraction finds the walls and corner of a room", "[extract(std::vector<Point2D>)]")
+{
+    // Wall x = 2 from y = -1 up to the corner at (2, 1), then wall y = 1 back towards x = 0
+    std::vector<Point2D> scan;
+    for (int k = 0; k <= 40; k++)
+    {
+        scan.push_back(Point2D{2.0 + 0.002 * ((k % 3) - 1), -1.0 + 0.05 * k});
+    }
+    for (int k = 1; k <= 40; k++)
+    {
+        scan.push_back(Point2D{2.0 - 0.05 * k, 1.0 + 0.002 * ((k % 3) - 1)});
+    }
+
+    LineExtractor extractor{scan.size()};
+    extractor.extract(scan);
+
+    const std::vector<LineSegment> & segments = extractor.segments();
+    REQUIRE(segments.size() == 2);
+    REQUIRE_THAT(segments.at(0).rho, WithinAbs(2.0, 0.01));
+    REQUIRE_THAT(segments.at(0).alpha, WithinAbs(0.0, 0.01));
+    REQUIRE_THAT(segments.at(0).start.y, WithinAbs(-1.0, 0.01));
+    REQUIRE_THAT(segments.at(1).rho, WithinAbs(1.0, 0.01));
+    REQUIRE_THAT(segments.at(1).alpha, WithinAbs(PI / 2.0, 0.01));
+    REQUIRE_THAT(segments.at(1).end.x, WithinAbs(0.0, 0.01));
+    REQUIRE(segments.at(0).first == 0);
+    REQUIRE(segments.at(1).last == scan.size() - 1);
+
+    const std::vector<Corner> & corners = extractor.corners();
+    REQUIRE(corners.size() == 1);
+    REQUIRE_THAT(corners.at(0).position.x, WithinAbs(2.0, 0.01));
+    REQUIRE_THAT(corners.at(0).position.y, WithinAbs(1.0, 0.01));
+    REQUIRE_THAT(corners.at(0).angle, WithinAbs(PI / 2.0, 0.01));
+    REQUIRE(corners.at(0).segment == 0);
+}
+
+TEST_CASE( "Line extraction splits runs at gaps and drops clutter", "[extract(const Point2D *, size_t)]")
+{
+    std::vector<Point2D> scan;
+    // Wall y = -1 from x = 0 to 1
+    for (int k = 0; k <= 20; k++)
+    {
+        scan.push_back(Point2D{0.05 * k, -1.0});
+    }
+    // Same wall again after a doorway, which is collinear but too far to merge into a corner
+    for (int k = 0; k <= 20; k++)
+    {
+        scan.push_back(Point2D{1.5 + 0.05 * k, -1.0});
+    }
+    // A few points of clutter
+    scan.push_back(Point2D{3.0, 0.5});
+    scan.push_back(Point2D{3.02, 0.55});
+    scan.push_back(Point2D{2.98, 0.6});
+
+    LineExtractor extractor{scan.size()};
+    extractor.extract(scan.data(), scan.size());
+
+    REQUIRE(extractor.segments().size() == 2);
+    REQUIRE_THAT(extractor.segments().at(0).end.x, WithinAbs(1.0, 1e-9));
+    REQUIRE_THAT(extractor.segments().at(1).start.x, WithinAbs(1.5, 1e-9));
+    REQUIRE_THAT(extractor.segments().at(1).rho, WithinAbs(1.0, 1e-9));
+    REQUIRE_THAT(extractor.segments().at(1).alpha, WithinAbs(-PI / 2.0, 1e-9));
+    REQUIRE(extractor.corners().empty());
+
+    // Buffers are reused, and an empty scan clears them
+    extractor.extract(scan.data(), 0);
+    REQUIRE(extractor.segments().empty());
+}
@@ -1,4 +1,5 @@
 #include <sstream>
+#include <vector>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 
@@ -287,3 +288,87 @@ TEST_CASE( "Transform Differentiation works", "[differentiate_transform()]")
     REQUIRE_THAT( v3.x, WithinAbs(vn3.x,1.0e-6));
     REQUIRE_THAT( v3.y, WithinAbs(vn3.y,1.0e-6)); 
 }
+
+TEST_CASE( "Batched transform matches transforming one point at a time", "[apply(std::vector<double>, std::vector<double>)]")
+{
+    const Transform2D tf{Vector2D{1.5, -0.69}, deg2rad(69.0)};
+
+    // An odd count exercises the vector kernels and the scalar remainder
+    std::vector<double> xs{}, ys{};
+    for (int k = 0; k < 37; k++)
+    {
+        xs.push_back(0.1 * k - 2.0);
+        ys.push_back(3.0 - 0.07 * k);
+    }
+
+    std::vector<double> out_x{}, out_y{};
+    tf.apply(xs, ys, out_x, out_y);
+    REQUIRE(out_x.size() == xs.size());
+    REQUIRE(out_y.size() == ys.size());
+    for (size_t k = 0; k < xs.size(); k++)
+    {
+        const Point2D p = tf(Point2D{xs[k], ys[k]});
+        REQUIRE_THAT(out_x[k], WithinAbs(p.x, 1.0e-12));
+        REQUIRE_THAT(out_y[k], WithinAbs(p.y, 1.0e-12));
+    }
+
+    // In place gives the same points
+    tf.apply(xs.data(), ys.data(), xs.data(), ys.data(), xs.size());
+    for (size_t k = 0; k < xs.size(); k++)
+    {
+        REQUIRE_THAT(xs[k], WithinAbs(out_x[k], 1.0e-12));
+        REQUIRE_THAT(ys[k], WithinAbs(out_y[k], 1.0e-12));
+    }
+
+    REQUIRE_THROWS(tf.apply(std::vector<double>{1.0}, std::vector<double>{}, out_x, out_y));
+}
+
+TEST_CASE( "Batched composed transform matches composing first", "[apply_composed(Transform2D, const double *, const double *, double *, double *, size_t)]")
+{
+    const Transform2D tf_a{Vector2D{-0.3, 2.0}, 3.0};
+    const Transform2D tf_b{Vector2D{0.69, 4.2}, 1.0};
+    const Transform2D tf_ab = tf_a * tf_b;
+
+    const std::vector<double> xs{0.0, 1.0, -2.5, 0.3, 7.0};
+    const std::vector<double> ys{0.0, -1.0, 0.5, 0.3, -4.2};
+    std::vector<double> out_x(xs.size()), out_y(ys.size());
+    tf_a.apply_composed(tf_b, xs.data(), ys.data(), out_x.data(), out_y.data(), xs.size());
+
+    for (size_t k = 0; k < xs.size(); k++)
+    {
+        const Point2D p = tf_ab(Point2D{xs[k], ys[k]});
+        REQUIRE_THAT(out_x[k], WithinAbs(p.x, 1.0e-9));
+        REQUIRE_THAT(out_y[k], WithinAbs(p.y, 1.0e-9));
+    }
+}
+
+TEST_CASE( "Single precision transforms match double precision", "[Transform2F]")
+{
+    const Transform2D tf{Vector2D{1.5, -0.69}, deg2rad(69.0)};
+    const turtlelib::Transform2F tf_f{turtlelib::Vector2F{1.5f, -0.69f}, static_cast<float>(deg2rad(69.0))};
+    REQUIRE_THAT(tf_f.rotation(), WithinAbs(tf.rotation(), 1.0e-6));
+
+    // Eight lanes and a remainder
+    std::vector<float> xs{}, ys{}, out_x{}, out_y{};
+    for (int k = 0; k < 19; k++)
+    {
+        xs.push_back(0.1f * k - 2.0f);
+        ys.push_back(3.0f - 0.07f * k);
+    }
+    tf_f.apply(xs, ys, out_x, out_y);
+    for (size_t k = 0; k < xs.size(); k++)
+    {
+        const Point2D p = tf(Point2D{xs[k], ys[k]});
+        REQUIRE_THAT(out_x[k], WithinAbs(p.x, 1.0e-5));
+        REQUIRE_THAT(out_y[k], WithinAbs(p.y, 1.0e-5));
+    }
+
+    const turtlelib::Twist2F tw_f = tf_f.inv()(turtlelib::Twist2F{0.5f, 1.0f, -2.0f});
+    const Twist2D tw = tf.inv()(Twist2D{0.5, 1.0, -2.0});
+    REQUIRE_THAT(tw_f.x, WithinAbs(tw.x, 1.0e-5));
+    REQUIRE_THAT(tw_f.y, WithinAbs(tw.y, 1.0e-5));
+
+    std::stringstream sstr;
+    sstr << tf_f;
+    REQUIRE(sstr.str().rfind("deg: 69", 0) == 0);
+}
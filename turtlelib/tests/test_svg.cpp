@@ -1,4 +1,7 @@
 #include <sstream>
+#include <fstream>
+#include <string>
+#include <cstdio>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 
@@ -11,4 +14,41 @@ TEST_CASE( "Getting Width works for svg", "[getWidth()]")
     SVG svg(816, 1056);
 
     REQUIRE_THAT( svg.getWidth(), WithinAbs(816,1.0e-6));
-}
\ No newline at end of file
+}
+TEST_CASE( "Streaming svg writes decimated polylines", "[SVGStream]")
+{
+    const std::string filename = "test_svg_stream.svg";
+    {
+        SVGStream svg(filename, 400, 300, 64);
+        svg.addRectangle(0, 0, 400, 300, "white");
+        svg.addCircle(10.5, 20, 3, "blue");
+
+        // A straight path sampled every 0.1, kept every 1.0, and its last point always kept
+        svg.beginPolyline("red", 1.0);
+        for (int k = 0; k <= 95; k++)
+        {
+            svg.addPoint(0.1 * k, 5.0);
+        }
+        REQUIRE_THROWS(svg.addLine(0, 0, 1, 1, "black"));
+        svg.endPolyline();
+
+        REQUIRE(svg.pointsWritten() == 11);
+        REQUIRE(svg.pointsSkipped() == 85);
+        svg.close();
+        REQUIRE_THROWS(svg.addText(0, 0, "closed"));
+    }
+
+    std::ifstream file(filename);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const std::string svg_text = contents.str();
+    std::remove(filename.c_str());
+
+    REQUIRE(svg_text.rfind("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"400\" height=\"300\">", 0) == 0);
+    REQUIRE(svg_text.find("<circle cx=\"10.5\" cy=\"20\" r=\"3\"") != std::string::npos);
+    REQUIRE(svg_text.find("points=\"0,5 1,5 2,5 3,5 4,5 5,5 6,5 7,5 8,5 9,5 9.5,5\"/>") != std::string::npos);
+    REQUIRE(svg_text.size() >= 7);
+    REQUIRE(svg_text.substr(svg_text.size() - 7) == "</svg>\n");
+
+    REQUIRE_THROWS(SVGStream("no_such_directory/test.svg", 10, 10));
+}